@@ -0,0 +1,864 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Out-of-core chunked execution with a memory budget
+*/
+
+#include "SHE.h"
+#include "PHE.h"
+#include "Native.h"
+#include "Pipeline.h"
+#include "Chunked.h"
+#include "Executor.h"
+#include <openssl/bn.h>
+#include <openssl/sha.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+// 每个明文数据在内存中占用的估计字节数
+static const size_t PLAIN_BYTES = 64;
+
+// 检查点文件格式的版本
+static const int CHECKPOINT_VERSION = 1;
+
+// 分块执行的进度，每完成一块的加密或聚合后写入spillPrefix.checkpoint
+struct Checkpoint {
+    string path;
+    string algoName;
+    string spillPrefix;
+    // 输入文件的大小和修改时间，恢复时校验输入没有改变
+    long long inputSize;
+    long long inputTime;
+    // 每块的数据个数，恢复时沿用，保证块的划分不变
+    size_t size;
+    // 已写入的密文块数和已加密的数据个数
+    size_t encrypted;
+    size_t elements;
+    // 加密阶段是否完成
+    bool encryptDone;
+    // 已完成聚合的块数，对应的部分聚合结果已写入、密文块已删除
+    size_t aggregated;
+    // 本任务使用的公钥和私钥，与全局密钥相互独立，其它任务重新生成或恢复密钥不影响本任务
+    PublicKey* pk;
+    PrivateKey* sk;
+
+    Checkpoint() : pk(NULL), sk(NULL) {}
+
+    ~Checkpoint() {
+        releaseKeys();
+    }
+
+    // 释放本任务的密钥及其在各节点上的副本
+    void releaseKeys() {
+        if (pk != NULL) {
+            releaseKeyReplicas_PHE(pk->get_id());
+        }
+        delete pk;
+        delete sk;
+        pk = NULL;
+        sk = NULL;
+    }
+};
+
+/**
+ * @Method: 溢写文件的文件名
+ * @param string prefix 溢写文件的前缀
+ * @param string kind 文件类型，chunk为密文块，partial为部分聚合结果
+ * @param size_t i 块号
+ * @return string 文件名
+ */
+static string spillFile(const string &prefix, const string &kind, size_t i) {
+    return prefix + "." + kind + "." + to_string(i);
+}
+
+/**
+ * @Method: 删除所有溢写文件
+ * @param string prefix 溢写文件的前缀
+ * @param size_t chunks 块数
+ * @return void
+ */
+static void removeSpill(const string &prefix, size_t chunks) {
+    for (size_t i = 0; i < chunks; i++) {
+        unlink(spillFile(prefix, "chunk", i).c_str());
+        unlink(spillFile(prefix, "partial", i).c_str());
+    }
+}
+
+/**
+ * @Method: 释放列表中的所有BIGNUM并清空列表
+ * @param vector<BIGNUM*>& x 列表
+ * @return void
+ */
+static void freeAll(vector<BIGNUM*> &x) {
+    for (size_t i = 0; i < x.size(); i++) {
+        BN_free(x[i]);
+    }
+    x.clear();
+}
+
+/**
+ * @Method: 将b加到a上并释放b，用于合并并行归约的部分和
+ * @param BIGNUM* a 部分和
+ * @param BIGNUM* b 部分和
+ * @return BIGNUM* a + b，存放在a中
+ */
+static BIGNUM* addBIGNUM(BIGNUM* a, BIGNUM* b) {
+    BN_add(a, a, b);
+    BN_free(b);
+    return a;
+}
+
+/**
+ * @Method: 在线程池中并行加密一块明文
+ * @param vector<BIGNUM*> x 明文
+ * @param vector<BIGNUM*>& c 密文，与x按下标一一对应
+ * @param PublicKey* pk 公钥
+ * @return void
+ */
+static void encryptAll(const vector<BIGNUM*> &x, vector<BIGNUM*> &c, PublicKey* pk) {
+    c.resize(x.size());
+    executor().parallel_for(0, x.size(), 0, [&](size_t b0, size_t b1) {
+        for (size_t i = b0; i < b1; i++) {
+            c[i] = encrypt_PHE(x[i], pk);
+        }
+    });
+}
+
+/**
+ * @Method: 根据内存预算计算每块的数据个数
+ * 每个密文在内存中保存一份，写出时在缓冲区中再保存一份
+ * @param size_t memoryBudget 内存预算，单位为字节
+ * @param size_t perElement 每个数据产生的密文个数
+ * @param BIGNUM* N 公开的模数
+ * @return size_t 每块的数据个数，至少为1
+ */
+static size_t chunkSize(size_t memoryBudget, size_t perElement, const BIGNUM* N) {
+    size_t bytes = PLAIN_BYTES + perElement * 2 * BN_num_bytes(N);
+    return max((size_t) 1, memoryBudget / bytes);
+}
+
+/**
+ * @Method: 将一列数据以二进制格式写入溢写文件
+ * @param string path 文件名
+ * @param string name 列名
+ * @param vector<BIGNUM*> values 列数据
+ * @return bool true:成功; false:写入失败
+ */
+static bool spill(const string &path, const string &name, const vector<BIGNUM*> &values) {
+    ResultWriter writer(path, OUTPUT_BINARY);
+    if (!writer.is_open()) {
+        cerr << "Unable to open file " << path << endl;
+        return false;
+    }
+    writer.writeColumn(name, values);
+    if (!writer.close()) {
+        cerr << "Unable to write file " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @Method: 密钥的编号，为N的SHA-256的前8个字节
+ * @param BIGNUM* N 公开的模数
+ * @return string 十六进制的编号
+ */
+static string keyId(const BIGNUM* N) {
+    vector<unsigned char> bytes(BN_num_bytes(N));
+    BN_bn2bin(N, bytes.data());
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(bytes.data(), bytes.size(), digest);
+    char hex[17];
+    for (int i = 0; i < 8; i++) {
+        snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+    return string(hex, 16);
+}
+
+/**
+ * @Method: 读取输入文件的大小和修改时间
+ * @param string fileString 输入文件
+ * @param long long* size 文件大小
+ * @param long long* time 修改时间
+ * @return bool true:成功; false:文件不存在
+ */
+static bool inputStamp(const string &fileString, long long* size, long long* time) {
+    struct stat st;
+    if (stat(fileString.c_str(), &st) != 0) {
+        return false;
+    }
+    *size = st.st_size;
+    *time = st.st_mtime;
+    return true;
+}
+
+/**
+ * @Method: 将BIGNUM转换为十六进制字符串
+ * @param BIGNUM* a 待转换的数
+ * @return string 十六进制字符串
+ */
+static string toHex(const BIGNUM* a) {
+    char* hex = BN_bn2hex(a);
+    string s(hex);
+    OPENSSL_free(hex);
+    return s;
+}
+
+/**
+ * @Method: 写入检查点，先写临时文件再重命名，任意时刻检查点文件都是完整的
+ * 检查点中含有私钥，文件权限为0600
+ * @param Checkpoint cp 检查点
+ * @return bool true:成功; false:写入失败
+ */
+static bool saveCheckpoint(const Checkpoint &cp) {
+    ostringstream out;
+    out << "version " << CHECKPOINT_VERSION << "\n";
+    out << "algo " << cp.algoName << "\n";
+    out << "input " << cp.inputSize << " " << cp.inputTime << "\n";
+    out << "key " << keyId(cp.pk->peek_N()) << "\n";
+    out << "params " << cp.pk->get_k_M() << " " << cp.pk->get_k_r() << " " << cp.pk->get_k_L() << " "
+        << cp.pk->get_k_p() << " " << cp.pk->get_k_q() << "\n";
+    out << "p " << toHex(cp.sk->peekP()) << "\n";
+    out << "L " << toHex(cp.sk->peekL()) << "\n";
+    out << "N " << toHex(cp.pk->peek_N()) << "\n";
+    out << "zero1 " << toHex(cp.pk->peek_zero1_prime()) << "\n";
+    out << "zero2 " << toHex(cp.pk->peek_zero2_prime()) << "\n";
+    out << "size " << cp.size << "\n";
+    out << "encrypted " << cp.encrypted << " " << cp.elements << " " << (cp.encryptDone ? 1 : 0) << "\n";
+    out << "aggregated " << cp.aggregated << "\n";
+    string content = out.str();
+
+    string temp = cp.path + ".tmp";
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    bool ok = fd >= 0 && write(fd, content.data(), content.size()) == (ssize_t) content.size();
+    ok = fd >= 0 && fsync(fd) == 0 && ok;
+    if (fd >= 0) {
+        ok = close(fd) == 0 && ok;
+    }
+    if (!ok || rename(temp.c_str(), cp.path.c_str()) != 0) {
+        cerr << "Unable to write file " << cp.path << endl;
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @Method: 读取检查点并将其中的密钥恢复到cp中，检查点须属于同一个算法和同一个未改变的输入文件
+ * @param Checkpoint& cp 检查点，path、algoName、inputSize和inputTime须已设置
+ * @return bool true:成功; false:没有检查点或检查点不匹配
+ */
+static bool loadCheckpoint(Checkpoint &cp) {
+    ifstream in(cp.path.c_str());
+    if (!in.is_open()) {
+        return false;
+    }
+    map<string, string> fields;
+    string line;
+    while (getline(in, line)) {
+        size_t space = line.find(' ');
+        if (space != string::npos) {
+            fields[line.substr(0, space)] = line.substr(space + 1);
+        }
+    }
+    long long inputSize = -1;
+    long long inputTime = -1;
+    istringstream(fields["input"]) >> inputSize >> inputTime;
+    if (atoi(fields["version"].c_str()) != CHECKPOINT_VERSION || fields["algo"] != cp.algoName
+        || inputSize != cp.inputSize || inputTime != cp.inputTime) {
+        cerr << "Checkpoint " << cp.path << " does not match " << cp.algoName << " on this input" << endl;
+        return false;
+    }
+
+    int params[5];
+    int encryptDone = 0;
+    istringstream(fields["params"]) >> params[0] >> params[1] >> params[2] >> params[3] >> params[4];
+    istringstream(fields["size"]) >> cp.size;
+    istringstream(fields["encrypted"]) >> cp.encrypted >> cp.elements >> encryptDone;
+    istringstream(fields["aggregated"]) >> cp.aggregated;
+    cp.encryptDone = encryptDone == 1;
+    const char* names[5] = {"p", "L", "N", "zero1", "zero2"};
+    BIGNUM* key[5] = {NULL, NULL, NULL, NULL, NULL};
+    bool ok = cp.size > 0 && cp.aggregated <= cp.encrypted;
+    for (int i = 0; i < 5; i++) {
+        ok = BN_hex2bn(&key[i], fields[names[i]].c_str()) > 0 && ok;
+    }
+    if (ok) {
+        restoreKeys_PHE(params, key[0], key[1], key[2], key[3], key[4], &cp.pk, &cp.sk);
+        ok = keyId(cp.pk->peek_N()) == fields["key"];
+    }
+    for (int i = 0; i < 5; i++) {
+        BN_free(key[i]);
+    }
+    if (!ok) {
+        cerr << "Unable to read checkpoint " << cp.path << endl;
+    }
+    return ok;
+}
+
+/**
+ * @Method: 开始分块执行：恢复时从检查点读取密钥和进度，否则生成新的密钥并写入初始检查点
+ * @param Checkpoint& cp 检查点
+ * @param string algoName 算法名称
+ * @param string fileString 读取数据的地址
+ * @param string spillPrefix 溢写文件的前缀
+ * @param size_t memoryBudget 内存预算，单位为字节
+ * @param size_t perElement 每个数据产生的密文个数
+ * @param bool resume 是否从检查点恢复
+ * @return bool true:成功; false:写入检查点失败
+ */
+static bool beginCheckpoint(Checkpoint &cp, const string &algoName, const string &fileString, const string &spillPrefix,
+                            size_t memoryBudget, size_t perElement, bool resume) {
+    cp.path = spillPrefix + ".checkpoint";
+    cp.algoName = algoName;
+    cp.spillPrefix = spillPrefix;
+    cp.inputSize = -1;
+    cp.inputTime = -1;
+    inputStamp(fileString, &cp.inputSize, &cp.inputTime);
+    if (resume && loadCheckpoint(cp)) {
+        printf("resuming %s from %s: %zu chunks encrypted%s, %zu aggregated\n", algoName.c_str(), cp.path.c_str(),
+               cp.encrypted, cp.encryptDone ? " (done)" : "", cp.aggregated);
+        fflush(stdout);
+        return true;
+    }
+
+    // 用户1生成公私钥，并将公钥发送给其它用户；复制一份给本任务，之后重新生成全局密钥不影响本任务
+    cp.releaseKeys();
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+    copyKeys_PHE(&cp.pk, &cp.sk);
+    cp.size = chunkSize(memoryBudget, perElement, cp.pk->peek_N());
+    cp.encrypted = 0;
+    cp.elements = 0;
+    cp.encryptDone = false;
+    cp.aggregated = 0;
+    return saveCheckpoint(cp);
+}
+
+/**
+ * @Method: 结束分块执行。成功时删除溢写文件和检查点；失败时保留，之后可以从检查点恢复
+ * @param Checkpoint cp 检查点
+ * @param bool ok 是否成功
+ * @return void
+ */
+static void endCheckpoint(const Checkpoint &cp, bool ok) {
+    if (ok) {
+        removeSpill(cp.spillPrefix, cp.encrypted);
+        unlink(cp.path.c_str());
+    } else {
+        cerr << "Keeping checkpoint " << cp.path << " for resume" << endl;
+    }
+}
+
+/**
+ * @Method: 跳过数据流中的前n个数据
+ * @param BIGNUMStream& xs 数据流
+ * @param size_t n 跳过的个数
+ * @param size_t size 每次读取的个数
+ * @return bool true:成功; false:数据不足n个
+ */
+static bool skipValues(BIGNUMStream &xs, size_t n, size_t size) {
+    vector<BIGNUM*> x;
+    while (n > 0) {
+        size_t got = xs.next(x, min(n, size));
+        freeAll(x);
+        if (got == 0) {
+            return false;
+        }
+        n -= got;
+    }
+    return true;
+}
+
+/**
+ * @Method: 加密阶段，逐块读取明文并加密，密文块写入溢写文件，每写入一块更新检查点
+ * 从检查点恢复时跳过已加密的数据，从下一块继续
+ * @param BIGNUMStream& xs 明文数据流
+ * @param Checkpoint& cp 检查点
+ * @param function encrypt 将一块明文加密，参数依次为明文、第一个数据的下标和密文
+ * @return bool true:成功; false:读写失败
+ */
+static bool encryptChunks(BIGNUMStream &xs, Checkpoint &cp,
+                          const function<void(const vector<BIGNUM*>&, size_t, vector<BIGNUM*>&)> &encrypt) {
+    if (cp.encryptDone) {
+        return true;
+    }
+    if (!skipValues(xs, cp.elements, cp.size)) {
+        cerr << "Unable to skip " << cp.elements << " encrypted values" << endl;
+        return false;
+    }
+    vector<BIGNUM*> x;
+    vector<BIGNUM*> c;
+    while (xs.next(x, cp.size) > 0) {
+        encrypt(x, cp.elements, c);
+        bool ok = spill(spillFile(cp.spillPrefix, "chunk", cp.encrypted), "cipher", c);
+        cp.encrypted++;
+        cp.elements += x.size();
+        freeAll(x);
+        freeAll(c);
+        if (!ok || !saveCheckpoint(cp)) {
+            return false;
+        }
+    }
+    cp.encryptDone = true;
+    return saveCheckpoint(cp);
+}
+
+/**
+ * @Method: 聚合阶段，逐块映射密文并聚合，部分聚合结果写入溢写文件并更新检查点后删除密文块
+ * 从检查点恢复时跳过已聚合的块
+ * @param Checkpoint& cp 检查点
+ * @param size_t k 每块聚合结果的个数
+ * @param function aggregate 将一块密文累加到k个初始为0的和中，参数依次为密文列、块号和部分和
+ * @return bool true:成功; false:读写失败
+ */
+static bool aggregateChunks(Checkpoint &cp, size_t k,
+                            const function<void(const ResultColumn&, size_t, vector<BIGNUM*>&)> &aggregate) {
+    for (size_t i = cp.aggregated; i < cp.encrypted; i++) {
+        string path = spillFile(cp.spillPrefix, "chunk", i);
+        vector<BIGNUM*> sums(k);
+        {
+            ResultReader reader(path);
+            const ResultColumn* cipher = reader.is_open() ? reader.column("cipher") : NULL;
+            if (cipher == NULL) {
+                cerr << "Unable to read file " << path << endl;
+                return false;
+            }
+            for (size_t j = 0; j < k; j++) {
+                sums[j] = BN_new();
+                BN_zero(sums[j]);
+            }
+            aggregate(*cipher, i, sums);
+        }
+
+        bool ok = spill(spillFile(cp.spillPrefix, "partial", i), "sum", sums);
+        freeAll(sums);
+        cp.aggregated = i + 1;
+        if (!ok || !saveCheckpoint(cp)) {
+            return false;
+        }
+        unlink(path.c_str());
+    }
+    return true;
+}
+
+/**
+ * @Method: 合并所有块的部分聚合结果
+ * @param string prefix 溢写文件的前缀
+ * @param size_t chunks 块数
+ * @param size_t k 每块聚合结果的个数
+ * @param BIGNUM* modulus 每次相加后对其取模，为NULL时不取模
+ * @return vector<BIGNUM*> 合并后的k个和，失败时为空
+ */
+static vector<BIGNUM*> mergePartials(const string &prefix, size_t chunks, size_t k, const BIGNUM* modulus) {
+    BN_CTX* ctx = BN_CTX_new();
+    vector<BIGNUM*> sums(k);
+    for (size_t j = 0; j < k; j++) {
+        sums[j] = BN_new();
+        BN_zero(sums[j]);
+    }
+
+    for (size_t i = 0; i < chunks; i++) {
+        string path = spillFile(prefix, "partial", i);
+        ResultReader reader(path);
+        const ResultColumn* partial = reader.is_open() ? reader.column("sum") : NULL;
+        if (partial == NULL || partial->count != k) {
+            cerr << "Unable to read file " << path << endl;
+            freeAll(sums);
+            break;
+        }
+        for (size_t j = 0; j < k; j++) {
+            BIGNUM* t = partial->get(j);
+            BN_add(sums[j], sums[j], t);
+            if (modulus != NULL) {
+                BN_mod(sums[j], sums[j], modulus, ctx);
+            }
+            BN_free(t);
+        }
+    }
+
+    BN_CTX_free(ctx);
+    return sums;
+}
+
+/**
+ * @Method: 读取文件第1行的分箱个数k
+ * @param string fileString 读取数据的地址
+ * @return int 分箱个数，读取失败时为0
+ */
+static int readK(const string &fileString) {
+    vector<BIGNUM*> first;
+    BIGNUMStream ks(fileString, 1);
+    ks.next(first, 1);
+    if (first.empty()) {
+        cerr << "Unable to read k from " << fileString << endl;
+        return 0;
+    }
+    int k = static_cast<int>(BN_get_word(first[0]));
+    freeAll(first);
+    return k;
+}
+
+/**
+ * @Method: 分块计算均值
+ * @param string fileString 读取数据的地址，所有行的数据都参与计算
+ * @param string spillPrefix 溢写文件的前缀
+ * @param size_t memoryBudget 内存预算，单位为字节
+ * @return BIGNUM* avg 均值，失败时为NULL
+ */
+BIGNUM* avg_chunked_PHE(const string &fileString, const string &spillPrefix, size_t memoryBudget, bool resume) {
+    BIGNUMStream xs(fileString, 0);
+    if (!xs.is_open()) {
+        cerr << "Unable to open file " << fileString << endl;
+        return NULL;
+    }
+
+    // 用户1生成公私钥（或从检查点恢复），并将公钥发送给其它用户
+    Checkpoint cp;
+    if (!beginCheckpoint(cp, "avg", fileString, spillPrefix, memoryBudget, 1, resume)) {
+        return NULL;
+    }
+
+    // 每个用户将数据加密，密文按块溢写
+    bool ok = encryptChunks(xs, cp, [&](const vector<BIGNUM*> &x, size_t /*index*/, vector<BIGNUM*> &c) {
+        encryptAll(x, c, cp.pk);
+    });
+
+    // 由用户2逐块计算密文的和
+    const BIGNUM* N = cp.pk->peek_N();
+    ok = ok && aggregateChunks(cp, 1, [&](const ResultColumn &cipher, size_t /*chunk*/, vector<BIGNUM*> &sums) {
+        BIGNUM* part = executor().parallel_reduce((size_t) 0, (size_t) cipher.count, 0, BN_dup(sums[0]), [&](size_t b0, size_t b1) {
+            BIGNUM* s = BN_new();
+            BN_zero(s);
+            for (size_t i = b0; i < b1; i++) {
+                BIGNUM* t = cipher.get(i);
+                BN_add(s, s, t);
+                BN_mod(s, s, N, localCTX());
+                BN_free(t);
+            }
+            return s;
+        }, [&](BIGNUM* a, BIGNUM* b) {
+            BN_add(a, a, b);
+            BN_mod(a, a, N, localCTX());
+            BN_free(b);
+            return a;
+        });
+        BN_free(sums[0]);
+        sums[0] = part;
+    });
+    vector<BIGNUM*> sum;
+    if (ok) {
+        sum = mergePartials(spillPrefix, cp.encrypted, 1, N);
+    }
+    endCheckpoint(cp, !sum.empty());
+    if (sum.empty()) {
+        return NULL;
+    }
+    size_t count = cp.elements;
+    if (count == 0) {
+        cerr << "Unable to read data from " << fileString << endl;
+        freeAll(sum);
+        return NULL;
+    }
+
+    // 由用户1利用私钥恢复出sum，然后再计算均值
+    BN_CTX* ctx = BN_CTX_new();
+    BIGNUM* plain = decrypt_PHE(sum[0], cp.sk);
+    BIGNUM* avg = BN_new();
+    BIGNUM* temp = BN_new();
+    BN_set_word(temp, count);
+    BN_div(avg, NULL, plain, temp, ctx);
+
+    // 释放临时变量
+    freeAll(sum);
+    BN_free(plain);
+    BN_free(temp);
+    BN_CTX_free(ctx);
+    return avg;
+}
+
+/**
+ * @Method: 分块计算内积
+ * @param string fileString 读取数据的地址，第1行为DO1的数据，第2行为DO2的数据
+ * @param string spillPrefix 溢写文件的前缀
+ * @param size_t memoryBudget 内存预算，单位为字节
+ * @return BIGNUM* inner_product 内积，失败时为NULL
+ */
+BIGNUM* inner_product_chunked_PHE(const string &fileString, const string &spillPrefix, size_t memoryBudget, bool resume) {
+    BIGNUMStream xs(fileString, 1);
+    BIGNUMStream ys(fileString, 2);
+    if (!xs.is_open() || !ys.is_open()) {
+        cerr << "Unable to open file " << fileString << endl;
+        return NULL;
+    }
+
+    // 用户1生成公私钥（或从检查点恢复），并将公钥发送给用户2
+    Checkpoint cp;
+    if (!beginCheckpoint(cp, "inner_product", fileString, spillPrefix, memoryBudget, 1, resume)) {
+        return NULL;
+    }
+
+    // 用户1将持有的数据加密，密文按块溢写
+    bool ok = encryptChunks(xs, cp, [&](const vector<BIGNUM*> &x, size_t /*index*/, vector<BIGNUM*> &c) {
+        encryptAll(x, c, cp.pk);
+    });
+
+    // 用户2逐块读取自己对应下标的数据，与密文相乘并累加；已聚合的块除最后一块外都是满的
+    ok = ok && skipValues(ys, cp.aggregated * cp.size, cp.size);
+    ok = ok && aggregateChunks(cp, 1, [&](const ResultColumn &cipher, size_t /*chunk*/, vector<BIGNUM*> &sums) {
+        vector<BIGNUM*> y;
+        ys.next(y, cipher.count);
+        BIGNUM* part = executor().parallel_reduce((size_t) 0, y.size(), 0, BN_dup(sums[0]), [&](size_t b0, size_t b1) {
+            BIGNUM* s = BN_new();
+            BIGNUM* t = BN_new();
+            BN_zero(s);
+            for (size_t i = b0; i < b1; i++) {
+                BIGNUM* c = cipher.get(i);
+                BN_mul(t, c, y[i], localCTX());
+                BN_add(s, s, t);
+                BN_free(c);
+            }
+            BN_free(t);
+            return s;
+        }, addBIGNUM);
+        BN_free(sums[0]);
+        sums[0] = part;
+        freeAll(y);
+    });
+    vector<BIGNUM*> inner_product;
+    if (ok) {
+        inner_product = mergePartials(spillPrefix, cp.encrypted, 1, NULL);
+    }
+    endCheckpoint(cp, !inner_product.empty());
+    if (inner_product.empty()) {
+        return NULL;
+    }
+
+    // 用户1接收inner_product并解密
+    BIGNUM* result = decrypt_PHE(inner_product[0], cp.sk);
+    freeAll(inner_product);
+    return result;
+}
+
+/**
+ * @Method: 分块计算每个分箱数据出现的频率，不再物化n * k的密文矩阵
+ * @param string fileString 读取数据的地址，第1行为分箱个数k，第2行为待分箱的数据
+ * @param string spillPrefix 溢写文件的前缀
+ * @param size_t memoryBudget 内存预算，单位为字节
+ * @return vector<BIGNUM*> 分箱频率，失败时为空
+ */
+vector<BIGNUM*> frequency_chunked_PHE(const string &fileString, const string &spillPrefix, size_t memoryBudget, bool resume) {
+    vector<BIGNUM*> frequency;
+    int k = readK(fileString);
+    if (k <= 0) {
+        return frequency;
+    }
+
+    // 第一遍扫描求最小值和最大值，确定分箱范围
+    BIGNUM* min;
+    BIGNUM* max;
+    if (!minmax_stream(fileString, 2, &min, &max)) {
+        cerr << "Unable to read data from " << fileString << endl;
+        return frequency;
+    }
+    vector<Bin> box = makeBins_PHE(min, max, k);
+
+    // 用户1生成公私钥（或从检查点恢复），并将公钥公开
+    Checkpoint cp;
+    if (!beginCheckpoint(cp, "frequency", fileString, spillPrefix, memoryBudget, k, resume)) {
+        for (int j = 0; j < k; j++) {
+            BN_free(box[j].lower);
+            BN_free(box[j].upper);
+        }
+        BN_free(min);
+        BN_free(max);
+        return frequency;
+    }
+
+    BIGNUM* zero = BN_new();
+    BIGNUM* one = BN_new();
+    BN_zero(zero);
+    BN_one(one);
+
+    // 每个用户构造一个k维的向量，该用户持有数据的对应分箱位标记为1，其余为0，并将向量加密
+    BIGNUMStream xs(fileString, 2);
+    bool ok = encryptChunks(xs, cp, [&](const vector<BIGNUM*> &x, size_t index, vector<BIGNUM*> &c) {
+        vector<int> bins;
+        binIndex_PHE(x, box, bins);
+        c.resize(x.size() * k);
+        executor().parallel_for(0, x.size(), 0, [&](size_t b0, size_t b1) {
+            for (size_t i = b0; i < b1; i++) {
+                for (int j = 0; j < k; j++) {
+                    BIGNUM* flag = j == bins[i] ? one : zero;
+                    // 第2个用户除外
+                    c[i * k + j] = index + i != 1 ? encrypt_PHE(flag, cp.pk) : BN_dup(flag);
+                }
+            }
+        });
+    });
+
+    // 用户2逐块累加每个分箱的频率
+    ok = ok && aggregateChunks(cp, k, [&](const ResultColumn &cipher, size_t /*chunk*/, vector<BIGNUM*> &sums) {
+        executor().parallel_for(0, k, 1, [&](size_t j0, size_t j1) {
+            for (size_t j = j0; j < j1; j++) {
+                for (size_t i = j; i < cipher.count; i += k) {
+                    BIGNUM* t = cipher.get(i);
+                    BN_add(sums[j], sums[j], t);
+                    BN_free(t);
+                }
+            }
+        });
+    });
+    vector<BIGNUM*> sums;
+    if (ok) {
+        sums = mergePartials(spillPrefix, cp.encrypted, k, NULL);
+    }
+    endCheckpoint(cp, !sums.empty());
+
+    // 用户1接收分箱频率并解密
+    for (size_t j = 0; j < sums.size(); j++) {
+        frequency.push_back(decrypt_PHE(sums[j], cp.sk));
+    }
+
+    // 释放临时变量
+    freeAll(sums);
+    for (int j = 0; j < k; j++) {
+        BN_free(box[j].lower);
+        BN_free(box[j].upper);
+    }
+    BN_free(min);
+    BN_free(max);
+    BN_free(zero);
+    BN_free(one);
+    return frequency;
+}
+
+/**
+ * @Method: 分块将数据分箱，每块数据按分箱溢写，最后按分箱顺序写入结果
+ * 结果的格式与deal中split的输出相同
+ * @param string fileString 读取数据的地址，第1行为分箱个数k，第2行为待分箱的数据
+ * @param string spillPrefix 溢写文件的前缀
+ * @param size_t memoryBudget 内存预算，单位为字节
+ * @param ResultWriter* writer 结果写入器
+ * @return 状态码，1：成功；0：失败
+ */
+int split_chunked_PHE(const string &fileString, const string &spillPrefix, size_t memoryBudget, ResultWriter* writer) {
+    int k = readK(fileString);
+    if (k <= 0) {
+        return 0;
+    }
+
+    // 第一遍扫描求最小值和最大值，确定分箱范围
+    BIGNUM* min;
+    BIGNUM* max;
+    if (!minmax_stream(fileString, 2, &min, &max)) {
+        cerr << "Unable to read data from " << fileString << endl;
+        return 0;
+    }
+    vector<Bin> box = makeBins_PHE(min, max, k);
+
+    // 第二遍扫描，每块数据按分箱写入一个溢写文件，第j列为第j个分箱的元素
+    size_t chunks = 0;
+    vector<int64_t> counts(k, 0);
+    BIGNUMStream xs(fileString, 2);
+    vector<BIGNUM*> x;
+    bool ok = true;
+    while (ok && xs.next(x, std::max((size_t) 1, memoryBudget / PLAIN_BYTES)) > 0) {
+        vector<int> bins;
+        binIndex_PHE(x, box, bins);
+        vector<vector<BIGNUM*> > elements(k);
+        for (size_t i = 0; i < x.size(); i++) {
+            elements[bins[i]].push_back(x[i]);
+        }
+
+        string path = spillFile(spillPrefix, "chunk", chunks++);
+        ResultWriter chunk(path, OUTPUT_BINARY);
+        if (chunk.is_open()) {
+            for (int j = 0; j < k; j++) {
+                chunk.writeColumn("bin", elements[j]);
+                counts[j] += elements[j].size();
+            }
+        }
+        if (!chunk.close()) {
+            cerr << "Unable to write file " << path << endl;
+            ok = false;
+        }
+        freeAll(x);
+    }
+
+    // 按分箱顺序合并所有块
+    vector<ResultReader*> readers;
+    for (size_t c = 0; ok && c < chunks; c++) {
+        string path = spillFile(spillPrefix, "chunk", c);
+        readers.push_back(new ResultReader(path));
+        if (!readers.back()->is_open() || readers.back()->columns().size() != (size_t) k) {
+            cerr << "Unable to read file " << path << endl;
+            ok = false;
+        }
+    }
+    if (ok && writer->binary()) {
+        // 按列输出分箱范围，元素按分箱顺序拼接，offsets[i]为第i个分箱的第一个元素的下标
+        vector<BIGNUM*> lower(k);
+        vector<BIGNUM*> upper(k);
+        vector<int64_t> offsets(k + 1, 0);
+        for (int i = 0; i < k; i++) {
+            lower[i] = box[i].lower;
+            upper[i] = box[i].upper;
+            offsets[i + 1] = offsets[i] + counts[i];
+        }
+        writer->writeColumn("lower", lower);
+        writer->writeColumn("upper", upper);
+        writer->writeColumn("offsets", offsets);
+
+        // 元素都在[min, max]之间，由最值确定列的类型和宽度
+        int64_t v;
+        if (BN_to_int64(min, &v) && BN_to_int64(max, &v)) {
+            writer->beginColumn("elements", offsets[k], RESULT_INT64, sizeof(int64_t));
+        } else {
+            writer->beginColumn("elements", offsets[k], RESULT_BIGNUM, std::max(BN_num_bytes(min), BN_num_bytes(max)) + 1);
+        }
+        for (int i = 0; i < k; i++) {
+            for (size_t c = 0; c < chunks; c++) {
+                const ResultColumn &col = readers[c]->columns()[i];
+                for (size_t j = 0; j < col.count; j++) {
+                    BIGNUM* e = col.get(j);
+                    writer->writeValue(e);
+                    BN_free(e);
+                }
+            }
+        }
+        writer->endColumn();
+    } else if (ok) {
+        for (int i = 0; i < k; i++) {
+            writer->writeText("lower: ");
+            writer->writeBIGNUM(box[i].lower);
+            writer->writeText("\nupper: ");
+            writer->writeBIGNUM(box[i].upper);
+            writer->writeText("\nbox[" + to_string(i) + "].elements: ");
+            for (size_t c = 0; c < chunks; c++) {
+                const ResultColumn &col = readers[c]->columns()[i];
+                for (size_t j = 0; j < col.count; j++) {
+                    BIGNUM* e = col.get(j);
+                    writer->writeBIGNUM(e);
+                    writer->writeText(" ");
+                    BN_free(e);
+                }
+            }
+            writer->writeText("\n");
+        }
+    }
+
+    // 释放临时变量
+    for (size_t c = 0; c < readers.size(); c++) {
+        delete readers[c];
+    }
+    removeSpill(spillPrefix, chunks);
+    for (int j = 0; j < k; j++) {
+        BN_free(box[j].lower);
+        BN_free(box[j].upper);
+    }
+    BN_free(min);
+    BN_free(max);
+    return ok ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Out-of-core chunked execution with a memory budget
+*/
+
+#ifndef CHUNKED_H
+#define CHUNKED_H
+
+#include <bits/stdc++.h>
+#include <openssl/bn.h>
+#include "IO.h"
+using namespace std;
+
+/*
+ * 分块执行模式：
+ *   1. 按内存预算确定每块的数据个数，逐块读取明文并加密，密文块以二进制格式溢写到spillPrefix.chunk.<i>
+ *   2. 逐块映射密文文件并聚合，每块的部分聚合结果溢写到spillPrefix.partial.<i>，随后删除密文块
+ *   3. 合并所有部分聚合结果并解密，删除所有溢写文件
+ * 任意时刻内存中最多只有一块明文或密文。
+ * avg、inner_product和frequency每完成一块的加密或聚合后把密钥和进度写入检查点spillPrefix.checkpoint，
+ * 进程中断后以resume重新执行同一任务，会沿用检查点中的密钥和块大小，从下一块继续；
+ * 失败时保留溢写文件和检查点，成功后删除
+ */
+
+/**
+ * @Method: 分块计算均值
+ * @param string fileString 读取数据的地址，所有行的数据都参与计算
+ * @param string spillPrefix 溢写文件的前缀
+ * @param size_t memoryBudget 内存预算，单位为字节
+ * @param bool resume 是否从检查点恢复
+ * @return BIGNUM* avg 均值，失败时为NULL
+ */
+BIGNUM* avg_chunked_PHE(const string &fileString, const string &spillPrefix, size_t memoryBudget, bool resume = false);
+
+/**
+ * @Method: 分块计算内积
+ * @param string fileString 读取数据的地址，第1行为DO1的数据，第2行为DO2的数据
+ * @param string spillPrefix 溢写文件的前缀
+ * @param size_t memoryBudget 内存预算，单位为字节
+ * @param bool resume 是否从检查点恢复
+ * @return BIGNUM* inner_product 内积，失败时为NULL
+ */
+BIGNUM* inner_product_chunked_PHE(const string &fileString, const string &spillPrefix, size_t memoryBudget, bool resume = false);
+
+/**
+ * @Method: 分块计算每个分箱数据出现的频率，不再物化n * k的密文矩阵
+ * @param string fileString 读取数据的地址，第1行为分箱个数k，第2行为待分箱的数据
+ * @param string spillPrefix 溢写文件的前缀
+ * @param size_t memoryBudget 内存预算，单位为字节
+ * @param bool resume 是否从检查点恢复
+ * @return vector<BIGNUM*> 分箱频率，失败时为空
+ */
+vector<BIGNUM*> frequency_chunked_PHE(const string &fileString, const string &spillPrefix, size_t memoryBudget, bool resume = false);
+
+/**
+ * @Method: 分块将数据分箱，每块数据按分箱溢写，最后按分箱顺序写入结果
+ * 结果的格式与deal中split的输出相同
+ * @param string fileString 读取数据的地址，第1行为分箱个数k，第2行为待分箱的数据
+ * @param string spillPrefix 溢写文件的前缀
+ * @param size_t memoryBudget 内存预算，单位为字节
+ * @param ResultWriter* writer 结果写入器
+ * @return 状态码，1：成功；0：失败
+ */
+int split_chunked_PHE(const string &fileString, const string &spillPrefix, size_t memoryBudget, ResultWriter* writer);
+
+#endif //CHUNKED_H
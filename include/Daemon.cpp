@@ -0,0 +1,154 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Long-running service that keeps keys warm and runs deal() jobs
+*/
+
+#include "SHE.h"
+#include "PHE.h"
+#include "Transport.h"
+#include "Daemon.h"
+#include <sys/socket.h>
+#include <unistd.h>
+using namespace std;
+
+// 未指定输出文件的任务使用的临时文件编号
+static atomic<unsigned long> jobCounter(0);
+
+/**
+ * @Method: 读取整个文件
+ * @param string filename 文件名
+ * @param string& content 文件内容
+ * @return bool true:成功; false:打开失败
+ */
+static bool readWholeFile(const string &filename, string &content) {
+    ifstream in(filename.c_str(), ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    ostringstream buffer;
+    buffer << in.rdbuf();
+    content = buffer.str();
+    return true;
+}
+
+/**
+ * @Method: 执行一个任务
+ * @param string socketPath 套接字文件，用于生成临时文件名
+ * @param string request FRAME_JOB的内容
+ * @return string FRAME_RESULT的内容
+ */
+static string runJob(const string &socketPath, const string &request) {
+    vector<string> fields;
+    istringstream in(request);
+    string field;
+    while (getline(in, field)) {
+        fields.push_back(field);
+    }
+    if (fields.size() < 3) {
+        return string(1, '\0');
+    }
+
+    DealOptions options;
+    if (fields.size() > 3 && fields[3] == "binary") {
+        options.format = OUTPUT_BINARY;
+    }
+    // 没有指定输出文件时写入临时文件，再把内容返回给客户端
+    string resultFilePath = fields[2];
+    bool returnResult = resultFilePath.empty();
+    if (returnResult) {
+        resultFilePath = socketPath + ".job" + to_string(getpid()) + "." + to_string(jobCounter++);
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int status = deal(fields[0], fields[1], resultFilePath, options);
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    printf("job %s %s: status %d, %f ms\n", fields[0].c_str(), fields[1].c_str(), status, elapsed);
+    fflush(stdout);
+
+    string reply(1, (char) status);
+    if (returnResult) {
+        string content;
+        if (status && readWholeFile(resultFilePath, content)) {
+            reply += content;
+        }
+        unlink(resultFilePath.c_str());
+    }
+    return reply;
+}
+
+/**
+ * @Method: 处理一个连接上的所有任务，连接关闭后返回
+ * @param Channel* channel 信道
+ * @param string socketPath 套接字文件
+ * @return void
+ */
+static void serveConnection(Channel* channel, const string &socketPath) {
+    uint8_t type;
+    string request;
+    while (channel->recvFrame(&type, request) && type == FRAME_JOB) {
+        if (!channel->sendFrame(FRAME_RESULT, runJob(socketPath, request))) {
+            break;
+        }
+    }
+    delete channel;
+}
+
+/**
+ * @Method: 以常驻进程运行，在Unix域套接字上接受任务
+ * @param string socketPath 套接字文件
+ * @return 状态码，0：无法监听；正常情况下不返回
+ */
+int runDaemon(const string &socketPath) {
+    // 生成一次密钥，之后的任务都复用
+    setKeyReuse_PHE(true);
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+
+    int server = listenSocket("unix:" + socketPath, SOMAXCONN);
+    if (server < 0) {
+        cerr << "Unable to listen on " << socketPath << endl;
+        return 0;
+    }
+    printf("daemon listening on %s\n", socketPath.c_str());
+    fflush(stdout);
+
+    while (true) {
+        int fd = acceptSocket(server);
+        if (fd < 0) {
+            cerr << "Unable to accept on " << socketPath << endl;
+            close(server);
+            return 0;
+        }
+        thread(serveConnection, new SocketChannel(fd), socketPath).detach();
+    }
+}
+
+/**
+ * @Method: 向常驻进程提交一个任务并等待完成
+ * @param string socketPath 套接字文件
+ * @param string algoName 调用的算法名称
+ * @param string fileString 读取数据的地址
+ * @param string resultFilePath 输出数据的地址，为空时由常驻进程返回结果
+ * @param string& result 返回的结果，resultFilePath非空时为空
+ * @param bool binary 是否以二进制格式输出
+ * @return 状态码，1：成功；0：失败
+ */
+int submitJob(const string &socketPath, const string &algoName, const string &fileString,
+              const string &resultFilePath, string &result, bool binary) {
+    Channel* channel = openChannel("unix:" + socketPath, false);
+    if (channel == NULL) {
+        return 0;
+    }
+    string request = algoName + "\n" + fileString + "\n" + resultFilePath + "\n" + (binary ? "binary" : "text");
+    uint8_t type;
+    string reply;
+    bool ok = channel->sendFrame(FRAME_JOB, request) && channel->recvFrame(&type, reply)
+              && type == FRAME_RESULT && !reply.empty();
+    delete channel;
+    if (!ok) {
+        cerr << "Unable to run job on " << socketPath << endl;
+        return 0;
+    }
+    result = reply.substr(1);
+    return reply[0];
+}
@@ -0,0 +1,35 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Long-running service that keeps keys warm and runs deal() jobs
+*/
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+/**
+ * @Method: 以常驻进程运行，在Unix域套接字上接受任务
+ * 启动时生成一次密钥并开启密钥复用，之后每个任务只包含读取输入和计算的时间；
+ * 每个连接由一个线程处理，连接上的任务依次执行，不同连接的任务并发执行，共用全局线程池
+ * @param string socketPath 套接字文件
+ * @return 状态码，0：无法监听；正常情况下不返回
+ */
+int runDaemon(const string &socketPath);
+
+/**
+ * @Method: 向常驻进程提交一个任务并等待完成
+ * @param string socketPath 套接字文件
+ * @param string algoName 调用的算法名称
+ * @param string fileString 读取数据的地址
+ * @param string resultFilePath 输出数据的地址，为空时由常驻进程返回结果
+ * @param string& result 返回的结果，resultFilePath非空时为空
+ * @param bool binary 是否以二进制格式输出
+ * @return 状态码，1：成功；0：失败
+ */
+int submitJob(const string &socketPath, const string &algoName, const string &fileString,
+              const string &resultFilePath, string &result, bool binary = false);
+
+#endif //DAEMON_H
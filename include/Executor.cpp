@@ -0,0 +1,495 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Work-stealing thread pool, parallel loops and task graphs
+*/
+
+#include "Executor.h"
+#include <openssl/bn.h>
+#include <pthread.h>
+#include <sched.h>
+using namespace std;
+
+// 自动划分时每个线程分到的块数，块数多于线程数可以平衡各块耗时的差异
+static const size_t BLOCKS_PER_THREAD = 4;
+
+// 空闲线程单次等待的最长时间，避免错过唤醒
+static const chrono::milliseconds IDLE_WAIT(1);
+
+// 当前线程所属的线程池和队列编号，外部线程为NULL和0
+static thread_local ThreadPool* currentPool = NULL;
+static thread_local int currentQueue = 0;
+
+// 绑核的工作线程所在的NUMA节点，未绑核时为-1
+static thread_local int pinnedNode = -1;
+
+// 本进程可用的CPU及其所在的NUMA节点
+struct Topology {
+    // 按节点排列的CPU编号，同一节点的CPU相邻
+    vector<int> cpus;
+    // cpus[i]所在的节点，节点重新编号为0, 1, ...
+    vector<int> nodes;
+    // CPU编号到节点的映射，不可用的CPU为0
+    vector<int> nodeOfCpu;
+    int nodeCount;
+};
+
+/**
+ * @Method: 解析形如0-3,8-11的CPU列表
+ * @param string list CPU列表
+ * @return vector<int> CPU编号
+ */
+static vector<int> parseCpuList(const string &list) {
+    vector<int> cpus;
+    istringstream in(list);
+    string range;
+    while (getline(in, range, ',')) {
+        int first = 0;
+        int last = 0;
+        if (sscanf(range.c_str(), "%d-%d", &first, &last) == 2) {
+            for (int c = first; c <= last; c++) {
+                cpus.push_back(c);
+            }
+        } else if (sscanf(range.c_str(), "%d", &first) == 1) {
+            cpus.push_back(first);
+        }
+    }
+    return cpus;
+}
+
+/**
+ * @Method: 读取NUMA拓扑，只保留本进程允许使用的CPU；没有/sys/devices/system/node时视为一个节点
+ * @return Topology& 拓扑，首次调用时读取
+ */
+static const Topology &topology() {
+    static Topology topo;
+    static once_flag once;
+    call_once(once, [] {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            for (int c = 0; c < CPU_SETSIZE; c++) {
+                CPU_SET(c, &allowed);
+            }
+        }
+        topo.nodeCount = 0;
+        topo.nodeOfCpu.assign(CPU_SETSIZE, 0);
+        for (int node = 0; node < CPU_SETSIZE; node++) {
+            ifstream in(("/sys/devices/system/node/node" + to_string(node) + "/cpulist").c_str());
+            if (!in.is_open()) {
+                continue;
+            }
+            string list;
+            getline(in, list);
+            bool used = false;
+            vector<int> cpus = parseCpuList(list);
+            for (size_t i = 0; i < cpus.size(); i++) {
+                if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE && CPU_ISSET(cpus[i], &allowed)) {
+                    topo.cpus.push_back(cpus[i]);
+                    topo.nodes.push_back(topo.nodeCount);
+                    topo.nodeOfCpu[cpus[i]] = topo.nodeCount;
+                    used = true;
+                }
+            }
+            topo.nodeCount += used ? 1 : 0;
+        }
+        if (topo.cpus.empty()) {
+            for (int c = 0; c < CPU_SETSIZE; c++) {
+                if (CPU_ISSET(c, &allowed)) {
+                    topo.cpus.push_back(c);
+                    topo.nodes.push_back(0);
+                }
+            }
+            topo.nodeCount = 1;
+        }
+    });
+    return topo;
+}
+
+TaskGroup::TaskGroup(ThreadPool &pool) : pool(pool), pending(0) {
+}
+
+TaskGroup::~TaskGroup() {
+    wait();
+}
+
+/**
+ * @Method: 派生一个任务，放入当前线程的任务队列
+ * @param function<void()> fn 任务
+ * @return void
+ */
+void TaskGroup::run(const function<void()> &fn) {
+    ThreadPool::Task* task = new ThreadPool::Task();
+    task->fn = fn;
+    task->group = this;
+    pending++;
+    pool.push(task);
+}
+
+/**
+ * @Method: 等待组内所有任务完成，等待期间当前线程也执行或窃取任务
+ * @return void
+ */
+void TaskGroup::wait() {
+    while (pending > 0) {
+        ThreadPool::Task* task = pool.pop();
+        if (task != NULL) {
+            pool.execute(task);
+        } else {
+            pool.idle([this] { return pending == 0; });
+        }
+    }
+}
+
+ThreadPool::ThreadPool(int threads, bool pin) : queued(0), stopping(false) {
+    this->threads = max(1, threads);
+    this->pin = pin;
+    for (int i = 0; i < this->threads; i++) {
+        queues.push_back(new Queue());
+    }
+    for (int i = 1; i < this->threads; i++) {
+        workers.push_back(thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    stopping = true;
+    {
+        lock_guard<mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+    for (size_t i = 0; i < queues.size(); i++) {
+        delete queues[i];
+    }
+}
+
+/**
+ * @Method: 确定每块的下标个数
+ * @param size_t n 下标总数
+ * @param size_t grain 指定的块大小，为0时自动确定
+ * @return size_t 每块的下标个数，至少为1
+ */
+size_t ThreadPool::grainSize(size_t n, size_t grain) {
+    if (grain == 0) {
+        grain = n / (threads * BLOCKS_PER_THREAD);
+    }
+    return max((size_t) 1, grain);
+}
+
+/**
+ * @Method: 当前线程使用的队列编号
+ * @return int 工作线程为自己的队列，外部线程为0
+ */
+int ThreadPool::localQueue() {
+    return currentPool == this ? currentQueue : 0;
+}
+
+/**
+ * @Method: 将任务放入当前线程的队列并唤醒一个空闲线程
+ * @param Task* task 任务
+ * @return void
+ */
+void ThreadPool::push(Task* task) {
+    Queue* q = queues[localQueue()];
+    {
+        lock_guard<mutex> lock(q->m);
+        q->tasks.push_back(task);
+    }
+    queued++;
+    {
+        lock_guard<mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+/**
+ * @Method: 取出一个任务，先从自己队列的队尾取，再依次从其它队列的队首窃取
+ * @return Task* 任务，没有任务时为NULL
+ */
+ThreadPool::Task* ThreadPool::pop() {
+    if (queued == 0) {
+        return NULL;
+    }
+    int self = localQueue();
+    {
+        Queue* q = queues[self];
+        lock_guard<mutex> lock(q->m);
+        if (!q->tasks.empty()) {
+            Task* task = q->tasks.back();
+            q->tasks.pop_back();
+            queued--;
+            return task;
+        }
+    }
+    for (int i = 1; i < threads; i++) {
+        Queue* q = queues[(self + i) % threads];
+        lock_guard<mutex> lock(q->m);
+        if (!q->tasks.empty()) {
+            Task* task = q->tasks.front();
+            q->tasks.pop_front();
+            queued--;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @Method: 执行任务，任务组的最后一个任务完成时唤醒等待的线程
+ * @param Task* task 任务
+ * @return void
+ */
+void ThreadPool::execute(Task* task) {
+    task->fn();
+    if (task->group != NULL && --task->group->pending == 0) {
+        {
+            lock_guard<mutex> lock(sleepMutex);
+        }
+        wake.notify_all();
+    }
+    delete task;
+}
+
+/**
+ * @Method: 没有可执行的任务时等待，直到有新任务、ready()成立或超时
+ * @param function<bool()> ready 等待结束的条件
+ * @return void
+ */
+void ThreadPool::idle(const function<bool()> &ready) {
+    unique_lock<mutex> lock(sleepMutex);
+    wake.wait_for(lock, IDLE_WAIT, [&] { return queued > 0 || stopping || ready(); });
+}
+
+/**
+ * @Method: 提交一个不属于任何任务组的任务，不等待其完成；只有一个线程时在调用线程上直接执行
+ * @param function<void()> fn 任务，完成后需要自行通知提交者
+ * @return void
+ */
+void ThreadPool::post(const function<void()> &fn) {
+    // 没有工作线程时不会有人执行队列中的任务，直接在调用线程上执行
+    if (threads == 1) {
+        fn();
+        return;
+    }
+    Task* task = new Task();
+    task->fn = fn;
+    task->group = NULL;
+    push(task);
+}
+
+/**
+ * @Method: 将[begin, end)划分为若干块并行执行
+ * @param size_t begin 起始下标
+ * @param size_t end 结束下标（不包含）
+ * @param size_t grain 每块的下标个数，为0时按线程数自动确定
+ * @param function<void(size_t, size_t)> body 处理一块下标[b0, b1)
+ * @return void
+ */
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)> &body) {
+    if (begin >= end) {
+        return;
+    }
+    grain = grainSize(end - begin, grain);
+    if (threads == 1 || end - begin <= grain) {
+        body(begin, end);
+        return;
+    }
+
+    // 每块作为一个任务派生，空闲线程会窃取尚未开始的块
+    TaskGroup group(*this);
+    for (size_t b0 = begin; b0 < end; b0 += grain) {
+        size_t b1 = min(end, b0 + grain);
+        group.run([&body, b0, b1] {
+            body(b0, b1);
+        });
+    }
+    group.wait();
+}
+
+/**
+ * @Method: 工作线程的主循环
+ * @param int index 队列编号
+ * @return void
+ */
+void ThreadPool::workerLoop(int index) {
+    currentPool = this;
+    currentQueue = index;
+    if (pin) {
+        // 调用线程不绑核，第i个工作线程使用第i - 1个CPU
+        const Topology &topo = topology();
+        size_t slot = (index - 1) % topo.cpus.size();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(topo.cpus[slot], &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+            pinnedNode = topo.nodes[slot];
+        }
+    }
+    while (!stopping) {
+        Task* task = pop();
+        if (task != NULL) {
+            execute(task);
+        } else {
+            idle([] { return false; });
+        }
+    }
+}
+
+TaskGraph::TaskGraph(ThreadPool &pool) : pool(pool) {
+}
+
+TaskGraph::~TaskGraph() {
+    for (size_t i = 0; i < nodes.size(); i++) {
+        delete nodes[i];
+    }
+}
+
+/**
+ * @Method: 添加一个任务
+ * @param function<void()> fn 任务
+ * @param vector<int> deps 依赖的任务编号，必须是已添加的任务
+ * @return int 任务编号
+ */
+int TaskGraph::add(const function<void()> &fn, const vector<int> &deps) {
+    int index = nodes.size();
+    Node* node = new Node();
+    node->fn = fn;
+    node->deps = deps.size();
+    nodes.push_back(node);
+    for (size_t i = 0; i < deps.size(); i++) {
+        nodes[deps[i]]->successors.push_back(index);
+    }
+    return index;
+}
+
+/**
+ * @Method: 执行所有任务，没有依赖关系的任务并行执行，返回时所有任务均已完成
+ * @return void
+ */
+void TaskGraph::run() {
+    TaskGroup group(pool);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i]->remaining = nodes[i]->deps;
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i]->deps == 0) {
+            spawn(group, i);
+        }
+    }
+    group.wait();
+}
+
+/**
+ * @Method: 派生第i个任务，完成后派生所有依赖已满足的后继任务
+ * @param TaskGroup& group 任务组
+ * @param int i 任务编号
+ * @return void
+ */
+void TaskGraph::spawn(TaskGroup &group, int i) {
+    group.run([this, &group, i] {
+        nodes[i]->fn();
+        for (size_t j = 0; j < nodes[i]->successors.size(); j++) {
+            int s = nodes[i]->successors[j];
+            if (--nodes[s]->remaining == 0) {
+                spawn(group, s);
+            }
+        }
+    });
+}
+
+// 全局线程池
+static ThreadPool* pool = NULL;
+static mutex poolMutex;
+
+/**
+ * @Method: 默认线程数，环境变量DD_THREADS有效时使用该值，否则为CPU核数
+ * @return int 线程数
+ */
+int defaultThreads() {
+    const char* env = getenv("DD_THREADS");
+    if (env != NULL && atoi(env) > 0) {
+        return atoi(env);
+    }
+    return max(1u, thread::hardware_concurrency());
+}
+
+/**
+ * @Method: 默认是否绑核，环境变量DD_PIN为1时绑核
+ * @return bool 是否绑核
+ */
+bool defaultPinning() {
+    const char* env = getenv("DD_PIN");
+    return env != NULL && atoi(env) == 1;
+}
+
+/**
+ * @Method: 获取全局线程池，首次调用时按defaultThreads()和defaultPinning()创建
+ * @return ThreadPool& 全局线程池
+ */
+ThreadPool &executor() {
+    lock_guard<mutex> lock(poolMutex);
+    if (pool == NULL) {
+        pool = new ThreadPool(defaultThreads(), defaultPinning());
+    }
+    return *pool;
+}
+
+/**
+ * @Method: 重新设置全局线程池的线程数，调用时不能有正在执行的任务
+ * @param int threads 线程数，不大于0时使用defaultThreads()
+ * @return void
+ */
+void setExecutorThreads(int threads) {
+    lock_guard<mutex> lock(poolMutex);
+    delete pool;
+    pool = new ThreadPool(threads > 0 ? threads : defaultThreads(), defaultPinning());
+}
+
+// 线程退出时释放BN_CTX
+struct LocalCTX {
+    BN_CTX* ctx;
+
+    LocalCTX() {
+        ctx = BN_CTX_new();
+    }
+
+    ~LocalCTX() {
+        BN_CTX_free(ctx);
+    }
+};
+
+/**
+ * @Method: 获取当前线程的BN_CTX，每个线程各有一个，线程退出时释放
+ * @return BN_CTX* 当前线程的BN_CTX
+ */
+BN_CTX* localCTX() {
+    static thread_local LocalCTX local;
+    return local.ctx;
+}
+
+/**
+ * @Method: 本进程可用的NUMA节点数，读取不到拓扑时为1
+ * @return int 节点数
+ */
+int numaNodes() {
+    return topology().nodeCount;
+}
+
+/**
+ * @Method: 当前线程所在的NUMA节点，绑核的工作线程为所绑CPU的节点，其它线程为当前运行的CPU的节点
+ * @return int 节点编号，在[0, numaNodes())之间
+ */
+int currentNode() {
+    if (pinnedNode >= 0) {
+        return pinnedNode;
+    }
+    const Topology &topo = topology();
+    if (topo.nodeCount == 1) {
+        return 0;
+    }
+    int cpu = sched_getcpu();
+    return cpu >= 0 && cpu < (int) topo.nodeOfCpu.size() ? topo.nodeOfCpu[cpu] : 0;
+}
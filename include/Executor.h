@@ -0,0 +1,225 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Work-stealing thread pool, parallel loops and task graphs
+*/
+
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <bits/stdc++.h>
+#include <openssl/bn.h>
+using namespace std;
+
+class ThreadPool;
+
+// 一组任务，wait()等待组内所有任务完成，包括任务执行时派生到组内的任务
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool &pool);
+
+    ~TaskGroup();
+
+    /**
+     * @Method: 派生一个任务，放入当前线程的任务队列
+     * @param function<void()> fn 任务
+     * @return void
+     */
+    void run(const function<void()> &fn);
+
+    /**
+     * @Method: 等待组内所有任务完成，等待期间当前线程也执行或窃取任务
+     * @return void
+     */
+    void wait();
+
+private:
+    ThreadPool &pool;
+    atomic<size_t> pending;
+
+    friend class ThreadPool;
+};
+
+/*
+ * 所有协议共用的工作窃取线程池。每个工作线程有自己的双端队列，从队尾取出自己派生的任务，
+ * 空闲时从其它队列的队首窃取任务；外部线程派生的任务放入共享的第0个队列。
+ * 调用线程在等待时也执行任务，因此size()个线程中有size() - 1个工作线程，嵌套调用也能并行。
+ * 每个线程通过localCTX()获取自己的BN_CTX；BN_rand使用OpenSSL按线程划分的随机数生成器，
+ * 因此加密时各线程的BN_CTX和随机数状态互不共享。
+ * 开启绑核时第i个工作线程绑定到按NUMA节点排列的第i个可用CPU上，先填满一个节点再使用下一个节点。
+ * Linux按首次访问分配内存页，工作线程加密产生的密文因此位于它所在节点的内存中。
+ */
+class ThreadPool {
+public:
+    /**
+     * @param int threads 参与计算的线程数，包括调用线程
+     * @param bool pin 是否将工作线程绑定到CPU
+     */
+    explicit ThreadPool(int threads, bool pin = false);
+
+    ~ThreadPool();
+
+    int size() {
+        return threads;
+    }
+
+    /**
+     * @Method: 提交一个不属于任何任务组的任务，不等待其完成；只有一个线程时在调用线程上直接执行
+     * @param function<void()> fn 任务，完成后需要自行通知提交者
+     * @return void
+     */
+    void post(const function<void()> &fn);
+
+    /**
+     * @Method: 将[begin, end)划分为若干块并行执行
+     * @param size_t begin 起始下标
+     * @param size_t end 结束下标（不包含）
+     * @param size_t grain 每块的下标个数，为0时按线程数自动确定
+     * @param function<void(size_t, size_t)> body 处理一块下标[b0, b1)
+     * @return void
+     */
+    void parallel_for(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)> &body);
+
+    /**
+     * @Method: 并行归约，每块的结果按块的顺序依次合并
+     * @param size_t begin 起始下标
+     * @param size_t end 结束下标（不包含）
+     * @param size_t grain 每块的下标个数，为0时按线程数自动确定
+     * @param T identity 初始值
+     * @param Range range 计算一块下标[b0, b1)的结果，返回T
+     * @param Combine combine 合并两个结果，返回T
+     * @return T 归约结果
+     */
+    template <typename T, typename Range, typename Combine>
+    T parallel_reduce(size_t begin, size_t end, size_t grain, T identity, Range range, Combine combine) {
+        if (begin >= end) {
+            return identity;
+        }
+        grain = grainSize(end - begin, grain);
+        size_t blocks = (end - begin + grain - 1) / grain;
+        vector<T> partials(blocks);
+        parallel_for(0, blocks, 1, [&](size_t b0, size_t b1) {
+            for (size_t b = b0; b < b1; b++) {
+                partials[b] = range(begin + b * grain, min(end, begin + (b + 1) * grain));
+            }
+        });
+        T result = identity;
+        for (size_t b = 0; b < blocks; b++) {
+            result = combine(result, partials[b]);
+        }
+        return result;
+    }
+
+private:
+    struct Task {
+        function<void()> fn;
+        TaskGroup* group;
+    };
+
+    struct Queue {
+        mutex m;
+        deque<Task*> tasks;
+    };
+
+    int threads;
+    bool pin;
+    vector<thread> workers;
+    // queues[0]为外部线程共享的队列，queues[i]为第i个工作线程的队列
+    vector<Queue*> queues;
+    // 所有队列中的任务总数
+    atomic<size_t> queued;
+    atomic<bool> stopping;
+    // 空闲线程在此等待新任务或任务组完成
+    mutex sleepMutex;
+    condition_variable wake;
+
+    size_t grainSize(size_t n, size_t grain);
+    int localQueue();
+    void push(Task* task);
+    Task* pop();
+    void execute(Task* task);
+    void idle(const function<bool()> &ready);
+    void workerLoop(int index);
+
+    friend class TaskGroup;
+};
+
+// 有依赖关系的任务图，某个任务依赖的任务全部完成后该任务才会被派生
+class TaskGraph {
+public:
+    explicit TaskGraph(ThreadPool &pool);
+
+    ~TaskGraph();
+
+    /**
+     * @Method: 添加一个任务
+     * @param function<void()> fn 任务
+     * @param vector<int> deps 依赖的任务编号，必须是已添加的任务
+     * @return int 任务编号
+     */
+    int add(const function<void()> &fn, const vector<int> &deps = vector<int>());
+
+    /**
+     * @Method: 执行所有任务，没有依赖关系的任务并行执行，返回时所有任务均已完成
+     * @return void
+     */
+    void run();
+
+private:
+    struct Node {
+        function<void()> fn;
+        vector<int> successors;
+        int deps;
+        atomic<int> remaining;
+    };
+
+    ThreadPool &pool;
+    vector<Node*> nodes;
+
+    void spawn(TaskGroup &group, int i);
+};
+
+/**
+ * @Method: 默认线程数，环境变量DD_THREADS有效时使用该值，否则为CPU核数
+ * @return int 线程数
+ */
+int defaultThreads();
+
+/**
+ * @Method: 默认是否绑核，环境变量DD_PIN为1时绑核
+ * @return bool 是否绑核
+ */
+bool defaultPinning();
+
+/**
+ * @Method: 获取全局线程池，首次调用时按defaultThreads()和defaultPinning()创建
+ * @return ThreadPool& 全局线程池
+ */
+ThreadPool &executor();
+
+/**
+ * @Method: 重新设置全局线程池的线程数，调用时不能有正在执行的任务
+ * @param int threads 线程数，不大于0时使用defaultThreads()
+ * @return void
+ */
+void setExecutorThreads(int threads);
+
+/**
+ * @Method: 获取当前线程的BN_CTX，每个线程各有一个，线程退出时释放
+ * @return BN_CTX* 当前线程的BN_CTX
+ */
+BN_CTX* localCTX();
+
+/**
+ * @Method: 本进程可用的NUMA节点数，读取不到拓扑时为1
+ * @return int 节点数
+ */
+int numaNodes();
+
+/**
+ * @Method: 当前线程所在的NUMA节点，绑核的工作线程为所绑CPU的节点，其它线程为当前运行的CPU的节点
+ * @return int 节点编号，在[0, numaNodes())之间
+ */
+int currentNode();
+
+#endif //EXECUTOR_H
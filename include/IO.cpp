@@ -0,0 +1,747 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Reading input data files and writing result files
+*/
+
+#include "IO.h"
+#include "Native.h"
+#include "Executor.h"
+#include <openssl/bn.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+using namespace std;
+
+// 每个解析线程至少处理的字节数
+static const size_t PARSE_CHUNK_MIN = 1 << 20;
+
+// 按64位整数直接解析的最大位数
+static const size_t FAST_DIGITS = 18;
+
+// 流式读取的块大小
+static const size_t STREAM_BLOCK_SIZE = 1 << 20;
+
+// 结果写入器的缓冲区大小
+static const size_t WRITE_BUFFER_SIZE = 1 << 22;
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/**
+ * @Method: 将一个十进制数的文本转换为BIGNUM
+ * @param const char* s 文本起始位置
+ * @param size_t len 文本长度
+ * @return BIGNUM* 转换结果，无法解析时为0
+ */
+static BIGNUM* parseBIGNUM(const char* s, size_t len) {
+    BIGNUM* bn = BN_new();
+    size_t i = 0;
+    bool negative = false;
+    if (s[0] == '-' || s[0] == '+') {
+        negative = s[0] == '-';
+        i = 1;
+    }
+
+    // 位数较少且全部为数字时按64位整数解析
+    if (len - i > 0 && len - i <= FAST_DIGITS) {
+        unsigned long long v = 0;
+        size_t j = i;
+        for (; j < len && s[j] >= '0' && s[j] <= '9'; j++) {
+            v = v * 10 + (s[j] - '0');
+        }
+        if (j == len) {
+            BN_set_word(bn, v);
+            BN_set_negative(bn, negative);
+            return bn;
+        }
+    }
+
+    // 否则交给BN_dec2bn处理
+    string token(s, len);
+    BN_dec2bn(&bn, token.c_str());
+    return bn;
+}
+
+/**
+ * @Method: 解析[begin, end)范围内的数据
+ * @param const char* begin 起始位置
+ * @param const char* end 结束位置
+ * @param vector<vector<BIGNUM*> >& rows 解析结果，第0行是上一块最后一行的延续
+ * @return void
+ */
+static void parseChunk(const char* begin, const char* end, vector<vector<BIGNUM*> > &rows) {
+    rows.assign(1, vector<BIGNUM*>());
+    const char* p = begin;
+    while (p < end) {
+        if (*p == '\n') {
+            rows.push_back(vector<BIGNUM*>());
+            p++;
+            continue;
+        }
+        if (isBlank(*p)) {
+            p++;
+            continue;
+        }
+        const char* q = p;
+        while (q < end && !isBlank(*q)) {
+            q++;
+        }
+        rows.back().push_back(parseBIGNUM(p, q - p));
+        p = q;
+    }
+}
+
+/**
+ * @Method: 解析文件中所有行的BIGNUMs
+ * @param string filename 文件名
+ * @return vector<vector<BIGNUM*> > 第i个元素为文件第i + 1行的BIGNUMs列表，打开失败时为空
+ */
+static vector<vector<BIGNUM*> > parseBIGNUMRowsFromFile(const string &filename) {
+    vector<vector<BIGNUM*> > result;
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "Unable to open file " << filename << endl;
+        return result;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return result;
+    }
+    size_t size = st.st_size;
+    void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        cerr << "Unable to map file " << filename << endl;
+        return result;
+    }
+    madvise(addr, size, MADV_SEQUENTIAL);
+    const char* data = static_cast<const char*>(addr);
+
+    // 按空白字符切分数据块，保证数字不会跨块
+    size_t threads = executor().size();
+    size_t chunks = min(threads, size / PARSE_CHUNK_MIN + 1);
+    vector<size_t> bounds(chunks + 1, size);
+    bounds[0] = 0;
+    for (size_t i = 1; i < chunks; i++) {
+        size_t b = max(bounds[i - 1], size / chunks * i);
+        while (b < size && !isBlank(data[b])) {
+            b++;
+        }
+        bounds[i] = b;
+    }
+
+    // 每块由线程池中的一个线程解析
+    vector<vector<vector<BIGNUM*> > > parts(chunks);
+    executor().parallel_for(0, chunks, 1, [&](size_t b0, size_t b1) {
+        for (size_t i = b0; i < b1; i++) {
+            parseChunk(data + bounds[i], data + bounds[i + 1], parts[i]);
+        }
+    });
+    munmap(addr, size);
+
+    // 按顺序合并各块的结果，每块的第0行接在上一块的最后一行之后
+    for (size_t i = 0; i < chunks; i++) {
+        vector<vector<BIGNUM*> > &rows = parts[i];
+        if (result.empty()) {
+            result.push_back(vector<BIGNUM*>());
+        }
+        result.back().insert(result.back().end(), rows[0].begin(), rows[0].end());
+        for (size_t j = 1; j < rows.size(); j++) {
+            result.push_back(vector<BIGNUM*>());
+            result.back().swap(rows[j]);
+        }
+    }
+
+    return result;
+}
+
+// 解析后的输入文件，开启缓存后同一文件只解析一次
+static bool inputCacheEnabled = false;
+static mutex inputCacheMutex;
+static map<string, shared_future<vector<vector<BIGNUM*> > > > inputCache;
+
+/**
+ * @Method: 设置是否缓存解析后的输入文件
+ * @param bool enable 是否缓存
+ * @return void
+ */
+void setInputCache(bool enable) {
+    lock_guard<mutex> lock(inputCacheMutex);
+    inputCacheEnabled = enable;
+}
+
+/**
+ * @Method: 从文件中一次性读取所有行的BIGNUMs
+ * @param string filename 文件名
+ * @return vector<vector<BIGNUM*> > 第i个元素为文件第i + 1行的BIGNUMs列表，打开失败时为空
+ */
+vector<vector<BIGNUM*> > readBIGNUMRowsFromFile(const string &filename) {
+    unique_lock<mutex> lock(inputCacheMutex);
+    if (!inputCacheEnabled) {
+        lock.unlock();
+        return parseBIGNUMRowsFromFile(filename);
+    }
+
+    // 第一个读取该文件的线程负责解析，其它线程等待解析结果
+    map<string, shared_future<vector<vector<BIGNUM*> > > >::iterator it = inputCache.find(filename);
+    if (it != inputCache.end()) {
+        shared_future<vector<vector<BIGNUM*> > > rows = it->second;
+        lock.unlock();
+        return rows.get();
+    }
+    promise<vector<vector<BIGNUM*> > > parsed;
+    shared_future<vector<vector<BIGNUM*> > > rows = parsed.get_future().share();
+    inputCache[filename] = rows;
+    lock.unlock();
+    parsed.set_value(parseBIGNUMRowsFromFile(filename));
+    return rows.get();
+}
+
+/**
+ * @Method: 从文件中读取BIGNUMs，所有行按顺序拼接为一个列表
+ * @param string filename 文件名
+ * @return vector<BIGNUM*> BIGNUMs列表
+ */
+vector<BIGNUM*> readBIGNUMsFromFile(const string &filename) {
+    vector<vector<BIGNUM*> > rows = readBIGNUMRowsFromFile(filename);
+    vector<BIGNUM*> data_list;
+    for (size_t i = 0; i < rows.size(); i++) {
+        data_list.insert(data_list.end(), rows[i].begin(), rows[i].end());
+    }
+    return data_list;
+}
+
+AsyncFileReader::AsyncFileReader(const string &filename, size_t blockSize) {
+    this->fd = open(filename.c_str(), O_RDONLY);
+    this->blockSize = blockSize;
+    this->current = 0;
+    this->offset = 0;
+    this->pending = false;
+    this->ring = -1;
+    if (fd < 0) {
+        return;
+    }
+    buffers[0].resize(blockSize);
+    buffers[1].resize(blockSize);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // 提交第一块的读请求
+    if (setupRing()) {
+        pending = submitRead(current);
+    }
+}
+
+/**
+ * @Method: 创建io_uring并映射提交队列和完成队列
+ * @return bool true:成功; false:io_uring不可用
+ */
+bool AsyncFileReader::setupRing() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring = syscall(__NR_io_uring_setup, 2, &params);
+    if (ring < 0) {
+        return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+    sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+        closeRing();
+        return false;
+    }
+
+    char* sq = static_cast<char*>(sqRing);
+    char* cq = static_cast<char*>(cqRing);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+    return true;
+}
+
+/**
+ * @Method: 释放io_uring，之后的读取都使用pread
+ * @return void
+ */
+void AsyncFileReader::closeRing() {
+    if (ring < 0) {
+        return;
+    }
+    if (sqRing != MAP_FAILED) {
+        munmap(sqRing, sqRingSize);
+    }
+    if (cqRing != MAP_FAILED) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqesSize);
+    }
+    close(ring);
+    ring = -1;
+}
+
+/**
+ * @Method: 提交一个从offset开始、读入第index个缓冲区的读请求
+ * @param int index 缓冲区下标
+ * @return bool true:提交成功; false:提交失败
+ */
+bool AsyncFileReader::submitRead(int index) {
+    unsigned tail = *sqTail;
+    unsigned i = tail & *sqMask;
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqes) + i;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffers[index].data());
+    sqe->len = blockSize;
+    sqe->off = offset;
+    sqe->user_data = index;
+    sqArray[i] = i;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    return syscall(__NR_io_uring_enter, ring, 1, 0, 0, NULL, 0) == 1;
+}
+
+/**
+ * @Method: 等待已提交的读请求完成
+ * @return ssize_t 读取的字节数，小于0表示失败
+ */
+ssize_t AsyncFileReader::waitRead() {
+    while (true) {
+        unsigned head = *cqHead;
+        if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe* cqe = static_cast<struct io_uring_cqe*>(cqes) + (head & *cqMask);
+            ssize_t res = cqe->res;
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            return res;
+        }
+        if (syscall(__NR_io_uring_enter, ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * @Method: 获取下一块数据，返回的数据在下一次调用前有效
+ * @param size_t* len 数据长度，为0表示文件已读完
+ * @return const char* 数据起始位置
+ */
+const char* AsyncFileReader::next(size_t* len) {
+    *len = 0;
+    if (fd < 0) {
+        return NULL;
+    }
+
+    ssize_t n = -1;
+    if (pending) {
+        n = waitRead();
+        pending = false;
+        // 内核不支持IORING_OP_READ等情况下改用pread
+        if (n < 0) {
+            closeRing();
+        }
+    }
+    if (n < 0) {
+        n = pread(fd, buffers[current].data(), blockSize, offset);
+    }
+    if (n <= 0) {
+        return NULL;
+    }
+
+    offset += n;
+    const char* data = buffers[current].data();
+    *len = n;
+
+    // 预读下一块到另一个缓冲区
+    current ^= 1;
+    if (ring >= 0) {
+        pending = submitRead(current);
+    }
+    return data;
+}
+
+AsyncFileReader::~AsyncFileReader() {
+    // 内核可能仍在写缓冲区，必须等待读请求完成
+    if (pending) {
+        waitRead();
+    }
+    closeRing();
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+BIGNUMStream::BIGNUMStream(const string &filename, int line) : reader(filename, STREAM_BLOCK_SIZE) {
+    this->line = line;
+    this->currentLine = 1;
+    this->block = NULL;
+    this->pos = 0;
+    this->len = 0;
+    this->done = !reader.is_open();
+}
+
+/**
+ * @Method: 读取下一批BIGNUMs
+ * @param vector<BIGNUM*>& out 读取结果追加到out末尾
+ * @param size_t max 最多读取的个数
+ * @return size_t 实际读取的个数，为0表示已读完
+ */
+size_t BIGNUMStream::next(vector<BIGNUM*> &out, size_t max) {
+    size_t count = 0;
+    while (count < max && !done) {
+        if (pos == len) {
+            block = reader.next(&len);
+            pos = 0;
+            if (len == 0) {
+                // 文件以数字结尾
+                if (!carry.empty()) {
+                    out.push_back(parseBIGNUM(carry.data(), carry.size()));
+                    carry.clear();
+                    count++;
+                }
+                done = true;
+                break;
+            }
+        }
+
+        // 跳过目标行之前的行
+        if (line > 0 && currentLine < line) {
+            const char* p = static_cast<const char*>(memchr(block + pos, '\n', len - pos));
+            if (p == NULL) {
+                pos = len;
+            } else {
+                pos = p - block + 1;
+                currentLine++;
+            }
+            continue;
+        }
+
+        char c = block[pos];
+        if (isBlank(c)) {
+            if (!carry.empty()) {
+                out.push_back(parseBIGNUM(carry.data(), carry.size()));
+                carry.clear();
+                count++;
+            }
+            pos++;
+            if (c == '\n') {
+                currentLine++;
+                done = line > 0;
+            }
+            continue;
+        }
+
+        size_t end = pos;
+        while (end < len && !isBlank(block[end])) {
+            end++;
+        }
+        if (end == len || !carry.empty()) {
+            // 数字可能延续到下一块
+            carry.append(block + pos, end - pos);
+        } else {
+            out.push_back(parseBIGNUM(block + pos, end - pos));
+            count++;
+        }
+        pos = end;
+    }
+    return count;
+}
+
+ResultWriter::ResultWriter(const string &filename, OutputFormat format) {
+    this->fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    this->format = format;
+    this->buffer.resize(WRITE_BUFFER_SIZE);
+    this->used = 0;
+    this->columns = 0;
+    this->failed = false;
+    this->columnType = 0;
+    this->columnWidth = 0;
+    this->columnBytes = 0;
+
+    // 二进制格式先写入文件头，列数在关闭时回填
+    if (fd >= 0 && format == OUTPUT_BINARY) {
+        uint32_t header[4] = {0, RESULT_VERSION, 0, 0};
+        memcpy(header, RESULT_MAGIC, sizeof(RESULT_MAGIC));
+        append(header, sizeof(header));
+    }
+}
+
+void ResultWriter::append(const void* data, size_t len) {
+    if (used + len > buffer.size()) {
+        flush();
+    }
+    // 超过缓冲区大小的数据直接写入文件
+    if (len > buffer.size()) {
+        const char* p = static_cast<const char*>(data);
+        while (len > 0 && !failed) {
+            ssize_t n = write(fd, p, len);
+            if (n <= 0) {
+                failed = true;
+                break;
+            }
+            p += n;
+            len -= n;
+        }
+        return;
+    }
+    memcpy(buffer.data() + used, data, len);
+    used += len;
+}
+
+void ResultWriter::flush() {
+    size_t done = 0;
+    while (done < used && !failed) {
+        ssize_t n = write(fd, buffer.data() + done, used - done);
+        if (n <= 0) {
+            failed = true;
+            break;
+        }
+        done += n;
+    }
+    used = 0;
+}
+
+void ResultWriter::pad(size_t len) {
+    static const char zeros[8] = {0};
+    if (len % 8 != 0) {
+        append(zeros, 8 - len % 8);
+    }
+}
+
+/**
+ * @Method: 写入文本
+ * @param string s 文本
+ * @return void
+ */
+void ResultWriter::writeText(const string &s) {
+    append(s.data(), s.size());
+}
+
+/**
+ * @Method: 以十进制文本写入BIGNUM
+ * @param const BIGNUM* bn 待写入的数
+ * @return void
+ */
+void ResultWriter::writeBIGNUM(const BIGNUM* bn) {
+    int64_t v;
+    if (BN_to_int64(bn, &v)) {
+        char s[24];
+        int n = snprintf(s, sizeof(s), "%lld", (long long) v);
+        append(s, n);
+        return;
+    }
+    char* bn_str = BN_bn2dec(bn);
+    append(bn_str, strlen(bn_str));
+    OPENSSL_free(bn_str);
+}
+
+void ResultWriter::writeColumnHeader(const string &name, uint64_t count, uint32_t type, uint32_t width) {
+    char header[32] = {0};
+    memcpy(header, name.data(), min(name.size(), (size_t) 16));
+    memcpy(header + 16, &count, sizeof(count));
+    memcpy(header + 24, &type, sizeof(type));
+    memcpy(header + 28, &width, sizeof(width));
+    append(header, sizeof(header));
+    columns++;
+}
+
+/**
+ * @Method: 写入一列BIGNUM，全部能放入int64时按RESULT_INT64存储
+ * @param string name 列名，最长16字节
+ * @param vector<BIGNUM*> values 列数据
+ * @return void
+ */
+void ResultWriter::writeColumn(const string &name, const vector<BIGNUM*> &values) {
+    vector<int64_t> native;
+    if (toNative(values, native)) {
+        writeColumn(name, native);
+        return;
+    }
+
+    // 定长存储，宽度由最大的绝对值决定
+    int bytes = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        bytes = max(bytes, BN_num_bytes(values[i]));
+    }
+    beginColumn(name, values.size(), RESULT_BIGNUM, bytes + 1);
+    for (size_t i = 0; i < values.size(); i++) {
+        writeValue(values[i]);
+    }
+    endColumn();
+}
+
+/**
+ * @Method: 写入一列int64
+ * @param string name 列名，最长16字节
+ * @param vector<int64_t> values 列数据
+ * @return void
+ */
+void ResultWriter::writeColumn(const string &name, const vector<int64_t> &values) {
+    writeColumnHeader(name, values.size(), RESULT_INT64, sizeof(int64_t));
+    append(values.data(), values.size() * sizeof(int64_t));
+}
+
+/**
+ * @Method: 开始逐个写入一列数据，用于无法一次放入内存的列
+ * @param string name 列名，最长16字节
+ * @param uint64_t count 数据个数
+ * @param uint32_t type RESULT_INT64或RESULT_BIGNUM
+ * @param uint32_t width 每个值的字节数，RESULT_INT64时为8
+ * @return void
+ */
+void ResultWriter::beginColumn(const string &name, uint64_t count, uint32_t type, uint32_t width) {
+    writeColumnHeader(name, count, type, width);
+    columnType = type;
+    columnWidth = width;
+    columnBytes = 0;
+}
+
+/**
+ * @Method: 按当前列的类型写入一个值
+ * @param const BIGNUM* bn 待写入的数
+ * @return void
+ */
+void ResultWriter::writeValue(const BIGNUM* bn) {
+    if (columnType == RESULT_INT64) {
+        int64_t v = 0;
+        BN_to_int64(bn, &v);
+        append(&v, sizeof(v));
+    } else {
+        vector<unsigned char> value(columnWidth);
+        value[0] = BN_is_negative(bn) ? 1 : 0;
+        BN_bn2binpad(bn, value.data() + 1, columnWidth - 1);
+        append(value.data(), columnWidth);
+    }
+    columnBytes += columnWidth;
+}
+
+/**
+ * @Method: 结束当前列，补齐8字节对齐
+ * @return void
+ */
+void ResultWriter::endColumn() {
+    pad(columnBytes);
+    columnBytes = 0;
+}
+
+/**
+ * @Method: 写出缓冲区并关闭文件
+ * @return bool true:成功; false:写入失败
+ */
+bool ResultWriter::close() {
+    if (fd < 0) {
+        return false;
+    }
+    flush();
+    // 回填二进制格式的列数
+    if (format == OUTPUT_BINARY && !failed) {
+        failed = pwrite(fd, &columns, sizeof(columns), 8) != sizeof(columns);
+    }
+    ::close(fd);
+    fd = -1;
+    return !failed;
+}
+
+ResultWriter::~ResultWriter() {
+    close();
+}
+
+/**
+ * @Method: 读取第i个值
+ * @param size_t i 下标
+ * @return BIGNUM* 第i个值
+ */
+BIGNUM* ResultColumn::get(size_t i) const {
+    const unsigned char* value = data + i * width;
+    if (type == RESULT_INT64) {
+        int64_t v;
+        memcpy(&v, value, sizeof(v));
+        BIGNUM* bn = BN_new();
+        BN_set_word(bn, v < 0 ? -(uint64_t) v : (uint64_t) v);
+        BN_set_negative(bn, v < 0);
+        return bn;
+    }
+    BIGNUM* bn = BN_bin2bn(value + 1, width - 1, NULL);
+    BN_set_negative(bn, value[0] == 1);
+    return bn;
+}
+
+ResultReader::ResultReader(const string &filename) {
+    this->addr = NULL;
+    this->size = 0;
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 16) {
+        close(fd);
+        return;
+    }
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return;
+    }
+    const unsigned char* data = static_cast<const unsigned char*>(p);
+    uint32_t header[4];
+    memcpy(header, data, sizeof(header));
+    if (memcmp(data, RESULT_MAGIC, sizeof(RESULT_MAGIC)) != 0 || header[1] != RESULT_VERSION) {
+        munmap(p, st.st_size);
+        return;
+    }
+    this->addr = p;
+    this->size = st.st_size;
+
+    // 依次解析每一列的列头
+    size_t offset = 16;
+    for (uint32_t i = 0; i < header[2] && offset + 32 <= size; i++) {
+        ResultColumn col;
+        const char* name = reinterpret_cast<const char*>(data + offset);
+        col.name = string(name, strnlen(name, 16));
+        memcpy(&col.count, data + offset + 16, sizeof(col.count));
+        memcpy(&col.type, data + offset + 24, sizeof(col.type));
+        memcpy(&col.width, data + offset + 28, sizeof(col.width));
+        col.data = data + offset + 32;
+        size_t bytes = col.count * col.width;
+        if (offset + 32 + bytes > size) {
+            break;
+        }
+        cols.push_back(col);
+        offset += 32 + (bytes + 7) / 8 * 8;
+    }
+}
+
+/**
+ * @Method: 按列名查找列
+ * @param string name 列名
+ * @return const ResultColumn* 第一个同名的列，不存在时为NULL
+ */
+const ResultColumn* ResultReader::column(const string &name) {
+    for (size_t i = 0; i < cols.size(); i++) {
+        if (cols[i].name == name) {
+            return &cols[i];
+        }
+    }
+    return NULL;
+}
+
+ResultReader::~ResultReader() {
+    if (addr != NULL) {
+        munmap(addr, size);
+    }
+}
@@ -0,0 +1,285 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Reading input data files and writing result files
+*/
+
+#ifndef IO_H
+#define IO_H
+
+#include <bits/stdc++.h>
+#include <openssl/bn.h>
+using namespace std;
+
+/**
+ * @Method: 从文件中一次性读取所有行的BIGNUMs
+ * 文件通过mmap映射后按空白字符切分为若干块，由多个线程并行解析，
+ * 不超过18位的十进制数直接按64位整数解析
+ * @param string filename 文件名
+ * @return vector<vector<BIGNUM*> > 第i个元素为文件第i + 1行的BIGNUMs列表，打开失败时为空
+ */
+vector<vector<BIGNUM*> > readBIGNUMRowsFromFile(const string &filename);
+
+/**
+ * @Method: 设置是否缓存解析后的输入文件
+ * 开启后同一文件只解析一次，多个线程同时读取同一文件时由第一个线程解析、其它线程等待；
+ * 返回的BIGNUM由所有读取者共享，调用者不能修改或释放
+ * @param bool enable 是否缓存
+ * @return void
+ */
+void setInputCache(bool enable);
+
+/**
+ * @Method: 从文件中读取BIGNUMs，所有行按顺序拼接为一个列表
+ * @param string filename 文件名
+ * @return vector<BIGNUM*> BIGNUMs列表
+ */
+vector<BIGNUM*> readBIGNUMsFromFile(const string &filename);
+
+// 顺序读取文件的异步读取器
+// io_uring可用时总是预读下一块，调用者处理当前块的同时内核读取下一块；否则退化为pread
+class AsyncFileReader {
+public:
+    AsyncFileReader(const string &filename, size_t blockSize);
+
+    bool is_open() {
+        return fd >= 0;
+    }
+
+    /**
+     * @Method: 获取下一块数据，返回的数据在下一次调用前有效
+     * @param size_t* len 数据长度，为0表示文件已读完
+     * @return const char* 数据起始位置
+     */
+    const char* next(size_t* len);
+
+    ~AsyncFileReader();
+
+private:
+    int fd;
+    size_t blockSize;
+    // 两个缓冲区轮流使用
+    vector<char> buffers[2];
+    int current;
+    // 下一次读取的文件偏移
+    off_t offset;
+    // 是否有一个读请求尚未完成
+    bool pending;
+
+    // io_uring的提交队列和完成队列
+    int ring;
+    void* sqRing;
+    size_t sqRingSize;
+    void* cqRing;
+    size_t cqRingSize;
+    void* sqes;
+    size_t sqesSize;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    void* cqes;
+
+    bool setupRing();
+    void closeRing();
+    bool submitRead(int index);
+    ssize_t waitRead();
+};
+
+// 按顺序逐批读取文件中的BIGNUMs，只保留一个读取块的内存
+class BIGNUMStream {
+public:
+    /**
+     * @param string filename 文件名
+     * @param int line 只读取第line行，为0时读取所有行
+     */
+    BIGNUMStream(const string &filename, int line);
+
+    bool is_open() {
+        return reader.is_open();
+    }
+
+    /**
+     * @Method: 读取下一批BIGNUMs
+     * @param vector<BIGNUM*>& out 读取结果追加到out末尾
+     * @param size_t max 最多读取的个数
+     * @return size_t 实际读取的个数，为0表示已读完
+     */
+    size_t next(vector<BIGNUM*> &out, size_t max);
+
+private:
+    AsyncFileReader reader;
+    int line;
+    int currentLine;
+    const char* block;
+    size_t pos;
+    size_t len;
+    bool done;
+    // 跨越两个读取块的数字
+    string carry;
+};
+
+// 结果文件的输出格式
+enum OutputFormat {
+    // 文本格式
+    OUTPUT_TEXT,
+    // 按列存储的二进制格式，可以直接mmap读取
+    OUTPUT_BINARY
+};
+
+/*
+ * 二进制结果文件的布局（小端序，每一部分都按8字节对齐）：
+ *   文件头 16字节: char magic[4] = "DDCR"; uint32 version = 1; uint32 列数; uint32 保留
+ *   每一列 32字节列头: char name[16]; uint64 count; uint32 type; uint32 width
+ *   紧接着count * width字节的数据，末尾补0到8字节对齐
+ * type为RESULT_INT64时每个值是一个int64；
+ * type为RESULT_BIGNUM时每个值是1字节符号（1为负）加width - 1字节大端序绝对值
+ */
+static const char RESULT_MAGIC[4] = {'D', 'D', 'C', 'R'};
+static const uint32_t RESULT_VERSION = 1;
+static const uint32_t RESULT_INT64 = 1;
+static const uint32_t RESULT_BIGNUM = 2;
+
+// 带缓冲的结果写入器，只在缓冲区满或关闭时写入文件
+class ResultWriter {
+public:
+    ResultWriter(const string &filename, OutputFormat format);
+
+    bool is_open() {
+        return fd >= 0;
+    }
+
+    bool binary() {
+        return format == OUTPUT_BINARY;
+    }
+
+    /**
+     * @Method: 写入文本
+     * @param string s 文本
+     * @return void
+     */
+    void writeText(const string &s);
+
+    /**
+     * @Method: 以十进制文本写入BIGNUM
+     * @param const BIGNUM* bn 待写入的数
+     * @return void
+     */
+    void writeBIGNUM(const BIGNUM* bn);
+
+    /**
+     * @Method: 写入一列BIGNUM，全部能放入int64时按RESULT_INT64存储
+     * @param string name 列名，最长16字节
+     * @param vector<BIGNUM*> values 列数据
+     * @return void
+     */
+    void writeColumn(const string &name, const vector<BIGNUM*> &values);
+
+    /**
+     * @Method: 写入一列int64
+     * @param string name 列名，最长16字节
+     * @param vector<int64_t> values 列数据
+     * @return void
+     */
+    void writeColumn(const string &name, const vector<int64_t> &values);
+
+    /**
+     * @Method: 开始逐个写入一列数据，用于无法一次放入内存的列
+     * @param string name 列名，最长16字节
+     * @param uint64_t count 数据个数
+     * @param uint32_t type RESULT_INT64或RESULT_BIGNUM
+     * @param uint32_t width 每个值的字节数，RESULT_INT64时为8
+     * @return void
+     */
+    void beginColumn(const string &name, uint64_t count, uint32_t type, uint32_t width);
+
+    /**
+     * @Method: 按当前列的类型写入一个值
+     * @param const BIGNUM* bn 待写入的数
+     * @return void
+     */
+    void writeValue(const BIGNUM* bn);
+
+    /**
+     * @Method: 结束当前列，补齐8字节对齐
+     * @return void
+     */
+    void endColumn();
+
+    /**
+     * @Method: 写出缓冲区并关闭文件
+     * @return bool true:成功; false:写入失败
+     */
+    bool close();
+
+    ~ResultWriter();
+
+private:
+    int fd;
+    OutputFormat format;
+    vector<char> buffer;
+    size_t used;
+    uint32_t columns;
+    bool failed;
+    // 当前列的类型、宽度和已写入的字节数
+    uint32_t columnType;
+    uint32_t columnWidth;
+    size_t columnBytes;
+
+    void append(const void* data, size_t len);
+    void flush();
+    void writeColumnHeader(const string &name, uint64_t count, uint32_t type, uint32_t width);
+    void pad(size_t len);
+};
+
+// 二进制结果文件中的一列，数据直接指向映射的文件
+struct ResultColumn {
+    string name;
+    uint64_t count;
+    uint32_t type;
+    uint32_t width;
+    const unsigned char* data;
+
+    /**
+     * @Method: 读取第i个值
+     * @param size_t i 下标
+     * @return BIGNUM* 第i个值
+     */
+    BIGNUM* get(size_t i) const;
+};
+
+// 通过mmap读取二进制结果文件
+class ResultReader {
+public:
+    explicit ResultReader(const string &filename);
+
+    bool is_open() {
+        return addr != NULL;
+    }
+
+    /**
+     * @Method: 获取所有列
+     * @return vector<ResultColumn> 按写入顺序排列的列
+     */
+    const vector<ResultColumn> &columns() {
+        return cols;
+    }
+
+    /**
+     * @Method: 按列名查找列
+     * @param string name 列名
+     * @return const ResultColumn* 第一个同名的列，不存在时为NULL
+     */
+    const ResultColumn* column(const string &name);
+
+    ~ResultReader();
+
+private:
+    void* addr;
+    size_t size;
+    vector<ResultColumn> cols;
+};
+
+#endif //IO_H
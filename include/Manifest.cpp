@@ -0,0 +1,139 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Running a manifest of deal() jobs from one invocation
+*/
+
+#include "SHE.h"
+#include "PHE.h"
+#include "IO.h"
+#include "Executor.h"
+#include "Manifest.h"
+using namespace std;
+
+/**
+ * @Method: 解析任务的一个参数
+ * @param string param 形如key=value的参数
+ * @param DealOptions& options 任务选项
+ * @return bool true:成功; false:未知参数或取值错误
+ */
+static bool parseOption(const string &param, DealOptions &options) {
+    size_t eq = param.find('=');
+    if (eq == string::npos) {
+        return false;
+    }
+    string key = param.substr(0, eq);
+    string value = param.substr(eq + 1);
+    if (key == "format") {
+        if (value != "text" && value != "binary") {
+            return false;
+        }
+        options.format = value == "binary" ? OUTPUT_BINARY : OUTPUT_TEXT;
+    } else if (key == "stream") {
+        options.stream = value == "1";
+    } else if (key == "memory") {
+        char* end = NULL;
+        options.memoryBudget = strtoull(value.c_str(), &end, 10);
+        return !value.empty() && *end == '\0';
+    } else if (key == "spill") {
+        options.spillPath = value;
+    } else if (key == "resume") {
+        options.resume = value == "1";
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @Method: 读取任务清单
+ * @param string manifestFile 清单文件
+ * @param vector<ManifestJob>& jobs 读取的任务
+ * @return bool true:成功; false:无法打开或格式错误
+ */
+bool readManifest(const string &manifestFile, vector<ManifestJob> &jobs) {
+    ifstream in(manifestFile.c_str());
+    if (!in.is_open()) {
+        cerr << "Unable to open file " << manifestFile << endl;
+        return false;
+    }
+    string text;
+    int line = 0;
+    while (getline(in, text)) {
+        line++;
+        istringstream fields(text);
+        ManifestJob job;
+        job.line = line;
+        if (!(fields >> job.algoName) || job.algoName[0] == '#') {
+            continue;
+        }
+        if (!(fields >> job.fileString >> job.resultFilePath)) {
+            cerr << manifestFile << ":" << line << ": expected algorithm, input and output" << endl;
+            return false;
+        }
+        string param;
+        while (fields >> param) {
+            if (!parseOption(param, job.options)) {
+                cerr << manifestFile << ":" << line << ": invalid parameter " << param << endl;
+                return false;
+            }
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+/**
+ * @Method: 执行任务清单
+ * @param string manifestFile 清单文件
+ * @param int jobThreads 同时执行的任务数，为0时使用全局线程池的线程数
+ * @return 状态码，1：全部成功；0：有任务失败
+ */
+int runManifest(const string &manifestFile, int jobThreads) {
+    vector<ManifestJob> jobs;
+    if (!readManifest(manifestFile, jobs)) {
+        return 0;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // 所有任务复用同一组密钥和解析后的输入
+    setKeyReuse_PHE(true);
+    setInputCache(true);
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+
+    // 调度线程依次领取任务。任务不作为线程池的任务执行，否则等待并行循环的线程
+    // 可能领取到另一个任务，而该任务又在等待前者正在解析的输入文件
+    if (jobThreads <= 0) {
+        jobThreads = executor().size();
+    }
+    jobThreads = max(1, min(jobThreads, (int) jobs.size()));
+    atomic<size_t> next(0);
+    atomic<int> failed(0);
+    mutex printMutex;
+    vector<thread> runners;
+    for (int t = 0; t < jobThreads; t++) {
+        runners.push_back(thread([&] {
+            for (size_t i = next++; i < jobs.size(); i = next++) {
+                ManifestJob &job = jobs[i];
+                chrono::steady_clock::time_point jobStart = chrono::steady_clock::now();
+                int status = deal(job.algoName, job.fileString, job.resultFilePath, job.options);
+                double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - jobStart).count();
+                if (!status) {
+                    failed++;
+                }
+                lock_guard<mutex> lock(printMutex);
+                printf("line %d %s %s -> %s: %s, %f ms\n", job.line, job.algoName.c_str(), job.fileString.c_str(),
+                       job.resultFilePath.c_str(), status ? "ok" : "failed", elapsed);
+                fflush(stdout);
+            }
+        }));
+    }
+    for (size_t i = 0; i < runners.size(); i++) {
+        runners[i].join();
+    }
+
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    printf("%zu jobs, %d failed, %f ms\n", jobs.size(), (int) failed, elapsed);
+    fflush(stdout);
+    return failed == 0 ? 1 : 0;
+}
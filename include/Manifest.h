@@ -0,0 +1,45 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Running a manifest of deal() jobs from one invocation
+*/
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <bits/stdc++.h>
+#include "PHE.h"
+using namespace std;
+
+// 清单中的一个任务
+struct ManifestJob {
+    // 清单文件中的行号
+    int line;
+    string algoName;
+    string fileString;
+    string resultFilePath;
+    DealOptions options;
+};
+
+/**
+ * @Method: 读取任务清单
+ * 每行一个任务：算法名称 输入文件 输出文件 [参数...]，空行和以#开头的行被忽略；
+ * 参数为format=text|binary、stream=0|1、memory=字节数、spill=溢写文件前缀、resume=0|1
+ * @param string manifestFile 清单文件
+ * @param vector<ManifestJob>& jobs 读取的任务
+ * @return bool true:成功; false:无法打开或格式错误
+ */
+bool readManifest(const string &manifestFile, vector<ManifestJob> &jobs);
+
+/**
+ * @Method: 执行任务清单
+ * 只生成一次密钥，所有任务复用；读取同一输入文件的任务共享解析结果。
+ * 任务由若干个调度线程并行执行，每个任务内部的计算仍在全局线程池上并行；
+ * 任务之间不能有依赖关系，即某个任务的输入不能是另一个任务的输出
+ * @param string manifestFile 清单文件
+ * @param int jobThreads 同时执行的任务数，为0时使用全局线程池的线程数
+ * @return 状态码，1：全部成功；0：有任务失败
+ */
+int runManifest(const string &manifestFile, int jobThreads = 0);
+
+#endif //MANIFEST_H
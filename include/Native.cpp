@@ -0,0 +1,180 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Native integer fast path for plaintext arithmetic
+*/
+
+#include "Native.h"
+#include <openssl/bn.h>
+using namespace std;
+
+/**
+ * @Method: 将BIGNUM转换为int64
+ * @param const BIGNUM* a 待转换的数
+ * @param int64_t* out 转换结果
+ * @return bool true:a能放入int64; false:a超出int64范围
+ */
+bool BN_to_int64(const BIGNUM* a, int64_t* out) {
+    if (BN_num_bits(a) > 63) {
+        return false;
+    }
+    int64_t v = (int64_t) BN_get_word(a);
+    *out = BN_is_negative(a) ? -v : v;
+    return true;
+}
+
+/**
+ * @Method: 将__int128转换为BIGNUM
+ * @param __int128 v 待转换的数
+ * @return BIGNUM* 转换结果
+ */
+BIGNUM* int128_to_BN(__int128 v) {
+    BIGNUM* res = BN_new();
+    unsigned __int128 u = v < 0 ? -(unsigned __int128) v : (unsigned __int128) v;
+    // 先设置高64位，再左移并加上低64位
+    BN_set_word(res, (BN_ULONG) (u >> 64));
+    BN_lshift(res, res, 64);
+    BN_add_word(res, (BN_ULONG) u);
+    BN_set_negative(res, v < 0);
+    return res;
+}
+
+/**
+ * @Method: 将BIGNUM列表转换为int64列表
+ * @param const vector<BIGNUM*>& x BIGNUM列表
+ * @param vector<int64_t>& out 转换结果
+ * @return bool true:全部数据都能放入int64; false:存在超出范围的数据，需回退到BIGNUM
+ */
+bool toNative(const vector<BIGNUM*> &x, vector<int64_t> &out) {
+    out.resize(x.size());
+    for (size_t i = 0; i < x.size(); i++) {
+        if (!BN_to_int64(x[i], &out[i])) {
+            out.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @Method: 计算x的平方，能放入int64时使用原生整数运算
+ * @param const BIGNUM* x 待平方的数
+ * @return BIGNUM* x * x
+ */
+BIGNUM* square_native(const BIGNUM* x) {
+    int64_t v;
+    if (BN_to_int64(x, &v)) {
+        return int128_to_BN((__int128) v * v);
+    }
+    BIGNUM* res = BN_new();
+    BN_CTX* ctx = BN_CTX_new();
+    BN_sqr(res, x, ctx);
+    BN_CTX_free(ctx);
+    return res;
+}
+
+/**
+ * @Method: 求平方和
+ * @param const int64_t* x 数据
+ * @param size_t n 数据个数
+ * @param __int128* out x[0]^2 + ... + x[n - 1]^2
+ * @return bool true:成功; false:__int128溢出，需回退到BIGNUM
+ */
+bool sumSquares_native(const int64_t* x, size_t n, __int128* out) {
+    // 先求最大绝对值，判断能否全程使用int64累加
+    uint64_t max_abs = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t a = x[i] < 0 ? -(uint64_t) x[i] : (uint64_t) x[i];
+        max_abs = max(max_abs, a);
+    }
+
+    if (max_abs < (1ULL << 31) && (max_abs == 0 || n <= (uint64_t) INT64_MAX / (max_abs * max_abs))) {
+        // 平方和不会超出int64，该循环可以被编译器向量化
+        int64_t sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            sum += x[i] * x[i];
+        }
+        *out = sum;
+        return true;
+    }
+
+    __int128 sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (__builtin_add_overflow(sum, (__int128) x[i] * x[i], &sum)) {
+            return false;
+        }
+    }
+    *out = sum;
+    return true;
+}
+
+/**
+ * @Method: 数乘，out[i] = c * x[i]
+ * @param const int64_t* x 数据
+ * @param size_t n 数据个数
+ * @param int64_t c 系数
+ * @param int64_t* out 结果
+ * @return bool true:成功; false:int64溢出，需回退到BIGNUM
+ */
+bool scale_native(const int64_t* x, size_t n, int64_t c, int64_t* out) {
+    bool overflow = false;
+    for (size_t i = 0; i < n; i++) {
+        overflow |= __builtin_mul_overflow(x[i], c, &out[i]);
+    }
+    return !overflow;
+}
+
+/**
+ * @Method: 同时求最小值和最大值的下标
+ * @param const int64_t* x 数据，n > 0
+ * @param size_t n 数据个数
+ * @param size_t* min_index 第一个最小值的下标
+ * @param size_t* max_index 第一个最大值的下标
+ * @return void
+ */
+void minmax_native(const int64_t* x, size_t n, size_t* min_index, size_t* max_index) {
+    // 先求最值，该循环可以被编译器向量化
+    int64_t lo = x[0];
+    int64_t hi = x[0];
+    for (size_t i = 1; i < n; i++) {
+        lo = min(lo, x[i]);
+        hi = max(hi, x[i]);
+    }
+
+    // 再找到最值第一次出现的位置
+    size_t i = 0;
+    while (x[i] != lo) {
+        i++;
+    }
+    *min_index = i;
+    i = 0;
+    while (x[i] != hi) {
+        i++;
+    }
+    *max_index = i;
+}
+
+/**
+ * @Method: 计算每个数据所属的分箱
+ * @param const int64_t* x 数据，均不小于lower
+ * @param size_t n 数据个数
+ * @param int64_t lower 第一个分箱的下界
+ * @param uint64_t length 分箱长度
+ * @param int k 分箱个数
+ * @param int* bin 每个数据所属的分箱下标
+ * @return void
+ */
+void binIndex_native(const int64_t* x, size_t n, int64_t lower, uint64_t length, int k, int* bin) {
+    // 分箱长度为0时所有数据都在最后一个分箱
+    if (length == 0) {
+        for (size_t i = 0; i < n; i++) {
+            bin[i] = k - 1;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t j = ((uint64_t) x[i] - (uint64_t) lower) / length;
+        bin[i] = j < (uint64_t) k ? (int) j : k - 1;
+    }
+}
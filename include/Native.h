@@ -0,0 +1,86 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Native integer fast path for plaintext arithmetic
+*/
+
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include <bits/stdc++.h>
+#include <openssl/bn.h>
+using namespace std;
+
+/**
+ * @Method: 将BIGNUM转换为int64
+ * @param const BIGNUM* a 待转换的数
+ * @param int64_t* out 转换结果
+ * @return bool true:a能放入int64; false:a超出int64范围
+ */
+bool BN_to_int64(const BIGNUM* a, int64_t* out);
+
+/**
+ * @Method: 将__int128转换为BIGNUM
+ * @param __int128 v 待转换的数
+ * @return BIGNUM* 转换结果
+ */
+BIGNUM* int128_to_BN(__int128 v);
+
+/**
+ * @Method: 将BIGNUM列表转换为int64列表
+ * @param const vector<BIGNUM*>& x BIGNUM列表
+ * @param vector<int64_t>& out 转换结果
+ * @return bool true:全部数据都能放入int64; false:存在超出范围的数据，需回退到BIGNUM
+ */
+bool toNative(const vector<BIGNUM*> &x, vector<int64_t> &out);
+
+/**
+ * @Method: 计算x的平方，能放入int64时使用原生整数运算
+ * @param const BIGNUM* x 待平方的数
+ * @return BIGNUM* x * x
+ */
+BIGNUM* square_native(const BIGNUM* x);
+
+/**
+ * @Method: 求平方和
+ * @param const int64_t* x 数据
+ * @param size_t n 数据个数
+ * @param __int128* out x[0]^2 + ... + x[n - 1]^2
+ * @return bool true:成功; false:__int128溢出，需回退到BIGNUM
+ */
+bool sumSquares_native(const int64_t* x, size_t n, __int128* out);
+
+/**
+ * @Method: 数乘，out[i] = c * x[i]
+ * @param const int64_t* x 数据
+ * @param size_t n 数据个数
+ * @param int64_t c 系数
+ * @param int64_t* out 结果
+ * @return bool true:成功; false:int64溢出，需回退到BIGNUM
+ */
+bool scale_native(const int64_t* x, size_t n, int64_t c, int64_t* out);
+
+/**
+ * @Method: 同时求最小值和最大值的下标
+ * @param const int64_t* x 数据，n > 0
+ * @param size_t n 数据个数
+ * @param size_t* min_index 第一个最小值的下标
+ * @param size_t* max_index 第一个最大值的下标
+ * @return void
+ */
+void minmax_native(const int64_t* x, size_t n, size_t* min_index, size_t* max_index);
+
+/**
+ * @Method: 计算每个数据所属的分箱
+ * 第j个分箱为[lower + j * length, lower + (j + 1) * length)，超出最后一个分箱上界的数据归入最后一个分箱
+ * @param const int64_t* x 数据，均不小于lower
+ * @param size_t n 数据个数
+ * @param int64_t lower 第一个分箱的下界
+ * @param uint64_t length 分箱长度
+ * @param int k 分箱个数
+ * @param int* bin 每个数据所属的分箱下标
+ * @return void
+ */
+void binIndex_native(const int64_t* x, size_t n, int64_t lower, uint64_t length, int k, int* bin);
+
+#endif //NATIVE_H
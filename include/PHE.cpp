@@ -6,57 +6,93 @@
 
 #include "SHE.h"
 #include "PHE.h"
+#include "IO.h"
+#include "Native.h"
+#include "Pipeline.h"
+#include "Chunked.h"
+#include "Executor.h"
 #include <openssl/bn.h>
+#include <openssl/hmac.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
 using namespace std;
 
 PublicKey* pk = NULL;
-BN_CTX* CTX = BN_CTX_new();
+
+// 是否复用已生成的密钥
+static bool reuseKeys = false;
+static mutex keysMutex;
+
+// 一个NUMA节点上的只读公钥副本，由该节点上的线程复制，按首次访问分配在该节点的内存中
+struct KeyReplica {
+    BIGNUM* N;
+    BIGNUM* zero1_prime;
+    BIGNUM* zero2_prime;
+};
+
+// replicas[id][i]为编号为id的公钥在第i个节点的副本。全局公钥的副本与全局公钥一样不释放，
+// 其它公钥（如分块任务的密钥）的副本由releaseKeyReplicas_PHE在公钥释放前释放
+static map<uint64_t, vector<KeyReplica*> > replicas;
+static mutex replicasMutex;
 
 /**
- * @Method: 从文件中读取BIGNUMs
- * @param filename 文件名
- * @return vector<BIGNUM*> BIGNUMs列表
+ * @Method: 将b加到a上并释放b，用于合并并行归约的部分和
+ * @param BIGNUM* a 部分和
+ * @param BIGNUM* b 部分和
+ * @return BIGNUM* a + b，存放在a中
  */
-vector<BIGNUM*> readBIGNUMsFromFile(const string &filename) {
-    vector<BIGNUM*> data_list;
-    ifstream infile(filename);
-    string line;
-    
-    while (getline(infile, line)) {
-        BIGNUM* bn = BN_new();
-        BN_dec2bn(&bn, line.c_str());
-        data_list.push_back(bn);
-    }
-
-    return data_list;
+static BIGNUM* addBIGNUM(BIGNUM* a, BIGNUM* b) {
+    BN_add(a, a, b);
+    BN_free(b);
+    return a;
 }
 
 /**
- * @Method: 从文件中读取BIGNUMs，产生两个列表
- * @param string filename 文件名
- * @param int lineNumber 行号
- * @return vector<BIGNUM*> BIGNUMs列表
+ * @Method: 乘加acc += c * w。权重能放入一个字时用BN_mul_word在t中原地相乘，省去一般乘法的临时空间
+ * @param BIGNUM* acc 累加和
+ * @param BIGNUM* c 密文
+ * @param BIGNUM* w 明文权重
+ * @param BIGNUM* t 调用者提供的临时变量，可在多次调用间复用
+ * @param BN_CTX* ctx 上下文
+ * @return void
  */
-vector<BIGNUM*> readBIGNUMsFromFile(const string &filename, int lineNumber) {
-    ifstream infile(filename);
-    string line;
-    vector<BIGNUM*> result;
-    int currentLine = 0;
-
-    while (getline(infile, line)) {
-        if (++currentLine == lineNumber) {
-            istringstream iss(line);
-            string number;
-            while (iss >> number) {
-                BIGNUM* bn = BN_new();
-                BN_dec2bn(&bn, number.c_str());
-                result.push_back(bn);
-            }
-            break;
+static void mulAddBIGNUM(BIGNUM* acc, const BIGNUM* c, const BIGNUM* w, BIGNUM* t, BN_CTX* ctx) {
+    if (BN_is_zero(w)) {
+        return;
+    }
+    if (BN_num_bytes(w) <= (int) sizeof(BN_ULONG)) {
+        BN_copy(t, c);
+        BN_mul_word(t, BN_get_word(w));
+        if (BN_is_negative(w)) {
+            BN_sub(acc, acc, t);
+        } else {
+            BN_add(acc, acc, t);
         }
+        return;
     }
+    BN_mul(t, c, w, ctx);
+    BN_add(acc, acc, t);
+}
 
-    return result;
+/**
+ * @Method: 并行计算平方和
+ * @param vector<BIGNUM*> x 数据
+ * @return BIGNUM* x[0]^2 + ... + x[n - 1]^2
+ */
+static BIGNUM* sumSquares_PHE(const vector<BIGNUM*> &x) {
+    BIGNUM* zero = BN_new();
+    BN_zero(zero);
+    return executor().parallel_reduce((size_t) 0, x.size(), 0, zero, [&](size_t b0, size_t b1) {
+        BIGNUM* part = BN_new();
+        BIGNUM* t = BN_new();
+        BN_zero(part);
+        for (size_t i = b0; i < b1; i++) {
+            BN_sqr(t, x[i], localCTX());
+            BN_add(part, part, t);
+        }
+        BN_free(t);
+        return part;
+    }, addBIGNUM);
 }
 
 /**
@@ -65,13 +101,13 @@ vector<BIGNUM*> readBIGNUMsFromFile(const string &filename, int lineNumber) {
  * @return BIGNUM*  sqrt(n)
  */
 BIGNUM* BN_sqrt(const BIGNUM* n) {
-    BIGNUM *low = BN_CTX_get(CTX);
-    BIGNUM *high = BN_CTX_get(CTX);
-    BIGNUM *mid = BN_CTX_get(CTX);
-    BIGNUM *mid_squared = BN_CTX_get(CTX);
-    BIGNUM *one = BN_CTX_get(CTX);
-    BIGNUM *two = BN_CTX_get(CTX);
-    BIGNUM *tmp = BN_CTX_get(CTX);
+    BIGNUM *low = BN_new();
+    BIGNUM *high = BN_new();
+    BIGNUM *mid = BN_new();
+    BIGNUM *mid_squared = BN_new();
+    BIGNUM *one = BN_new();
+    BIGNUM *two = BN_new();
+    BIGNUM *tmp = BN_new();
 
     BN_copy(low, BN_value_one());  // low = 1
     BN_copy(high, n);              // high = n
@@ -82,7 +118,7 @@ BIGNUM* BN_sqrt(const BIGNUM* n) {
         BN_add(tmp, low, high);
         BN_rshift1(mid, tmp);      // mid = (low + high) / 2
 
-        BN_sqr(mid_squared, mid, CTX);  // mid_squared = mid * mid
+        BN_sqr(mid_squared, mid, localCTX());  // mid_squared = mid * mid
 
         int cmp = BN_cmp(mid_squared, n);
         if (cmp == 0) {
@@ -102,6 +138,8 @@ BIGNUM* BN_sqrt(const BIGNUM* n) {
         }
     }
 
+    BN_free(high);
+    BN_free(mid);
     BN_free(mid_squared);
     BN_free(one);
     BN_free(two);
@@ -116,8 +154,8 @@ BIGNUM* BN_sqrt(const BIGNUM* n) {
  */
 void generatePublicKeys_PHE() {
     // 使用SHE的加密方式生成两个为0的密文
-    BIGNUM* zero1 = BN_CTX_get(CTX);
-    BIGNUM* zero2 = BN_CTX_get(CTX);
+    BIGNUM* zero1 = BN_new();
+    BIGNUM* zero2 = BN_new();
     BN_zero(zero1);
     BN_zero(zero2);
     BIGNUM* zero1_prime = encrypt_SHE(zero1, sk);
@@ -133,10 +171,15 @@ void generatePublicKeys_PHE() {
 }
 
 /**
- * @Method 生成公钥和私钥
+ * @Method 生成公钥和私钥，开启密钥复用且已有参数相同的密钥时直接返回
  * @return void
  */
 void InitKeys_PHE(int a, int b, int c, int d, int e) {
+    lock_guard<mutex> lock(keysMutex);
+    if (reuseKeys && pk != NULL && sk != NULL && k_M == a && k_r == b && k_L == c && k_p == d && k_q == e) {
+        return;
+    }
+
     // 生成私钥
     generateKeys(a, b, c, d, e);
 
@@ -144,6 +187,107 @@ void InitKeys_PHE(int a, int b, int c, int d, int e) {
     generatePublicKeys_PHE();
 }
 
+/**
+ * @Method 设置是否复用已生成的密钥
+ * 开启后各协议不再每次重新生成密钥，常驻进程预先生成一次密钥后可以并发执行多个任务
+ * @param bool reuse 是否复用
+ * @return void
+ */
+void setKeyReuse_PHE(bool reuse) {
+    lock_guard<mutex> lock(keysMutex);
+    reuseKeys = reuse;
+}
+
+/**
+ * @Method 复制当前的全局公钥和私钥，之后其它任务重新生成密钥不影响复制出的密钥
+ * @param PublicKey** copiedPk 复制的公钥，由调用者释放
+ * @param PrivateKey** copiedSk 复制的私钥，由调用者释放
+ * @return void
+ */
+void copyKeys_PHE(PublicKey** copiedPk, PrivateKey** copiedSk) {
+    lock_guard<mutex> lock(keysMutex);
+    *copiedPk = new PublicKey(pk->get_k_M(), pk->get_k_r(), pk->get_k_L(), pk->get_k_p(), pk->get_k_q(),
+                              pk->peek_N(), pk->peek_zero1_prime(), pk->peek_zero2_prime());
+    *copiedSk = new PrivateKey(sk->peekP(), sk->peekL());
+}
+
+/**
+ * @Method 用保存的参数和密钥构造一对公私钥，用于从检查点恢复任务，不改变全局的公钥和私钥
+ * 同时运行的其它任务仍使用原来的全局密钥，因此恢复的任务只能用这一对密钥加密和解密
+ * @param int params[5] k_M、k_r、k_L、k_p、k_q
+ * @param BIGNUM* p 私钥p
+ * @param BIGNUM* L 私钥L
+ * @param BIGNUM* N 公开的模数
+ * @param BIGNUM* zero1_prime 公钥中0的密文
+ * @param BIGNUM* zero2_prime 公钥中0的密文
+ * @param PublicKey** restoredPk 恢复的公钥，由调用者释放
+ * @param PrivateKey** restoredSk 恢复的私钥，由调用者释放
+ * @return void
+ */
+void restoreKeys_PHE(const int params[5], const BIGNUM* p, const BIGNUM* L, const BIGNUM* N, const BIGNUM* zero1_prime,
+                     const BIGNUM* zero2_prime, PublicKey** restoredPk, PrivateKey** restoredSk) {
+    *restoredPk = new PublicKey(params[0], params[1], params[2], params[3], params[4], N, zero1_prime, zero2_prime);
+    *restoredSk = new PrivateKey(p, L);
+}
+
+/**
+ * @Method: 获取当前线程所在节点的公钥副本，只有一个节点时不复制
+ * @param PublicKey* key 公钥
+ * @return KeyReplica* 副本，只有一个节点时为NULL
+ */
+static const KeyReplica* localKeyReplica(const PublicKey* key) {
+    // 先比较编号再使用缓存的指针：编号不会重复，编号相同说明公钥仍在使用，副本尚未释放
+    static thread_local uint64_t cachedId = 0;
+    static thread_local const KeyReplica* cached = NULL;
+    if (cached != NULL && cachedId == key->get_id()) {
+        return cached;
+    }
+    int nodes = numaNodes();
+    if (nodes == 1) {
+        return NULL;
+    }
+    int node = currentNode();
+    lock_guard<mutex> lock(replicasMutex);
+    vector<KeyReplica*> &nodeReplicas = replicas[key->get_id()];
+    if (nodeReplicas.size() < (size_t) nodes) {
+        nodeReplicas.resize(nodes, NULL);
+    }
+    KeyReplica* replica = nodeReplicas[node];
+    if (replica == NULL) {
+        replica = new KeyReplica();
+        replica->N = BN_dup(key->peek_N());
+        replica->zero1_prime = BN_dup(key->peek_zero1_prime());
+        replica->zero2_prime = BN_dup(key->peek_zero2_prime());
+        nodeReplicas[node] = replica;
+    }
+    cachedId = key->get_id();
+    cached = replica;
+    return replica;
+}
+
+/**
+ * @Method: 释放一个公钥在所有节点上的副本，须在公钥释放前、不再用它加密后调用
+ * @param uint64_t keyId 公钥的编号
+ * @return void
+ */
+void releaseKeyReplicas_PHE(uint64_t keyId) {
+    lock_guard<mutex> lock(replicasMutex);
+    map<uint64_t, vector<KeyReplica*> >::iterator it = replicas.find(keyId);
+    if (it == replicas.end()) {
+        return;
+    }
+    for (size_t i = 0; i < it->second.size(); i++) {
+        KeyReplica* replica = it->second[i];
+        if (replica != NULL) {
+            BN_free(replica->N);
+            BN_free(replica->zero1_prime);
+            BN_free(replica->zero2_prime);
+            delete replica;
+        }
+    }
+    replicas.erase(it);
+}
+
 /**
  * @Method 加密
  * @param BIGNUM*  m 消息
@@ -151,34 +295,42 @@ void InitKeys_PHE(int a, int b, int c, int d, int e) {
  * @return BIGNUM* [[m]] 密文消息
  */
 BIGNUM* encrypt_PHE(BIGNUM* m, PublicKey* pk) {
-    BIGNUM* E_m = BN_CTX_get(CTX);
-    // 生成两个k_r比特的随机数r_1和r_2
-    BIGNUM* r_1 = generateRandom(k_r);
-    BIGNUM* r_2 = generateRandom(k_r);
+    BN_CTX* ctx = localCTX();
+    BIGNUM* E_m = BN_new();
+    // 生成两个k_r比特的随机数r_1和r_2，参数和模数都取自公钥，与全局密钥无关
+    BIGNUM* r_1 = generateRandom(pk->get_k_r());
+    BIGNUM* r_2 = generateRandom(pk->get_k_r());
     // 创建临时变量
-    BIGNUM* temp = BN_CTX_get(CTX);
+    BIGNUM* temp = BN_new();
+    // 有多个NUMA节点时使用本节点的副本，避免跨节点读取公钥
+    const KeyReplica* replica = localKeyReplica(pk);
+    const BIGNUM* zero1_prime = replica != NULL ? replica->zero1_prime : pk->peek_zero1_prime();
+    const BIGNUM* zero2_prime = replica != NULL ? replica->zero2_prime : pk->peek_zero2_prime();
+    const BIGNUM* modulus = replica != NULL ? replica->N : pk->peek_N();
 
     // 计算密文[m] = (m + r_1 * zero1_prime + r_2 * zero2_prime) mod N
 
     // 计算m_prime = (r_1 * zero1_prime) mod N
-    BN_mul(E_m, r_1, pk->get_zero1_prime(), CTX);
-    BN_mod(E_m, E_m, N, CTX);
+    BN_mul(E_m, r_1, zero1_prime, ctx);
+    BN_mod(E_m, E_m, modulus, ctx);
 
     // 计算m_prime = (m_prime + m) mod N
     BN_add(E_m, E_m, m);
-    BN_mod(E_m, E_m, N, CTX);
+    BN_mod(E_m, E_m, modulus, ctx);
 
 
     // 计算temp = (r_2 * zero2_prime) mod N
-    BN_mul(temp, r_2, pk->get_zero2_prime(), CTX);
-    BN_mod(temp, temp, N, CTX);
+    BN_mul(temp, r_2, zero2_prime, ctx);
+    BN_mod(temp, temp, modulus, ctx);
 
     // 计算m_prime = (m_prime + temp) mod N
     BN_add(E_m, E_m, temp);
-    BN_mod(E_m, E_m, N, CTX);
+    BN_mod(E_m, E_m, modulus, ctx);
 
     // 释放临时变量
     BN_free(temp);
+    BN_free(r_1);
+    BN_free(r_2);
 
     // 返回加密结果
     return E_m;
@@ -191,27 +343,55 @@ BIGNUM* encrypt_PHE(BIGNUM* m, PublicKey* pk) {
  * @return BIGNUM* m 消息
  */
 BIGNUM* decrypt_PHE(BIGNUM* E_m, PrivateKey* sk) {
-    // 计算m_prime = E_m % p % L;
-    BIGNUM* m_prime = BN_CTX_get(CTX);
-    BN_mod(m_prime, E_m, sk->getP(), CTX);
-    BN_mod(m_prime, m_prime, sk->getL(), CTX);
+    BN_CTX* ctx = localCTX();
+    const BIGNUM* p = sk->peekP();
+    const BIGNUM* L = sk->peekL();
 
-    // 计算sk.getL() / 2
-    BIGNUM* half_L = BN_CTX_get(CTX);
-    BN_rshift1(half_L, sk->getL());
+    // 计算m_prime = E_m % p % L;
+    BIGNUM* m_prime = BN_new();
+    BN_mod(m_prime, E_m, p, ctx);
+    BN_mod(m_prime, m_prime, L, ctx);
 
-    // 如果m_prime < sk.getL() / 2，返回m_prime
-    if (BN_cmp(m_prime, half_L) < 0) {
-        BN_free(half_L);
-        return m_prime;
+    // 如果m_prime >= sk.getL() / 2，返回m_prime - sk.getL()，否则返回m_prime
+    if (BN_cmp(m_prime, sk->peekHalfL()) >= 0) {
+        BN_sub(m_prime, m_prime, L);
     }
 
-    // 否则返回m_prime - sk.getL()
-    BN_sub(m_prime, m_prime, sk->getL());
-    BN_free(half_L);
     return m_prime;
 }
 
+/**
+ *@Method 在线程池中并行加密一组明文
+ *@param vector<BIGNUM*> m 明文
+ *@param PublicKey* pk 公钥
+ *@return vector<BIGNUM*> 密文，与m按下标一一对应
+ */
+vector<BIGNUM*> encryptBatch_PHE(const vector<BIGNUM*> &m, PublicKey* pk) {
+    vector<BIGNUM*> E_m(m.size());
+    executor().parallel_for(0, m.size(), 0, [&](size_t b0, size_t b1) {
+        for (size_t i = b0; i < b1; i++) {
+            E_m[i] = encrypt_PHE(m[i], pk);
+        }
+    });
+    return E_m;
+}
+
+/**
+ *@Method 在线程池中并行解密一组密文
+ *@param vector<BIGNUM*> E_m 密文
+ *@param PrivateKey* sk 私钥
+ *@return vector<BIGNUM*> 明文，与E_m按下标一一对应
+ */
+vector<BIGNUM*> decryptBatch_PHE(const vector<BIGNUM*> &E_m, PrivateKey* sk) {
+    vector<BIGNUM*> m(E_m.size());
+    executor().parallel_for(0, E_m.size(), 0, [&](size_t b0, size_t b1) {
+        for (size_t i = b0; i < b1; i++) {
+            m[i] = decrypt_PHE(E_m[i], sk);
+        }
+    });
+    return m;
+}
+
 /**
  *@Method 均值计算
  *@param vector<BIGNUM*> data_list 数据集合
@@ -277,28 +457,41 @@ BIGNUM* avg_PHE(vector<BIGNUM*> data_list) {
     do2->set_pk(do1->get_pk());
 
     // 用户将数据加密并发送给用户2
-    for (int i = 0; i < data_list.size(); i++) {
-        data_list[i] = encrypt_PHE(data_list[i], do1->get_pk());
-    }
-
-    // 由用户2来计算所有数据的总和
-    BIGNUM* sum = BN_CTX_get(CTX);
-    BN_zero(sum);
-    for (int i = 0; i < data_list.size(); i++) {
-        BN_add(sum, sum, data_list[i]);
-        BN_mod(sum, sum, N, CTX);
-    }
+    executor().parallel_for(0, data_list.size(), 0, [&](size_t b0, size_t b1) {
+        for (size_t i = b0; i < b1; i++) {
+            data_list[i] = encrypt_PHE(data_list[i], do1->get_pk());
+        }
+    });
+
+    // 由用户2来计算所有数据的总和，各块的部分和对N取模后按块的顺序合并
+    BIGNUM* zero = BN_new();
+    BN_zero(zero);
+    BIGNUM* sum = executor().parallel_reduce((size_t) 0, data_list.size(), 0, zero, [&](size_t b0, size_t b1) {
+        BIGNUM* part = BN_new();
+        BN_zero(part);
+        for (size_t i = b0; i < b1; i++) {
+            BN_add(part, part, data_list[i]);
+            BN_mod(part, part, N, localCTX());
+        }
+        return part;
+    }, [](BIGNUM* a, BIGNUM* b) {
+        BN_add(a, a, b);
+        BN_mod(a, a, N, localCTX());
+        BN_free(b);
+        return a;
+    });
 
     // 由用户1利用私钥恢复出sum，然后再计算均值
-    BIGNUM* avg = BN_CTX_get(CTX);
-    BIGNUM* temp = BN_CTX_get(CTX);
+    BIGNUM* avg = BN_new();
+    BIGNUM* temp = BN_new();
     // 将sum解密
-    sum = decrypt_PHE(sum, sk);
+    BIGNUM* plain = decrypt_PHE(sum, sk);
     BN_set_word(temp, data_list.size());
-    BN_div(avg, NULL, sum, temp, CTX);
+    BN_div(avg, NULL, plain, temp, localCTX());
     // 释放临时变量
     BN_free(temp);
     BN_free(sum);
+    BN_free(plain);
     //此处均值只保留的整数部分
     return avg;
 }
@@ -329,10 +522,8 @@ bool compare_PHE(BIGNUM* x1, BIGNUM* x2) {
     // 用户2计算res = r1 * (E_x1 - x2) - r2
 
     // 生成两个k_M比特的随机数r1, r2
-    BIGNUM* r1 = BN_CTX_get(CTX);
-    BIGNUM* r2= BN_CTX_get(CTX);
-    r1 = generateRandom(k_M);
-    r2 = generateRandom(k_M);
+    BIGNUM* r1 = generateRandom(k_M);
+    BIGNUM* r2 = generateRandom(k_M);
 
     // 要保证r1 > r2 > 0
     while (BN_cmp(r1, r2) != 1) {
@@ -341,12 +532,12 @@ bool compare_PHE(BIGNUM* x1, BIGNUM* x2) {
     }
 
     // 创建临时变量res
-    BIGNUM* res = BN_CTX_get(CTX);
+    BIGNUM* res = BN_new();
     // 计算res = E_x1 - x2
     BN_sub(res, do1->get_x(), x2);
 
     // 计算res = res * r1
-    BN_mul(res, res, r1, CTX);
+    BN_mul(res, res, r1, localCTX());
     // 计算res = res - r2
     BN_sub(res, res, r2);
 
@@ -369,6 +560,153 @@ bool compare_PHE(BIGNUM* x1, BIGNUM* x2) {
     return true;
 }
 
+/**
+ *@Method 生成一对k_M比特的随机数r1 > r2 > 0
+ * 取两个独立的随机数，较大的为r1，较小的为r2，与r1 > r2条件下的拒绝采样同分布，但不需要反复重新生成
+ *@param BIGNUM* r1 较大的随机数
+ *@param BIGNUM* r2 较小的随机数
+ *@return void
+ */
+static void randomMaskPair(BIGNUM* r1, BIGNUM* r2) {
+    do {
+        BN_rand(r1, k_M, -1, 0);
+        BN_rand(r2, k_M, -1, 0);
+    } while (BN_cmp(r1, r2) == 0 || BN_is_zero(r1) || BN_is_zero(r2));
+    if (BN_cmp(r1, r2) < 0) {
+        BN_swap(r1, r2);
+    }
+}
+
+/**
+ *@Method 用已有的密钥进行一轮批量比较
+ *@param vector<BIGNUM*> xs 用户DO1持有的数据
+ *@param vector<BIGNUM*> ys 用户DO2持有的数据，与xs按下标一一对应
+ *@return vector<bool> 第i位为true时xs[i] > ys[i]
+ */
+static vector<bool> compareRound_PHE(const vector<BIGNUM*> &xs, const vector<BIGNUM*> &ys) {
+    // 用户1将所有数据加密后一次发给用户2
+    vector<BIGNUM*> E_x = encryptBatch_PHE(xs, pk);
+
+    // 用户2对每一对数据用独立的(r1, r2)计算res = r1 * (E_x - y) - r2，结果一次发回用户1
+    executor().parallel_for(0, E_x.size(), 0, [&](size_t b0, size_t b1) {
+        BIGNUM* r1 = BN_new();
+        BIGNUM* r2 = BN_new();
+        for (size_t i = b0; i < b1; i++) {
+            randomMaskPair(r1, r2);
+            BN_sub(E_x[i], E_x[i], ys[i]);
+            BN_mul(E_x[i], E_x[i], r1, localCTX());
+            BN_sub(E_x[i], E_x[i], r2);
+        }
+        BN_free(r1);
+        BN_free(r2);
+    });
+
+    // 用户1批量解密，res >= 0时x > y
+    vector<BIGNUM*> res = decryptBatch_PHE(E_x, sk);
+    vector<bool> result(res.size());
+    for (size_t i = 0; i < res.size(); i++) {
+        result[i] = !BN_is_negative(res[i]);
+        BN_free(res[i]);
+        BN_free(E_x[i]);
+    }
+    return result;
+}
+
+/**
+ *@Method 批量数据比较，所有比较使用同一组密钥，只需一轮通信
+ *@param vector<BIGNUM*> xs 用户DO1持有的数据
+ *@param vector<BIGNUM*> ys 用户DO2持有的数据，与xs按下标一一对应
+ *@return vector<bool> 第i位为true时xs[i] > ys[i]，xs与ys长度不同时为空
+ */
+vector<bool> compare_PHE_batch(const vector<BIGNUM*> &xs, const vector<BIGNUM*> &ys) {
+    if (xs.size() != ys.size()) {
+        cerr << "Unable to compare " << xs.size() << " values with " << ys.size() << " values" << endl;
+        return vector<bool>();
+    }
+
+    // 用户1生成一次公私钥
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+    return compareRound_PHE(xs, ys);
+}
+
+/**
+ *@Method 锦标赛方式的安全最小值与最大值
+ *第一层两两比较，较小者进入最小值赛区，较大者进入最大值赛区，轮空的数据同时进入两个赛区；
+ *之后每一层两个赛区的所有配对合并为一次批量比较，共ceil(log2 n)轮，而不是n次逐个比较
+ *@param vector<BIGNUM*> datas 数据
+ *@param BIGNUM* min 最小值
+ *@param BIGNUM* max 最大值
+ *@return int 比较的轮数，datas为空时为-1
+ */
+int minmax_tournament_PHE(const vector<BIGNUM*> &datas, BIGNUM* min, BIGNUM* max) {
+    if (datas.empty()) {
+        cerr << "Unable to find min and max of empty data" << endl;
+        return -1;
+    }
+
+    // 只生成一次公私钥，所有轮次共用
+    if (datas.size() > 1) {
+        InitKeys_PHE(20, 80, 80, 1024, 96448);
+    }
+
+    vector<size_t> mins, maxs;
+    vector<BIGNUM*> lefts, rights;
+    for (size_t i = 0; i + 1 < datas.size(); i += 2) {
+        lefts.push_back(datas[i]);
+        rights.push_back(datas[i + 1]);
+    }
+    int rounds = 0;
+    if (!lefts.empty()) {
+        vector<bool> greater = compareRound_PHE(lefts, rights);
+        rounds++;
+        for (size_t i = 0; i < greater.size(); i++) {
+            mins.push_back(greater[i] ? 2 * i + 1 : 2 * i);
+            maxs.push_back(greater[i] ? 2 * i : 2 * i + 1);
+        }
+    }
+    if (datas.size() % 2 == 1) {
+        mins.push_back(datas.size() - 1);
+        maxs.push_back(datas.size() - 1);
+    }
+
+    while (mins.size() > 1 || maxs.size() > 1) {
+        // 前minPairs对属于最小值赛区，其余属于最大值赛区
+        size_t minPairs = mins.size() / 2, maxPairs = maxs.size() / 2;
+        lefts.clear();
+        rights.clear();
+        for (size_t i = 0; i < minPairs; i++) {
+            lefts.push_back(datas[mins[2 * i]]);
+            rights.push_back(datas[mins[2 * i + 1]]);
+        }
+        for (size_t i = 0; i < maxPairs; i++) {
+            lefts.push_back(datas[maxs[2 * i]]);
+            rights.push_back(datas[maxs[2 * i + 1]]);
+        }
+        vector<bool> greater = compareRound_PHE(lefts, rights);
+        rounds++;
+
+        vector<size_t> nextMins, nextMaxs;
+        for (size_t i = 0; i < minPairs; i++) {
+            nextMins.push_back(greater[i] ? mins[2 * i + 1] : mins[2 * i]);
+        }
+        if (mins.size() % 2 == 1) {
+            nextMins.push_back(mins.back());
+        }
+        for (size_t i = 0; i < maxPairs; i++) {
+            nextMaxs.push_back(greater[minPairs + i] ? maxs[2 * i] : maxs[2 * i + 1]);
+        }
+        if (maxs.size() % 2 == 1) {
+            nextMaxs.push_back(maxs.back());
+        }
+        mins.swap(nextMins);
+        maxs.swap(nextMaxs);
+    }
+
+    BN_copy(min, datas[mins[0]]);
+    BN_copy(max, datas[maxs[0]]);
+    return rounds;
+}
+
 /**
  *@Method 相等性测试
  *@param BIGNUM* x1 第一个数据
@@ -394,20 +732,16 @@ bool equal_PHE(BIGNUM* x1, BIGNUM* x2) {
     BN_set_negative(x1_neg, 1);
     x1_neg = encrypt_PHE(x1_neg, do1->get_pk());
 
-    BIGNUM* x1_square = BN_CTX_get(CTX);
-    BN_mul(x1_square, x1, x1, CTX);
+    BIGNUM* x1_square = square_native(x1);
     x1_square = encrypt_PHE(x1_square, do1->get_pk());
 
     // 用户2计算r1 * (x1_square + 2 * x2 * x1_neg + x2_square) - r2
 
-    BIGNUM* x2_square = BN_CTX_get(CTX);
-    BN_mul(x2_square, x2, x2, CTX);
+    BIGNUM* x2_square = square_native(x2);
 
     // 生成两个k_M比特的随机数r1, r2
-    BIGNUM* r1 = BN_CTX_get(CTX);
-    BIGNUM* r2= BN_CTX_get(CTX);
-    r1 = generateRandom(k_M);
-    r2 = generateRandom(k_M);
+    BIGNUM* r1 = generateRandom(k_M);
+    BIGNUM* r2 = generateRandom(k_M);
 
     // 要保证r1 > r2 > 0
     while (BN_cmp(r1, r2) != 1) {
@@ -416,16 +750,16 @@ bool equal_PHE(BIGNUM* x1, BIGNUM* x2) {
     }
 
     //创建临时变量t
-    BIGNUM* t = BN_CTX_get(CTX);
+    BIGNUM* t = BN_new();
     BN_set_word(t, 2);
 
     // 创建临时变量res
-    BIGNUM* res = BN_CTX_get(CTX);
-    BN_mul(res, t, x2, CTX);
-    BN_mul(res, res, x1_neg, CTX);
+    BIGNUM* res = BN_new();
+    BN_mul(res, t, x2, localCTX());
+    BN_mul(res, res, x1_neg, localCTX());
     BN_add(res, res, x1_square);
     BN_add(res, res, x2_square);
-    BN_mul(res, res, r1,CTX);
+    BN_mul(res, res, r1, localCTX());
     BN_sub(res, res, r2);
 
     // 用户2将res发给用户1并解密
@@ -450,59 +784,352 @@ bool equal_PHE(BIGNUM* x1, BIGNUM* x2) {
 }
 
 /**
- *@Method 求最小值
- *@param vector<BIGNUM*> datas N个数据拥有者持有的数据集
- *@param int left 数据集的左边界
- *@param int right 数据集的右边界
- *@return BIGNUM* min 最小值
+ *@Method 用户1加密相等性测试和包含关系测试所需的(-x)和(x^2)
+ *@param BIGNUM* x 用户DO1持有的数据
+ *@param BIGNUM** E_x_neg [-x]
+ *@param BIGNUM** E_x_square [x^2]
+ *@return void
+ */
+static void encryptPointOperand(const BIGNUM* x, BIGNUM** E_x_neg, BIGNUM** E_x_square) {
+    BIGNUM* x_neg = BN_dup(x);
+    BN_set_negative(x_neg, !BN_is_negative(x));
+    *E_x_neg = encrypt_PHE(x_neg, pk);
+    BN_free(x_neg);
+
+    BIGNUM* x_square = square_native(x);
+    *E_x_square = encrypt_PHE(x_square, pk);
+    BN_free(x_square);
+}
+
+// 一块中同时计算的数据对个数，限制混淆结果密文占用的内存
+static const size_t MASKED_ROUND_BLOCK = 4096;
+
+/**
+ *@Method 用已有的密钥进行一轮批量的混淆符号测试
+ *用户2对第k对数据用polynomial计算多项式的密文[v]，再用独立的(r1, r2)混淆为r1 * [v] - r2一次发回，
+ *用户1批量解密。r1 > r2 > 0，因此混淆结果为负当且仅当v <= 0。数据对分块计算，每块解密后释放
+ *@param size_t pairs 数据对个数
+ *@param function<void(size_t,BIGNUM*,BN_CTX*)> polynomial 计算第k对数据的[v]
+ *@return vector<bool> 第k位为true时第k对数据的v <= 0
+ */
+static vector<bool> maskedSignRound_PHE(size_t pairs, const function<void(size_t, BIGNUM*, BN_CTX*)> &polynomial) {
+    vector<bool> result(pairs);
+    for (size_t begin = 0; begin < pairs; begin += MASKED_ROUND_BLOCK) {
+        size_t end = min(pairs, begin + MASKED_ROUND_BLOCK);
+        vector<BIGNUM*> res(end - begin);
+        executor().parallel_for(begin, end, 0, [&](size_t b0, size_t b1) {
+            BN_CTX* ctx = localCTX();
+            BIGNUM* r1 = BN_new();
+            BIGNUM* r2 = BN_new();
+            for (size_t k = b0; k < b1; k++) {
+                randomMaskPair(r1, r2);
+                BIGNUM* v = BN_new();
+                polynomial(k, v, ctx);
+                BN_mul(v, v, r1, ctx);
+                BN_sub(v, v, r2);
+                res[k - begin] = v;
+            }
+            BN_free(r1);
+            BN_free(r2);
+        });
+
+        vector<BIGNUM*> plain = decryptBatch_PHE(res, sk);
+        for (size_t k = 0; k < plain.size(); k++) {
+            result[begin + k] = BN_is_negative(plain[k]);
+            BN_free(plain[k]);
+            BN_free(res[k]);
+        }
+    }
+    return result;
+}
+
+/**
+ *@Method 用已有的密钥进行一轮批量相等性测试，第k对为用户1的第xIndex[k]个数据与ys[k]
+ *@param vector<BIGNUM*> E_x_neg 用户1各数据的[-x]
+ *@param vector<BIGNUM*> E_x_square 用户1各数据的[x^2]
+ *@param vector<size_t> xIndex 每一对中用户1数据的下标
+ *@param vector<BIGNUM*> ys 每一对中用户DO2持有的数据
+ *@return vector<bool> 第k位为true时第k对数据相等
+ */
+static vector<bool> equalRound_PHE(const vector<BIGNUM*> &E_x_neg, const vector<BIGNUM*> &E_x_square,
+                                   const vector<size_t> &xIndex, const vector<BIGNUM*> &ys) {
+    // v = x^2 + 2 * y * (-x) + y^2 = (x - y)^2，v <= 0时两数相等
+    return maskedSignRound_PHE(ys.size(), [&](size_t k, BIGNUM* v, BN_CTX* ctx) {
+        BIGNUM* t = BN_new();
+        BN_lshift1(t, ys[k]);
+        BN_mul(v, t, E_x_neg[xIndex[k]], ctx);
+        BN_add(v, v, E_x_square[xIndex[k]]);
+        BN_sqr(t, ys[k], ctx);
+        BN_add(v, v, t);
+        BN_free(t);
+    });
+}
+
+/**
+ *@Method 一个数据与多个候选数据的相等性测试
+ *用户1只生成一次公私钥，-x和x^2只加密一次，所有候选数据共用；用户2并行计算每个候选数据的混淆结果并一次发回，
+ *用户1批量解密得到匹配向量
+ *@param BIGNUM* x 用户DO1持有的数据
+ *@param vector<BIGNUM*> ys 用户DO2持有的候选数据
+ *@return vector<bool> 第i位为true时x == ys[i]
+ */
+vector<bool> equal_PHE_many(BIGNUM* x, const vector<BIGNUM*> &ys) {
+    // 用户1生成公私钥，将(-x)和(x^2)加密发送给用户2
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+    vector<BIGNUM*> E_x_neg(1), E_x_square(1);
+    encryptPointOperand(x, &E_x_neg[0], &E_x_square[0]);
+
+    vector<bool> result = equalRound_PHE(E_x_neg, E_x_square, vector<size_t>(ys.size(), 0), ys);
+
+    BN_free(E_x_neg[0]);
+    BN_free(E_x_square[0]);
+    return result;
+}
+
+/**
+ *@Method 用双方约定的密钥计算数据的分桶，HMAC-SHA256(key, 符号 || 数据的大端字节)的前8字节对桶数取模
+ *@param string key 双方约定的哈希密钥
+ *@param BIGNUM* x 数据
+ *@param size_t buckets 桶数
+ *@return size_t 桶的编号
+ */
+static size_t keyedBucket(const string &key, const BIGNUM* x, size_t buckets) {
+    vector<unsigned char> bytes(BN_num_bytes(x) + 1);
+    bytes[0] = BN_is_negative(x) ? 1 : 0;
+    BN_bn2bin(x, bytes.data() + 1);
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    HMAC(EVP_sha256(), key.data(), key.size(), bytes.data(), bytes.size(), digest, &length);
+    uint64_t h = 0;
+    for (int i = 0; i < 8; i++) {
+        h = (h << 8) | digest[i];
+    }
+    return h % buckets;
+}
+
+/**
+ *@Method 按桶编号对数据的下标排序，返回每个桶在order中的起始位置
+ *@param vector<size_t> bucket 每个数据的桶编号
+ *@param size_t buckets 桶数
+ *@param vector<size_t> order 按桶排列的数据下标
+ *@return vector<size_t> 第b个桶为order[start[b], start[b + 1])
+ */
+static vector<size_t> groupByBucket(const vector<size_t> &bucket, size_t buckets, vector<size_t> &order) {
+    vector<size_t> start(buckets + 1, 0);
+    for (size_t i = 0; i < bucket.size(); i++) {
+        start[bucket[i] + 1]++;
+    }
+    for (size_t b = 0; b < buckets; b++) {
+        start[b + 1] += start[b];
+    }
+    vector<size_t> next(start.begin(), start.end() - 1);
+    order.resize(bucket.size());
+    for (size_t i = 0; i < bucket.size(); i++) {
+        order[next[bucket[i]]++] = i;
+    }
+    return start;
+}
+
+/**
+ *@Method 分桶的隐私等值连接
+ *双方用约定的带密钥哈希把连接键分到桶中并公开桶编号，只对同一桶内的数据对进行批量密文相等性测试，
+ *桶数与数据量相当时测试次数约为n + m而不是n * m。values非空时，用户1加密每行的附加值，
+ *用户2按匹配结果对密文求和，用户1解密得到DO2每个数据匹配到的附加值之和
+ *@param vector<BIGNUM*> xs 用户DO1持有的连接键
+ *@param vector<BIGNUM*> ys 用户DO2持有的连接键
+ *@param vector<BIGNUM*> values 用户DO1每行的附加值，为空时不求和
+ *@param string hashKey 双方约定的哈希密钥
+ *@param size_t buckets 桶数，为0时取两方数据量的较大者
+ *@return JoinResult 连接结果
  */
-BIGNUM* min_PHE(vector<BIGNUM*> datas, int left, int right) {
-    // 数组只有一个元素时，它就是最小的元素
-    if (left == right) {
-        return BN_dup(datas[left]);
+JoinResult join_PHE(const vector<BIGNUM*> &xs, const vector<BIGNUM*> &ys, const vector<BIGNUM*> &values,
+                    const string &hashKey, size_t buckets) {
+    JoinResult result;
+    result.comparisons = 0;
+    if (!values.empty() && values.size() != xs.size()) {
+        cerr << "Unable to join " << xs.size() << " keys with " << values.size() << " values" << endl;
+        return result;
+    }
+    if (buckets == 0) {
+        buckets = max(max(xs.size(), ys.size()), (size_t) 1);
     }
 
-    // 将数据集分为两半
-    int mid = (left + right) / 2;
+    // 双方各自计算并公开桶编号
+    vector<size_t> xBucket(xs.size()), yBucket(ys.size());
+    executor().parallel_for(0, xs.size(), 0, [&](size_t b0, size_t b1) {
+        for (size_t i = b0; i < b1; i++) {
+            xBucket[i] = keyedBucket(hashKey, xs[i], buckets);
+        }
+    });
+    executor().parallel_for(0, ys.size(), 0, [&](size_t b0, size_t b1) {
+        for (size_t j = b0; j < b1; j++) {
+            yBucket[j] = keyedBucket(hashKey, ys[j], buckets);
+        }
+    });
+
+    // 只有同一桶内的数据需要比较
+    vector<size_t> xOrder;
+    vector<size_t> xStart = groupByBucket(xBucket, buckets, xOrder);
+    vector<size_t> xIndex;
+    vector<size_t> yIndex;
+    vector<BIGNUM*> yPair;
+    vector<bool> needed(xs.size(), false);
+    for (size_t j = 0; j < ys.size(); j++) {
+        for (size_t k = xStart[yBucket[j]]; k < xStart[yBucket[j] + 1]; k++) {
+            xIndex.push_back(xOrder[k]);
+            yIndex.push_back(j);
+            yPair.push_back(ys[j]);
+            needed[xOrder[k]] = true;
+        }
+    }
+    result.comparisons = xIndex.size();
+    if (xIndex.empty()) {
+        // 没有数据对落在同一桶中时不需要比较，DO2每个连接键匹配到的附加值之和都为0
+        if (!values.empty()) {
+            for (size_t j = 0; j < ys.size(); j++) {
+                result.sums.push_back(BN_new());
+            }
+        }
+        return result;
+    }
 
-    // 递归地求左半部分和右半部分的最小值
-    BIGNUM* left_min = min_PHE(datas, left, mid);
-    BIGNUM* right_min = min_PHE(datas, mid + 1, right);
+    // 用户1生成公私钥，只加密至少有一个候选数据的连接键
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+    vector<BIGNUM*> E_x_neg(xs.size(), NULL), E_x_square(xs.size(), NULL);
+    executor().parallel_for(0, xs.size(), 0, [&](size_t b0, size_t b1) {
+        for (size_t i = b0; i < b1; i++) {
+            if (needed[i]) {
+                encryptPointOperand(xs[i], &E_x_neg[i], &E_x_square[i]);
+            }
+        }
+    });
 
-    // 比较左半部分和右半部分的最小值，返回较小的那个
-    if (BN_cmp(left_min, right_min) < 0) {
-       return BN_dup(left_min);
+    vector<bool> equal = equalRound_PHE(E_x_neg, E_x_square, xIndex, yPair);
+    for (size_t k = 0; k < equal.size(); k++) {
+        if (equal[k]) {
+            result.pairs.push_back(make_pair(xIndex[k], yIndex[k]));
+        }
+    }
+    sort(result.pairs.begin(), result.pairs.end());
+
+    if (!values.empty()) {
+        // 用户1加密附加值，用户2把每个数据匹配到的密文相加后发回，用户1解密
+        vector<BIGNUM*> E_values = encryptBatch_PHE(values, pk);
+        vector<BIGNUM*> E_sums(ys.size(), NULL);
+        for (size_t k = 0; k < result.pairs.size(); k++) {
+            size_t i = result.pairs[k].first, j = result.pairs[k].second;
+            if (E_sums[j] == NULL) {
+                E_sums[j] = BN_dup(E_values[i]);
+            } else {
+                BN_add(E_sums[j], E_sums[j], E_values[i]);
+            }
+        }
+        vector<BIGNUM*> matched;
+        for (size_t j = 0; j < ys.size(); j++) {
+            if (E_sums[j] != NULL) {
+                matched.push_back(E_sums[j]);
+            }
+        }
+        vector<BIGNUM*> sums = decryptBatch_PHE(matched, sk);
+        for (size_t j = 0, m = 0; j < ys.size(); j++) {
+            if (E_sums[j] != NULL) {
+                result.sums.push_back(sums[m++]);
+                BN_free(E_sums[j]);
+            } else {
+                result.sums.push_back(BN_new());
+            }
+        }
+        for (size_t i = 0; i < E_values.size(); i++) {
+            BN_free(E_values[i]);
+        }
     }
 
-    return BN_dup(right_min);
+    for (size_t i = 0; i < xs.size(); i++) {
+        BN_free(E_x_neg[i]);
+        BN_free(E_x_square[i]);
+    }
+    return result;
 }
 
 /**
- *@Method 求最大值
+ *@Method 一次遍历同时求最小值和最大值的下标
+ *每块内两两成对比较，较小者与当前最小值比较，较大者与当前最大值比较，每两个数据只需3次比较；
+ *各块并行计算后按块的顺序合并，不复制数据，也不分配中间结果
+ *@param BIGNUM* const* datas 数据集的起始位置
+ *@param size_t n 数据个数
+ *@param size_t* min_index 最小值的下标，有多个时取第一个
+ *@param size_t* max_index 最大值的下标，有多个时取第一个
+ *@return bool 数据集为空时返回false
+ */
+bool minmax_PHE(BIGNUM* const* datas, size_t n, size_t* min_index, size_t* max_index) {
+    if (n == 0) {
+        return false;
+    }
+
+    typedef pair<size_t, size_t> Extremes;
+    Extremes result = executor().parallel_reduce(0, n, 0, Extremes(0, 0), [&](size_t b0, size_t b1) {
+        Extremes e(b0, b0);
+        size_t i = b0 + 1;
+        for (; i + 1 < b1; i += 2) {
+            size_t small = i, large = i + 1;
+            if (BN_cmp(datas[large], datas[small]) < 0) {
+                swap(small, large);
+            }
+            if (BN_cmp(datas[small], datas[e.first]) < 0) {
+                e.first = small;
+            }
+            if (BN_cmp(datas[large], datas[e.second]) > 0) {
+                e.second = large;
+            }
+        }
+        if (i < b1) {
+            if (BN_cmp(datas[i], datas[e.first]) < 0) {
+                e.first = i;
+            }
+            if (BN_cmp(datas[i], datas[e.second]) > 0) {
+                e.second = i;
+            }
+        }
+        return e;
+    }, [&](const Extremes &a, const Extremes &b) {
+        return Extremes(BN_cmp(datas[b.first], datas[a.first]) < 0 ? b.first : a.first,
+                        BN_cmp(datas[b.second], datas[a.second]) > 0 ? b.second : a.second);
+    });
+
+    *min_index = result.first;
+    *max_index = result.second;
+    return true;
+}
+
+/**
+ *@Method 求最小值
  *@param vector<BIGNUM*> datas N个数据拥有者持有的数据集
  *@param int left 数据集的左边界
  *@param int right 数据集的右边界
- *@return BIGNUM* max 最大值
+ *@return BIGNUM* min 最小值，由调用者释放
  */
-BIGNUM* max_PHE(vector<BIGNUM*> datas, int left, int right) {
-    // 数组只有一个元素时，它就是最小的元素
-    if (left == right) {
-        return BN_dup(datas[left]);
+BIGNUM* min_PHE(const vector<BIGNUM*> &datas, int left, int right) {
+    size_t min_index, max_index;
+    if (!minmax_PHE(datas.data() + left, right - left + 1, &min_index, &max_index)) {
+        return NULL;
     }
+    return BN_dup(datas[left + min_index]);
+}
 
-    // 将数据集分为两半
-    int mid = (left + right) / 2;
-
-    // 递归地求左半部分和右半部分的最小值
-    BIGNUM* left_max = max_PHE(datas, left, mid);
-    BIGNUM* right_max = max_PHE(datas, mid + 1, right);
-
-    // 比较左半部分和右半部分的最大值，返回较大的那个
-    if (BN_cmp(left_max, right_max) > 0) {
-        return BN_dup(left_max);
+/**
+ *@Method 求最大值
+ *@param vector<BIGNUM*> datas N个数据拥有者持有的数据集
+ *@param int left 数据集的左边界
+ *@param int right 数据集的右边界
+ *@return BIGNUM* max 最大值，由调用者释放
+ */
+BIGNUM* max_PHE(const vector<BIGNUM*> &datas, int left, int right) {
+    size_t min_index, max_index;
+    if (!minmax_PHE(datas.data() + left, right - left + 1, &min_index, &max_index)) {
+        return NULL;
     }
-
-    return BN_dup(right_max);;
+    return BN_dup(datas[left + max_index]);
 }
 
 /*
@@ -531,17 +1158,14 @@ bool include_PHE(BIGNUM* x, BIGNUM* y1, BIGNUM* y2) {
     BN_set_negative(x_neg, 1);
     x_neg = encrypt_PHE(x_neg, do1->get_pk());
 
-    BIGNUM* x_square = BN_CTX_get(CTX);
-    BN_mul(x_square, x, x, CTX);
+    BIGNUM* x_square = square_native(x);
     x_square = encrypt_PHE(x_square, do1->get_pk());
 
     // 用户2计算r1 * (x_square + x_neg * (y1 + y2) + y1 * y2) - r2
 
     // 生成两个k_M比特的随机数r1, r2
-    BIGNUM* r1 = BN_CTX_get(CTX);
-    BIGNUM* r2= BN_CTX_get(CTX);
-    r1 = generateRandom(k_M);
-    r2 = generateRandom(k_M);
+    BIGNUM* r1 = generateRandom(k_M);
+    BIGNUM* r2 = generateRandom(k_M);
 
     // 要保证r1 > r2 > 0
     while (BN_cmp(r1, r2) != 1) {
@@ -550,16 +1174,16 @@ bool include_PHE(BIGNUM* x, BIGNUM* y1, BIGNUM* y2) {
     }
 
     // 定义临时变量t1
-    BIGNUM* t1 = BN_CTX_get(CTX);
+    BIGNUM* t1 = BN_new();
     // t1 = y1 + y2
     BN_add(t1, y1, y2);
     // t1 = x_neg * (y1 + y2)
-    BN_mul(t1, x_neg, t1, CTX);
+    BN_mul(t1, x_neg, t1, localCTX());
 
     // 定义临时变量t2
-    BIGNUM* t2 = BN_CTX_get(CTX);
+    BIGNUM* t2 = BN_new();
     // t2 = y1 * y2
-    BN_mul(t2, y1, y2, CTX);
+    BN_mul(t2, y1, y2, localCTX());
 
     // t1 = x_square + x_neg * (y1 + y2)
     BN_add(t1, x_square, t1);
@@ -568,7 +1192,7 @@ bool include_PHE(BIGNUM* x, BIGNUM* y1, BIGNUM* y2) {
     BN_add(t1, t1, t2);
 
     // t1 = r1 * (x_square + x_neg * (y1 + y2) + y1 * y2)
-    BN_mul(t1, t1, r1, CTX);
+    BN_mul(t1, t1, r1, localCTX());
 
     // t1 = r1 * (x_square + x_neg * (y1 + y2) + y1 * y2) - r2
     BN_sub(t1, t1, r2);
@@ -596,6 +1220,69 @@ bool include_PHE(BIGNUM* x, BIGNUM* y1, BIGNUM* y2) {
     return false;
 }
 
+/**
+ *@Method 批量包含关系测试，用户1的每个点与用户2的每个区间两两测试
+ *用户1只生成一次公私钥，每个点的(-x)和(x^2)只加密一次，所有区间共用；用户2在线程池中计算所有(点, 区间)的混淆多项式，
+ *作为一个混淆矩阵发回，用户1批量解密
+ *@param vector<BIGNUM*> xs 用户DO1持有的点
+ *@param vector<BIGNUM*> y1s 用户DO2持有的区间下界
+ *@param vector<BIGNUM*> y2s 用户DO2持有的区间上界，与y1s按下标一一对应
+ *@return vector<vector<bool>> 第i行第j列与include_PHE(xs[i], y1s[j], y2s[j])相同，true:不在区间内;false:在区间内，
+ *y1s与y2s长度不同时为空
+ */
+vector<vector<bool>> include_PHE_batch(const vector<BIGNUM*> &xs, const vector<BIGNUM*> &y1s, const vector<BIGNUM*> &y2s) {
+    vector<vector<bool>> result;
+    if (y1s.size() != y2s.size()) {
+        cerr << "Unable to test " << y1s.size() << " lower bounds with " << y2s.size() << " upper bounds" << endl;
+        return result;
+    }
+
+    // 用户1生成公私钥，将每个点的(-x)和(x^2)加密发送给用户2
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+    vector<BIGNUM*> E_x_neg(xs.size()), E_x_square(xs.size());
+    executor().parallel_for(0, xs.size(), 0, [&](size_t b0, size_t b1) {
+        for (size_t i = b0; i < b1; i++) {
+            encryptPointOperand(xs[i], &E_x_neg[i], &E_x_square[i]);
+        }
+    });
+
+    // 用户2预先计算每个区间的y1 + y2和y1 * y2
+    size_t m = y1s.size();
+    vector<BIGNUM*> sum(m), product(m);
+    executor().parallel_for(0, m, 0, [&](size_t b0, size_t b1) {
+        for (size_t j = b0; j < b1; j++) {
+            sum[j] = BN_new();
+            BN_add(sum[j], y1s[j], y2s[j]);
+            product[j] = BN_new();
+            BN_mul(product[j], y1s[j], y2s[j], localCTX());
+        }
+    });
+
+    // 第k对为第k / m个点与第k % m个区间，v = x^2 + (y1 + y2) * (-x) + y1 * y2 = (x - y1) * (x - y2)，
+    // v <= 0时点在区间内
+    vector<bool> inside = maskedSignRound_PHE(xs.size() * m, [&](size_t k, BIGNUM* v, BN_CTX* ctx) {
+        size_t i = k / m, j = k % m;
+        BN_mul(v, sum[j], E_x_neg[i], ctx);
+        BN_add(v, v, E_x_square[i]);
+        BN_add(v, v, product[j]);
+    });
+
+    result.assign(xs.size(), vector<bool>(m));
+    for (size_t k = 0; k < inside.size(); k++) {
+        result[k / m][k % m] = !inside[k];
+    }
+
+    for (size_t i = 0; i < xs.size(); i++) {
+        BN_free(E_x_neg[i]);
+        BN_free(E_x_square[i]);
+    }
+    for (size_t j = 0; j < m; j++) {
+        BN_free(sum[j]);
+        BN_free(product[j]);
+    }
+    return result;
+}
+
 /*
  *@Method 范围相交测试
  *@param BIGNUM* x1 用户DO1持有的数据
@@ -605,6 +1292,95 @@ bool include_PHE(BIGNUM* x, BIGNUM* y1, BIGNUM* y2) {
  *@return bool true:范围相交; false:范围不相交
  */
 bool intersect_PHE(BIGNUM* x1, BIGNUM* x2, BIGNUM* y1, BIGNUM* y2) {
+    // 与批量测试使用同一协议：用户1加密(-x1)、(-x2)和(x1 * x2)发送给用户2，
+    // 用户2计算y2 * [-x2] + y1 * [-x1] + [x1 * x2] + y1 * y2并用r1、r2混淆，用户1解密后判断符号
+    vector<vector<bool>> result = intersect_PHE_batch(vector<BIGNUM*>(1, x1), vector<BIGNUM*>(1, x2),
+                                                      vector<BIGNUM*>(1, y1), vector<BIGNUM*>(1, y2));
+    return result[0][0];
+}
+
+/**
+ *@Method 批量范围相交测试，用户1的每个范围与用户2的每个范围两两测试
+ *用户1只生成一次公私钥，每个范围的(-x1)、(-x2)和(x1 * x2)只加密一次，所有对方范围共用；
+ *用户2在线程池中计算所有范围对的混淆多项式，用户1批量解密
+ *@param vector<BIGNUM*> x1s 用户DO1持有的范围下界
+ *@param vector<BIGNUM*> x2s 用户DO1持有的范围上界，与x1s按下标一一对应
+ *@param vector<BIGNUM*> y1s 用户DO2持有的范围下界
+ *@param vector<BIGNUM*> y2s 用户DO2持有的范围上界，与y1s按下标一一对应
+ *@return vector<vector<bool>> 第i行第j列为true时[x1s[i], x2s[i]]与[y1s[j], y2s[j]]相交，边界长度不匹配时为空
+ */
+vector<vector<bool>> intersect_PHE_batch(const vector<BIGNUM*> &x1s, const vector<BIGNUM*> &x2s,
+                                         const vector<BIGNUM*> &y1s, const vector<BIGNUM*> &y2s) {
+    vector<vector<bool>> result;
+    if (x1s.size() != x2s.size() || y1s.size() != y2s.size()) {
+        cerr << "Unable to pair lower bounds with upper bounds of different lengths" << endl;
+        return result;
+    }
+
+    // 用户1生成公私钥，将每个范围的(-x1)、(-x2)和(x1 * x2)加密发送给用户2
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+    size_t n = x1s.size(), m = y1s.size();
+    vector<BIGNUM*> E_x1_neg(n), E_x2_neg(n), E_x1_mul_x2(n);
+    executor().parallel_for(0, n, 0, [&](size_t b0, size_t b1) {
+        BIGNUM* t = BN_new();
+        for (size_t i = b0; i < b1; i++) {
+            BN_copy(t, x1s[i]);
+            BN_set_negative(t, !BN_is_negative(x1s[i]));
+            E_x1_neg[i] = encrypt_PHE(t, pk);
+            BN_copy(t, x2s[i]);
+            BN_set_negative(t, !BN_is_negative(x2s[i]));
+            E_x2_neg[i] = encrypt_PHE(t, pk);
+            BN_mul(t, x1s[i], x2s[i], localCTX());
+            E_x1_mul_x2[i] = encrypt_PHE(t, pk);
+        }
+        BN_free(t);
+    });
+
+    // 用户2预先计算每个范围的y1 * y2
+    vector<BIGNUM*> product(m);
+    executor().parallel_for(0, m, 0, [&](size_t b0, size_t b1) {
+        for (size_t j = b0; j < b1; j++) {
+            product[j] = BN_new();
+            BN_mul(product[j], y1s[j], y2s[j], localCTX());
+        }
+    });
+
+    // 第k对为用户1的第k / m个范围与用户2的第k % m个范围，
+    // v = x1 * x2 + y2 * (-x2) + y1 * (-x1) + y1 * y2 = (x1 - y2) * (x2 - y1)，v <= 0时两个范围相交
+    vector<bool> overlap = maskedSignRound_PHE(n * m, [&](size_t k, BIGNUM* v, BN_CTX* ctx) {
+        size_t i = k / m, j = k % m;
+        BIGNUM* t = BN_new();
+        BN_mul(v, y2s[j], E_x2_neg[i], ctx);
+        BN_mul(t, y1s[j], E_x1_neg[i], ctx);
+        BN_add(v, v, t);
+        BN_add(v, v, E_x1_mul_x2[i]);
+        BN_add(v, v, product[j]);
+        BN_free(t);
+    });
+
+    result.assign(n, vector<bool>(m));
+    for (size_t k = 0; k < overlap.size(); k++) {
+        result[k / m][k % m] = overlap[k];
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        BN_free(E_x1_neg[i]);
+        BN_free(E_x2_neg[i]);
+        BN_free(E_x1_mul_x2[i]);
+    }
+    for (size_t j = 0; j < m; j++) {
+        BN_free(product[j]);
+    }
+    return result;
+}
+
+/*
+ *@Method 求内积
+ *@param vector<BIGNUM*> x1 用户DO1持有的数据
+ *@param vector<BIGNUM*> y1 用户DO2持有的数据
+ *@return BIGNUM* inner_product 内积
+ */
+BIGNUM* inner_product_PHE(vector<BIGNUM*> x1, vector<BIGNUM*> y1) {
     // 创建用户1和用户2
     DO* do1 = new DO(NULL, NULL, NULL);
     DO* do2 = new DO(NULL, NULL, NULL);
@@ -618,133 +1394,219 @@ bool intersect_PHE(BIGNUM* x1, BIGNUM* x2, BIGNUM* y1, BIGNUM* y2) {
     // 用户1将公钥发送给用户2
     do2->set_pk(do1->get_pk());
 
-    // 用户1将x1、x2和(x1 * x2)加密发送给用户2
-    BIGNUM* E_x1 = BN_CTX_get(CTX);
-    E_x1 = encrypt_PHE(x1, do1->get_pk());
+    // 用户1将持有的数据加密发送给用户2
+    executor().parallel_for(0, x1.size(), 0, [&](size_t b0, size_t b1) {
+        for (size_t i = b0; i < b1; i++) {
+            x1[i] = encrypt_PHE(x1[i], do1->get_pk());
+        }
+    });
+
+    // 用户2计算内积，各块的部分和按块的顺序合并
+    BIGNUM* zero = BN_new();
+    BN_zero(zero);
+    BIGNUM* inner_product = executor().parallel_reduce((size_t) 0, x1.size(), 0, zero, [&](size_t b0, size_t b1) {
+        BIGNUM* part = BN_new();
+        BN_zero(part);
+        // 定义临时变量t
+        BIGNUM* t = BN_new();
+        for (size_t i = b0; i < b1; i++) {
+            // part += x1[i] * y1[i]
+            mulAddBIGNUM(part, x1[i], y1[i], t, localCTX());
+        }
+        BN_free(t);
+        return part;
+    }, addBIGNUM);
 
-    BIGNUM* E_x2 = BN_CTX_get(CTX);
-    E_x2 = encrypt_PHE(x2, do1->get_pk());
+    // 用户1接收 inner_product并解密
+    BIGNUM* result = decrypt_PHE(inner_product, do1->get_sk());
 
-    BIGNUM* E_x1_mul_x2 = BN_CTX_get(CTX);
-    BN_mul(E_x1_mul_x2, x1, x2, CTX);
-    E_x1_mul_x2 = encrypt_PHE(E_x1_mul_x2, do1->get_pk());
+    // 释放临时变量
+    BN_free(inner_product);
 
-    // 用户2计算r1 * (x2 * x1 - x2 * y2 - x1 * y1 + y1 * y2) - r2
+    return result;
+}
 
-    // 生成两个k_M比特的随机数r1, r2
-    BIGNUM* r1 = BN_CTX_get(CTX);
-    BIGNUM* r2= BN_CTX_get(CTX);
-    r1 = generateRandom(k_M);
-    r2 = generateRandom(k_M);
+// 矩阵向量乘法每个任务计算的行数，以及每次遍历的密文个数，使一块密文在多行之间复用时留在缓存中
+static const size_t MATVEC_ROW_BLOCK = 8;
+static const size_t MATVEC_COL_BLOCK = 64;
 
-    // 要保证r1 > r2 > 0
-    while (BN_cmp(r1, r2) != 1) {
-        r1 = generateRandom(k_M);
-        r2 = generateRandom(k_M);
+/**
+ *@Method 计算W的第r0到r1 - 1行与[x]的内积，按列分块，一块密文依次与各行的权重乘加
+ *@param BIGNUM* const* E_x 加密后的向量[x]
+ *@param size_t n 向量的长度
+ *@param vector<vector<BIGNUM*>> W 权重矩阵，每行长度为n
+ *@param size_t r0 起始行
+ *@param size_t r1 结束行（不含）
+ *@param BIGNUM** out 第r行的结果写入out[r - r0]
+ *@param BIGNUM* t 临时变量
+ *@param BN_CTX* ctx 上下文
+ *@return void
+ */
+static void dotRows_PHE(BIGNUM* const* E_x, size_t n, const vector<vector<BIGNUM*>> &W, size_t r0, size_t r1,
+                        BIGNUM** out, BIGNUM* t, BN_CTX* ctx) {
+    for (size_t r = r0; r < r1; r++) {
+        out[r - r0] = BN_new();
     }
-
-    // 定义临时变量t1
-    BIGNUM* t1 = BN_CTX_get(CTX);
-    // t1 = x2 * y2
-    BN_mul(t1, x2, y2, CTX);
-
-    // 定义临时变量t2
-    BIGNUM* t2 = BN_CTX_get(CTX);
-    // t2 = x1 * y1
-    BN_mul(t2, x1, y1, CTX);
-
-    // 定义临时变量t3
-    BIGNUM* t3 = BN_CTX_get(CTX);
-    // t3 = y1 * y2
-    BN_mul(t3, y1, y2, CTX);
-
-    // t1 = x2 * x1 - x2 * y2
-    BN_sub(t1, E_x1_mul_x2, t1);
-
-    // t1 = x2 * x1 - x2 * y2 - x1 * y1
-    BN_sub(t1, t1, t2);
-
-    // t1 = x2 * x1 - x2 * y2 - x1 * y1 + y1 * y2
-    BN_add(t1, t1, t3);
-
-    // t1 = r1 * (x2 * x1 - x2 * y2 - x1 * y1 + y1 * y2)
-    BN_mul(t1, t1, r1, CTX);
-
-    // t1 = r1 * (x2 * x1 - x2 * y2 - x1 * y1 + y1 * y2) - r2
-    BN_sub(t1, t1, r2);
-
-    // 用户D01接收t1并解密
-    t1 = decrypt_PHE(t1, do1->get_sk());
-
-    // 释放临时变量
-    BN_free(r1);
-    BN_free(r2);
-    BN_free(E_x1);
-    BN_free(E_x2);
-    BN_free(E_x1_mul_x2);
-    BN_free(t3);
-
-    BN_zero(t2);
-    if (BN_cmp(t1, t2) == 1) {
-        // 释放临时变量
-        BN_free(t1);
-        BN_free(t2);
-        return false;
+    for (size_t c0 = 0; c0 < n; c0 += MATVEC_COL_BLOCK) {
+        size_t c1 = min(n, c0 + MATVEC_COL_BLOCK);
+        for (size_t r = r0; r < r1; r++) {
+            for (size_t c = c0; c < c1; c++) {
+                mulAddBIGNUM(out[r - r0], E_x[c], W[r][c], t, ctx);
+            }
+        }
     }
-
-    // 释放临时变量
-    BN_free(t1);
-    BN_free(t2);
-    return true;
 }
 
 /*
- *@Method 求内积
- *@param vector<BIGNUM*> x1 用户DO1持有的数据
- *@param vector<BIGNUM*> y1 用户DO2持有的数据
- *@return BIGNUM* inner_product 内积
+ *@Method 密文向量与明文矩阵的乘法
+ *用户1用encryptBatch_PHE加密一次向量x，用户2计算W的每一行与[x]的内积。按行分块并行，
+ *每块内再按列分块，一块密文依次与块内各行的权重乘加
+ *@param vector<BIGNUM*> E_x 用户DO1加密后的向量[x]
+ *@param vector<vector<BIGNUM*>> W 用户DO2持有的权重矩阵，每行长度与E_x相同
+ *@param bool decrypt 为true时由用户1批量解密，返回明文
+ *@return vector<BIGNUM*> 第r个元素为W[r]与x的内积（decrypt为false时为其密文），W的行长度不匹配时为空
  */
-BIGNUM* inner_product_PHE(vector<BIGNUM*> x1, vector<BIGNUM*> y1) {
-    // 创建用户1和用户2
-    DO* do1 = new DO(NULL, NULL, NULL);
-    DO* do2 = new DO(NULL, NULL, NULL);
+vector<BIGNUM*> matvec_PHE(const vector<BIGNUM*> &E_x, const vector<vector<BIGNUM*>> &W, bool decrypt) {
+    vector<BIGNUM*> result;
+    for (size_t r = 0; r < W.size(); r++) {
+        if (W[r].size() != E_x.size()) {
+            cerr << "Unable to multiply a row of " << W[r].size() << " weights with " << E_x.size() << " values" << endl;
+            return result;
+        }
+    }
 
-    // 用户1生成公私钥
-    InitKeys_PHE(20, 80, 80, 1024, 96448);
+    result.resize(W.size());
+    size_t blocks = (W.size() + MATVEC_ROW_BLOCK - 1) / MATVEC_ROW_BLOCK;
+    executor().parallel_for(0, blocks, 1, [&](size_t b0, size_t b1) {
+        BIGNUM* t = BN_new();
+        for (size_t b = b0; b < b1; b++) {
+            size_t r0 = b * MATVEC_ROW_BLOCK, r1 = min(W.size(), r0 + MATVEC_ROW_BLOCK);
+            dotRows_PHE(E_x.data(), E_x.size(), W, r0, r1, &result[r0], t, localCTX());
+        }
+        BN_free(t);
+    });
 
-    do1->set_pk(pk);
-    do1->set_sk(sk);
+    if (decrypt) {
+        vector<BIGNUM*> plain = decryptBatch_PHE(result, sk);
+        for (size_t r = 0; r < result.size(); r++) {
+            BN_free(result[r]);
+        }
+        return plain;
+    }
+    return result;
+}
 
-    // 用户1将公钥发送给用户2
-    do2->set_pk(do1->get_pk());
+// 矩阵乘法每次加密的X的行数，限制同时存在的密文个数
+static const size_t MATMUL_ROW_BLOCK = 64;
 
-    // 用户1将持有的数据加密发送给用户2
-    for (int i = 0; i < x1.size(); i++) {
-        x1[i] = encrypt_PHE(x1[i], do1->get_pk());
+/*
+ *@Method 双方的矩阵乘法X * Y
+ *用户1只生成一次公私钥，X按行分块流式处理：每块加密一次，用户2在线程池中按(行, 列块)计算该块与Y各列的内积，
+ *用户1批量解密后释放该块的密文，因此同时存在的密文只有一块
+ *@param vector<vector<BIGNUM*>> X 用户DO1持有的r * k矩阵
+ *@param vector<vector<BIGNUM*>> Y 用户DO2持有的k * c矩阵
+ *@return vector<vector<BIGNUM*>> r * c的乘积，矩阵形状不匹配时为空
+ */
+vector<vector<BIGNUM*>> matmul_PHE(const vector<vector<BIGNUM*>> &X, const vector<vector<BIGNUM*>> &Y) {
+    vector<vector<BIGNUM*>> result;
+    size_t k = Y.size(), c = Y.empty() ? 0 : Y[0].size();
+    for (size_t i = 0; i < X.size(); i++) {
+        if (X[i].size() != k) {
+            cerr << "Unable to multiply a row of " << X[i].size() << " values with " << k << " rows" << endl;
+            return result;
+        }
+    }
+    for (size_t t = 0; t < k; t++) {
+        if (Y[t].size() != c) {
+            cerr << "Unable to multiply a matrix with rows of different lengths" << endl;
+            return result;
+        }
     }
 
-    // 用户2计算内积
-    BIGNUM* inner_product = BN_CTX_get(CTX);
-    BN_zero(inner_product);
-
-    // 定义临时变量t
-    BIGNUM* t = BN_CTX_get(CTX);
+    // 用户2按列存放Y，使每列与一行密文的内积顺序访问
+    vector<vector<BIGNUM*>> Yt(c, vector<BIGNUM*>(k));
+    for (size_t t = 0; t < k; t++) {
+        for (size_t j = 0; j < c; j++) {
+            Yt[j][t] = Y[t][j];
+        }
+    }
 
-    for (int i= 0; i < x1.size(); i++) {
-        // t = x1[i] * y1[i]
-        BN_mul(t, x1[i], y1[i], CTX);
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+    result.resize(X.size());
+    size_t columnBlocks = (c + MATVEC_ROW_BLOCK - 1) / MATVEC_ROW_BLOCK;
+    for (size_t i0 = 0; i0 < X.size(); i0 += MATMUL_ROW_BLOCK) {
+        size_t i1 = min(X.size(), i0 + MATMUL_ROW_BLOCK);
+
+        // 用户1加密这一块的行
+        vector<BIGNUM*> rows;
+        for (size_t i = i0; i < i1; i++) {
+            rows.insert(rows.end(), X[i].begin(), X[i].end());
+        }
+        vector<BIGNUM*> E_rows = encryptBatch_PHE(rows, pk);
+
+        // 用户2按(行, 列块)并行计算内积
+        vector<BIGNUM*> E_result((i1 - i0) * c);
+        executor().parallel_for(0, (i1 - i0) * columnBlocks, 1, [&](size_t b0, size_t b1) {
+            BIGNUM* t = BN_new();
+            for (size_t b = b0; b < b1; b++) {
+                size_t i = b / columnBlocks;
+                size_t j0 = b % columnBlocks * MATVEC_ROW_BLOCK, j1 = min(c, j0 + MATVEC_ROW_BLOCK);
+                dotRows_PHE(E_rows.data() + i * k, k, Yt, j0, j1, &E_result[i * c + j0], t, localCTX());
+            }
+            BN_free(t);
+        });
 
-        // inner_product += t
-        BN_add(inner_product, inner_product, t);
+        // 用户1批量解密这一块的结果
+        vector<BIGNUM*> plain = decryptBatch_PHE(E_result, sk);
+        for (size_t i = i0; i < i1; i++) {
+            result[i].assign(plain.begin() + (i - i0) * c, plain.begin() + (i - i0 + 1) * c);
+        }
+        for (size_t e = 0; e < E_rows.size(); e++) {
+            BN_free(E_rows[e]);
+        }
+        for (size_t e = 0; e < E_result.size(); e++) {
+            BN_free(E_result[e]);
+        }
     }
+    return result;
+}
 
-    // 用户1接收 inner_product并解密
-    inner_product = decrypt_PHE(inner_product, do1->get_sk());
-
-    // 释放临时变量
-    BN_free(t);
+/**
+ *@Method 用户1构造计算欧氏距离的增广向量(1, -2 * x[0], ..., -2 * x[n - 1], x[0]^2 + ... + x[n - 1]^2)，
+ *与用户2的(y[0]^2 + ... + y[n - 1]^2, y[0], ..., y[n - 1], 1)的内积即为距离的平方
+ *@param vector<BIGNUM*> x1 用户DO1持有的数据
+ *@param vector<BIGNUM*> x2 增广向量，长度为x1.size() + 2
+ *@return void
+ */
+static void augmentQuery_PHE(const vector<BIGNUM*> &x1, vector<BIGNUM*> &x2) {
+    x2[0] = BN_new();
+    BN_one(x2[0]);
+
+    // 数据都能放入int64且计算不溢出时使用原生整数运算
+    vector<int64_t> x_native;
+    vector<int64_t> x_scaled(x1.size());
+    __int128 x_sum;
+    if (toNative(x1, x_native)
+        && scale_native(x_native.data(), x_native.size(), -2, x_scaled.data())
+        && sumSquares_native(x_native.data(), x_native.size(), &x_sum)) {
+        for (size_t i = 0; i < x1.size(); i++) {
+            x2[i + 1] = int128_to_BN(x_scaled[i]);
+        }
+        x2[x1.size() + 1] = int128_to_BN(x_sum);
+    } else {
+        executor().parallel_for(0, x1.size(), 0, [&](size_t b0, size_t b1) {
+            for (size_t i = b0; i < b1; i++) {
+                // 计算-2 * x1[i]
+                x2[i + 1] = BN_new();
+                BN_lshift1(x2[i + 1], x1[i]);
+                // 设置负号
+                BN_set_negative(x2[i + 1], !BN_is_negative(x1[i]));
+            }
+        });
 
-    return inner_product;
+        // x2[x1.size() + 1] = x1[0]^2 + ... + x1[n - 1]^2
+        x2[x1.size() + 1] = sumSquares_PHE(x1);
+    }
 }
 
 /*
@@ -759,85 +1621,131 @@ BIGNUM* distance_PHE(vector<BIGNUM*> x1, vector<BIGNUM*> y1) {
     // 用户2构造向量
     vector<BIGNUM*> y2(y1.size() + 2);
 
-    // 用户1计算向量
-    //定义临时变量t
-    BIGNUM* t = BN_CTX_get(CTX);
-    BN_one(t);
-    x2[0] = BN_dup(t);
-
-    // 定义临时变量t2
-    BIGNUM* t2 = BN_CTX_get(CTX);
-    BN_zero(t2);
-
-    for (int i = 0; i < x1.size(); i++) {
-        // 计算-2 * x1[i]
-        BN_set_word(t, 2);
-        // 设置负号
-        BN_set_negative(t, 1);
-        BN_mul(t, t, x1[i], CTX);
-        x2[i + 1] = BN_dup(t);
-
-        // 计算x1[i] * x1[i]
-        BN_mul(t, x1[i], x1[i], CTX);
-        // t2 += t
-        BN_add(t2, t2, t);
-    }
+    // 用户1和用户2分别构造向量，两者互不依赖，可以同时计算
+    TaskGraph graph(executor());
+    int prepareX = graph.add([&] {
+        // 用户1计算向量
+        augmentQuery_PHE(x1, x2);
+    });
+    int prepareY = graph.add([&] {
+        // 用户2计算向量
+        y2[y1.size() + 1] = BN_new();
+        BN_one(y2[y1.size() + 1]);
+
+        for (int i = 0; i < y1.size(); i++) {
+            y2[i + 1] = BN_dup(y1[i]);
+        }
 
-    // x2[x1.size() + 1] = t2
-    x2[x1.size() + 1] = BN_dup(t2);
+        vector<int64_t> y_native;
+        __int128 y_sum;
+        if (toNative(y1, y_native) && sumSquares_native(y_native.data(), y_native.size(), &y_sum)) {
+            y2[0] = int128_to_BN(y_sum);
+        } else {
+            // y2[0] = y1[0]^2 + ... + y1[n - 1]^2
+            y2[0] = sumSquares_PHE(y1);
+        }
+    });
 
-    // 用户2计算向量
-    BN_one(t);
-    y2[y1.size() + 1] = BN_dup(t);
-    BN_zero(t2);
+    // 使用内积计算欧式距离
+    BIGNUM* distance = NULL;
+    int product = graph.add([&] {
+        distance = inner_product_PHE(x2, y2);
+    }, {prepareX, prepareY});
 
-    for (int i = 0; i < y1.size(); i++) {
-        y2[i + 1] = BN_dup(y1[i]);
+    // 求算数平方根
+    graph.add([&] {
+        BIGNUM* square = distance;
+        distance = BN_sqrt(square);
+        BN_free(square);
+    }, {product});
 
-        // 计算y1[i] * y1[i]
-        BN_mul(t, y1[i], y1[i], CTX);
+    graph.run();
+    return distance;
+}
 
-        // t2 += t
-        BN_add(t2, t2, t);
+/*
+ *@Method 一个查询向量与数据库中每一行的欧氏距离
+ *查询的增广向量只加密一次，用户2为每一行构造增广向量后用matvec_PHE并行计算所有内积，用户1批量解密。
+ *只需要排序时返回距离的平方，省去开方
+ *@param vector<BIGNUM*> x 用户DO1持有的查询向量
+ *@param vector<vector<BIGNUM*>> ys 用户DO2持有的数据库，每行长度与x相同
+ *@param bool squared 为true时返回距离的平方，否则返回向上取整的距离
+ *@return vector<BIGNUM*> 第j个元素为x与ys[j]的距离，行长度不匹配时为空
+ */
+vector<BIGNUM*> distance_scan_PHE(const vector<BIGNUM*> &x, const vector<vector<BIGNUM*>> &ys, bool squared) {
+    vector<BIGNUM*> result;
+    for (size_t j = 0; j < ys.size(); j++) {
+        if (ys[j].size() != x.size()) {
+            cerr << "Unable to measure a row of " << ys[j].size() << " values against " << x.size() << " values" << endl;
+            return result;
+        }
     }
 
-    // y2[0] = t2
-    y2[0] = BN_dup(t2);
-
-    // 使用内积计算欧式距离
-    BIGNUM* distance = inner_product_PHE(x2, y2);
-
-    // 求算数平方根
-    distance = BN_sqrt(distance);
-
-    // 释放临时变量
-    BN_free(t);
-    BN_free(t2);
+    // 用户1构造增广向量并只加密一次
+    vector<BIGNUM*> x2(x.size() + 2);
+    augmentQuery_PHE(x, x2);
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+    vector<BIGNUM*> E_x2 = encryptBatch_PHE(x2, pk);
+
+    // 用户2为每一行构造增广向量，除平方和外直接引用原数据
+    BIGNUM* one = BN_new();
+    BN_one(one);
+    vector<vector<BIGNUM*>> W(ys.size());
+    executor().parallel_for(0, ys.size(), 0, [&](size_t b0, size_t b1) {
+        BIGNUM* t = BN_new();
+        for (size_t j = b0; j < b1; j++) {
+            BIGNUM* sum = BN_new();
+            for (size_t i = 0; i < x.size(); i++) {
+                BN_sqr(t, ys[j][i], localCTX());
+                BN_add(sum, sum, t);
+            }
+            W[j].reserve(x.size() + 2);
+            W[j].push_back(sum);
+            W[j].insert(W[j].end(), ys[j].begin(), ys[j].end());
+            W[j].push_back(one);
+        }
+        BN_free(t);
+    });
+
+    result = matvec_PHE(E_x2, W, true);
+    if (!squared) {
+        executor().parallel_for(0, result.size(), 0, [&](size_t b0, size_t b1) {
+            for (size_t j = b0; j < b1; j++) {
+                BIGNUM* square = result[j];
+                result[j] = BN_sqrt(square);
+                BN_free(square);
+            }
+        });
+    }
 
-    return distance;
+    for (size_t i = 0; i < x2.size(); i++) {
+        BN_free(x2[i]);
+        BN_free(E_x2[i]);
+    }
+    for (size_t j = 0; j < W.size(); j++) {
+        BN_free(W[j][0]);
+    }
+    BN_free(one);
+    return result;
 }
 
 /*
- *@Method 将数据分箱
- *@param vector<BIGNUM*> x 待分箱的数据
+ *@Method 确定分箱范围
+ *@param BIGNUM* min 数据的最小值
+ *@param BIGNUM* max 数据的最大值
  *@param int k 分箱个数
- *@return Bin 分箱结果
+ *@return vector<Bin> 只设置了范围的k个分箱
  */
-vector<Bin> split_PHE(vector<BIGNUM*> x, int k) {
-    // 定义最大值和最小值
-    BIGNUM* max = BN_CTX_get(CTX);
-    BIGNUM* min = BN_CTX_get(CTX);
-    // 利用安全最值协议计算最大值和最小值
-    max = max_PHE(x, 0, x.size() - 1);
-    min = min_PHE(x, 0, x.size() - 1);
-
+vector<Bin> makeBins_PHE(BIGNUM* min, BIGNUM* max, int k) {
     // 计算每个分箱的长度: (max - min) / k
-    BIGNUM* length = BN_CTX_get(CTX);
+    BIGNUM* length = BN_new();
     // 将k转为BIGNUM*
-    BIGNUM* k_bn = BN_CTX_get(CTX);
+    BIGNUM* k_bn = BN_new();
     BN_set_word(k_bn, k);
     BN_sub(length, max, min);
-    BN_div(length, NULL, length, k_bn, CTX);
+    BN_CTX* ctx = BN_CTX_new();
+    BN_div(length, NULL, length, k_bn, ctx);
+    BN_CTX_free(ctx);
 
     // 创建k个分箱
     vector<Bin> box(k);
@@ -852,30 +1760,82 @@ vector<Bin> split_PHE(vector<BIGNUM*> x, int k) {
     if (BN_cmp(temp1, max) < 0) {
         box[k - 1].upper = BN_dup(max);
     }
-    // 将数据添加到指定的箱体中，并将数据分箱公开
-    // 除最后一个箱体是左闭右闭区间外，其余均是左闭右开区间
-    for (int i = 0; i < x.size(); i++) {
-        // 单独判断最后一个区间的右边界
-        if (BN_cmp(x[i], box[k - 1].upper) >= 0) {
-            box[k - 1].elements.push_back(BN_dup(x[i]));
-            continue;
-        }
-        for (int j = 0; j < k; j++) {
-            if (BN_cmp(x[i], box[j].upper) < 0) {
-                box[j].elements.push_back(BN_dup(x[i]));
-                break;
-            }
-        }
-    }
 
     // 释放临时变量
-    BN_free(max);
-    BN_free(min);
     BN_free(length);
     BN_free(k_bn);
     BN_free(temp1);
 
     return box;
+}
+
+/*
+ *@Method 计算每个数据所属的分箱
+ *除最后一个箱体是左闭右闭区间外，其余均是左闭右开区间
+ *@param vector<BIGNUM*> x 待分箱的数据
+ *@param vector<Bin> box 已确定范围的分箱
+ *@param vector<int> bins 每个数据所属的分箱下标
+ *@return void
+ */
+void binIndex_PHE(const vector<BIGNUM*> &x, const vector<Bin> &box, vector<int> &bins) {
+    int k = box.size();
+    bins.resize(x.size());
+
+    int64_t lower;
+    int64_t upper;
+    bool native_box = BN_to_int64(box[0].lower, &lower) && BN_to_int64(box[0].upper, &upper);
+
+    executor().parallel_for(0, x.size(), 0, [&](size_t b0, size_t b1) {
+        // 数据和分箱范围都能放入int64时用原生整数计算
+        vector<BIGNUM*> block(x.begin() + b0, x.begin() + b1);
+        vector<int64_t> native;
+        if (native_box && toNative(block, native)) {
+            binIndex_native(native.data(), native.size(), lower, (uint64_t) upper - (uint64_t) lower, k, bins.data() + b0);
+            return;
+        }
+
+        for (size_t i = b0; i < b1; i++) {
+            // 单独判断最后一个区间的右边界
+            if (BN_cmp(x[i], box[k - 1].upper) >= 0) {
+                bins[i] = k - 1;
+                continue;
+            }
+            for (int j = 0; j < k; j++) {
+                if (BN_cmp(x[i], box[j].upper) < 0) {
+                    bins[i] = j;
+                    break;
+                }
+            }
+        }
+    });
+}
+
+/*
+ *@Method 将数据分箱
+ *@param vector<BIGNUM*> x 待分箱的数据
+ *@param int k 分箱个数
+ *@return Bin 分箱结果
+ */
+vector<Bin> split_PHE(const vector<BIGNUM*> &x, int k) {
+    vector<Bin> box;
+
+    // 一次遍历同时求出最小值和最大值的下标
+    size_t min_index, max_index;
+    if (!minmax_PHE(x.data(), x.size(), &min_index, &max_index)) {
+        return box;
+    }
+
+    // 创建k个分箱
+    box = makeBins_PHE(x[min_index], x[max_index], k);
+
+    // 将数据添加到指定的箱体中，并将数据分箱公开
+    vector<int> bins;
+    binIndex_PHE(x, box, bins);
+    for (int i = 0; i < x.size(); i++) {
+        box[bins[i]].elements.push_back(BN_dup(x[i]));
+    }
+
+    return box;
 
     // // 查找数据q映射的分箱
     // for (int i = 0; i < k; i++) {
@@ -894,81 +1854,255 @@ vector<Bin> split_PHE(vector<BIGNUM*> x, int k) {
  *@return vector<BIGNUM*> 分箱频率
  */
 vector<BIGNUM*> frequency_PHE(vector<BIGNUM*> x, int k) {
-    // 获取数据分箱
-    vector<Bin> box = split_PHE(x, k);
-
-    // 创建用户1
-    DO* do1 = new DO(NULL, NULL, NULL);
-    // 用户1生成公私钥
-    InitKeys_PHE(20, 80, 80, 1024, 96448);
-    do1->set_pk(pk);
-    do1->set_sk(sk);
-
-    // 定义临时变量t
-    BIGNUM* t = BN_CTX_get(CTX);
-    BN_zero(t);
-
+    vector<Bin> box;
+    DO* do1 = NULL;
     // 用户1将公钥公开
     // 每个用户构造一个k维的向量，该用户持有数据的对应分箱位标记为1，其余为0
     // vector<vector<BIGNUM*> > flag(x.size(), vector<BIGNUM*>(k));
     vector<vector<BIGNUM*> > *flag = new vector<vector<BIGNUM*> >(x.size(), vector<BIGNUM*>(k));
-    // 初始化flag
-    for (int i = 0; i < x.size(); i++) {
-        for (int j = 0; j < k; j++) {
-            // *flag[i][j] = BN_dup(t);
-            (*flag)[i][j] = BN_dup(t);
-        }
-    }
+    // 定义分箱频率
+    vector<BIGNUM*> frequency;
 
-    for (int i = 0; i < x.size(); i++) {
-        // 最后一个区间的右边界单独判断
-        if (BN_cmp(x[i], box[k - 1].upper) == 0) {
-            // BN_one(flag[i][k - 1]);
-            BN_one((*flag)[i][k - 1]);
-            continue;
-        }
-        for (int j = 0; j < k; j++) {
-            if (BN_cmp(x[i], box[j].upper) < 0) {
-                // BN_one(flag[i][j]);
-                BN_one((*flag)[i][j]);
-                break;
+    // 分箱和生成公私钥互不依赖，可以同时计算
+    TaskGraph graph(executor());
+    // 获取数据分箱
+    int split = graph.add([&] {
+        box = split_PHE(x, k);
+    });
+
+    int keys = graph.add([&] {
+        // 创建用户1
+        do1 = new DO(NULL, NULL, NULL);
+        // 用户1生成公私钥
+        InitKeys_PHE(20, 80, 80, 1024, 96448);
+        do1->set_pk(pk);
+        do1->set_sk(sk);
+    });
+
+    int flags = graph.add([&] {
+        // 初始化flag
+        for (int i = 0; i < x.size(); i++) {
+            for (int j = 0; j < k; j++) {
+                // *flag[i][j] = BN_dup(t);
+                (*flag)[i][j] = BN_new();
+                BN_zero((*flag)[i][j]);
             }
         }
+
+        vector<int> bins;
+        binIndex_PHE(x, box, bins);
+        for (int i = 0; i < x.size(); i++) {
+            BN_one((*flag)[i][bins[i]]);
+        }
+    }, {split});
+
+    // 将k维的向量按块加密，每块是一个独立的任务
+    vector<int> encrypted;
+    size_t grain = max((size_t) 1, x.size() / (executor().size() * 4));
+    for (size_t b0 = 0; b0 < x.size(); b0 += grain) {
+        size_t b1 = min(x.size(), b0 + grain);
+        encrypted.push_back(graph.add([&, b0, b1] {
+            for (size_t i = b0; i < b1; i++) {
+                // 第2个用户除外
+                if (i != 1) {
+                    for (int j = 0; j < k; j++) {
+                        // flag[i][j] = encrypt_PHE(flag[i][j], do1->get_pk());
+                        BIGNUM* plain = (*flag)[i][j];
+                        (*flag)[i][j] = encrypt_PHE(plain, do1->get_pk());
+                        BN_free(plain);
+                    }
+                }
+            }
+        }, {flags, keys}));
     }
 
-    // 将k维的向量加密
-    for (int i = 0; i < x.size(); i++) {
-        // 第2个用户除外
-        if (i != 1) {
-            for (int j = 0; j < k; j++) {
-                // flag[i][j] = encrypt_PHE(flag[i][j], do1->get_pk());
-                (*flag)[i][j] = encrypt_PHE((*flag)[i][j], do1->get_pk());
+    // 用户2接收每个用户发来的k维向量，并计算每个分箱的频率
+    // 每块用户的向量先各自累加，再按块的顺序合并
+    graph.add([&] {
+        frequency = executor().parallel_reduce((size_t) 0, x.size(), 0, vector<BIGNUM*>(), [&](size_t b0, size_t b1) {
+            vector<BIGNUM*> part(k);
+            for (int i = 0; i < k; i++) {
+                part[i] = BN_new();
+                BN_zero(part[i]);
+                for (size_t j = b0; j < b1; j++) {
+                    // BN_add(t, t, flag[j][i]);
+                    BN_add(part[i], part[i], (*flag)[j][i]);
+                }
             }
-        }
+            return part;
+        }, [&](vector<BIGNUM*> a, vector<BIGNUM*> b) {
+            if (a.empty()) {
+                return b;
+            }
+            for (int i = 0; i < k; i++) {
+                addBIGNUM(a[i], b[i]);
+            }
+            return a;
+        });
+    }, encrypted);
+
+    graph.run();
+
+    // 用户1接收分箱频率并解密
+    for (int i = 0; i < frequency.size(); i++) {
+        BIGNUM* sum = frequency[i];
+        frequency[i] = decrypt_PHE(sum, do1->get_sk());
+        BN_free(sum);
     }
 
-    // 定义分箱频率
-    vector<BIGNUM*> frequency(k);
+    return frequency;
+}
 
-    // 用户2接收每个用户发来的k维向量，并计算每个分箱的频率
-    for (int i = 0; i < k; i++) {
-        BN_zero(t);
-        for (int j = 0; j < x.size(); j++) {
-            // BN_add(t, t, flag[j][i]);
-            BN_add(t, t, (*flag)[j][i]);
+/**
+ * @Method: 打开结果文件
+ * @param string resultFilePath 输出数据的地址
+ * @param DealOptions options 输出选项
+ * @return ResultWriter* 结果写入器，打开失败时为NULL
+ */
+static ResultWriter* openResult(const string &resultFilePath, const DealOptions &options) {
+    ResultWriter* writer = new ResultWriter(resultFilePath, options.format);
+    if (!writer->is_open()) {
+        cerr << "Unable to open file " << resultFilePath << endl;
+        delete writer;
+        return NULL;
+    }
+    return writer;
+}
+
+/**
+ * @Method: 写出缓冲区并关闭结果文件
+ * @param ResultWriter* writer 结果写入器
+ * @param string resultFilePath 输出数据的地址
+ * @return 状态码，1：成功；0：失败
+ */
+static int closeResult(ResultWriter* writer, const string &resultFilePath) {
+    bool ok = writer->close();
+    delete writer;
+    if (!ok) {
+        cerr << "Unable to write file " << resultFilePath << endl;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @Method: 输出单个BIGNUM结果
+ * @param string resultFilePath 输出数据的地址
+ * @param DealOptions options 输出选项
+ * @param string name 二进制格式中的列名
+ * @param BIGNUM* result 结果
+ * @return 状态码，1：成功；0：失败
+ */
+static int writeBIGNUMResult(const string &resultFilePath, const DealOptions &options, const string &name, BIGNUM* result) {
+    ResultWriter* writer = openResult(resultFilePath, options);
+    if (writer == NULL) {
+        return 0;
+    }
+    if (writer->binary()) {
+        writer->writeColumn(name, vector<BIGNUM*>(1, result));
+    } else {
+        writer->writeBIGNUM(result);
+        writer->writeText("\n");
+    }
+    return closeResult(writer, resultFilePath);
+}
+
+/**
+ * @Method: 输出一组大整数结果，文本格式为一行以空格分隔的数
+ * @param string resultFilePath 输出数据的地址
+ * @param DealOptions options 输出选项
+ * @param string name 二进制格式中的列名
+ * @param vector<BIGNUM*> result 结果
+ * @return 状态码，1：成功；0：失败
+ */
+static int writeBIGNUMsResult(const string &resultFilePath, const DealOptions &options, const string &name,
+                              const vector<BIGNUM*> &result) {
+    ResultWriter* writer = openResult(resultFilePath, options);
+    if (writer == NULL) {
+        return 0;
+    }
+    if (writer->binary()) {
+        writer->writeColumn(name, result);
+    } else {
+        for (size_t i = 0; i < result.size(); i++) {
+            writer->writeBIGNUM(result[i]);
+            writer->writeText(i + 1 < result.size() ? " " : "\n");
         }
-        frequency[i] = BN_dup(t);
     }
+    return closeResult(writer, resultFilePath);
+}
 
-    // 用户1接收分箱频率并解密
-    for (int i = 0; i < k; i++) {
-        frequency[i] = decrypt_PHE(frequency[i], do1->get_sk());
+/**
+ * @Method: 输出单个布尔结果
+ * @param string resultFilePath 输出数据的地址
+ * @param DealOptions options 输出选项
+ * @param bool result 结果
+ * @return 状态码，1：成功；0：失败
+ */
+static int writeBoolResult(const string &resultFilePath, const DealOptions &options, bool result) {
+    ResultWriter* writer = openResult(resultFilePath, options);
+    if (writer == NULL) {
+        return 0;
     }
+    if (writer->binary()) {
+        writer->writeColumn("result", vector<int64_t>(1, result));
+    } else {
+        writer->writeText(result ? "1\n" : "0\n");
+    }
+    return closeResult(writer, resultFilePath);
+}
 
-    // 释放临时变量
-    BN_free(t);
+/**
+ * @Method: 输出一组布尔结果，文本格式为一行以空格分隔的0和1
+ * @param string resultFilePath 输出数据的地址
+ * @param DealOptions options 输出选项
+ * @param vector<bool> result 结果
+ * @return 状态码，1：成功；0：失败
+ */
+static int writeBoolsResult(const string &resultFilePath, const DealOptions &options, const vector<bool> &result) {
+    ResultWriter* writer = openResult(resultFilePath, options);
+    if (writer == NULL) {
+        return 0;
+    }
+    if (writer->binary()) {
+        writer->writeColumn("result", vector<int64_t>(result.begin(), result.end()));
+    } else {
+        for (size_t i = 0; i < result.size(); i++) {
+            writer->writeText(result[i] ? "1 " : "0 ");
+        }
+        writer->writeText("\n");
+    }
+    return closeResult(writer, resultFilePath);
+}
 
-    return frequency;
+/**
+ * @Method: 输出布尔矩阵，文本格式每行一行以空格分隔的0和1，二进制格式按行展开为一列
+ * @param string resultFilePath 输出数据的地址
+ * @param DealOptions options 输出选项
+ * @param vector<vector<bool>> result 结果
+ * @return 状态码，1：成功；0：失败
+ */
+static int writeBoolMatrixResult(const string &resultFilePath, const DealOptions &options,
+                                 const vector<vector<bool>> &result) {
+    ResultWriter* writer = openResult(resultFilePath, options);
+    if (writer == NULL) {
+        return 0;
+    }
+    if (writer->binary()) {
+        vector<int64_t> flat;
+        for (size_t i = 0; i < result.size(); i++) {
+            flat.insert(flat.end(), result[i].begin(), result[i].end());
+        }
+        writer->writeColumn("result", flat);
+    } else {
+        for (size_t i = 0; i < result.size(); i++) {
+            for (size_t j = 0; j < result[i].size(); j++) {
+                writer->writeText(result[i][j] ? "1 " : "0 ");
+            }
+            writer->writeText("\n");
+        }
+    }
+    return closeResult(writer, resultFilePath);
 }
 
 /**
@@ -976,189 +2110,409 @@ vector<BIGNUM*> frequency_PHE(vector<BIGNUM*> x, int k) {
  * @param algoName 调用的算法名称
  * @param fileString 读取数据的地址
  * @param resultFilePath 输出数据的地址
+ * @param options 输出选项
  * @return 状态码，1：成功；0：失败
  */
-int deal(string algoName,string fileString,string resultFilePath) {
+int deal(string algoName, string fileString, string resultFilePath, const DealOptions &options) {
+    string spillPath = options.spillPath.empty() ? resultFilePath + ".spill" : options.spillPath;
+    if (options.resume && options.memoryBudget == 0) {
+        cerr << "Unable to resume " << algoName << " without a memory budget" << endl;
+        return 0;
+    }
     if (algoName == "avg") {
-        vector<BIGNUM*> data_list = readBIGNUMsFromFile(fileString);
-        BIGNUM* avg = avg_PHE(data_list);
-
-        ofstream outfile(resultFilePath);
-        if (outfile.is_open()) {
-            char* bn_str = BN_bn2dec(avg);
-            outfile << bn_str << endl;
-            OPENSSL_free(bn_str);
-            outfile.close();
+        BIGNUM* avg;
+        if (options.memoryBudget > 0) {
+            avg = avg_chunked_PHE(fileString, spillPath, options.memoryBudget, options.resume);
+            if (avg == NULL) {
+                return 0;
+            }
+        } else if (options.stream) {
+            avg = avg_stream_PHE(fileString);
+            if (avg == NULL) {
+                return 0;
+            }
         } else {
-            cerr << "Unable to open file " << resultFilePath << endl;
-            return 0;
+            vector<BIGNUM*> data_list = readBIGNUMsFromFile(fileString);
+            avg = avg_PHE(data_list);
         }
-        return 1;
+        return writeBIGNUMResult(resultFilePath, options, "avg", avg);
     }  else if (algoName == "compare") {
         vector<BIGNUM*> data_list = readBIGNUMsFromFile(fileString);
         bool result = compare_PHE(data_list[0], data_list[1]);
-
-        ofstream outfile(resultFilePath);
-        if (outfile.is_open()) {
-            // 将result写入文件
-            outfile << result << endl;
-            outfile.close();
-        } else {
-            cerr << "Unable to open file " << resultFilePath << endl;
+        return writeBoolResult(resultFilePath, options, result);
+    } else if (algoName == "compare_batch") {
+        // 第1行为DO1的数据，第2行为DO2的数据
+        vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+        if (data_list.size() < 2 || data_list[0].size() != data_list[1].size()) {
+            cerr << "Unable to read two lines of the same length from " << fileString << endl;
             return 0;
         }
-        return 1;
+        vector<bool> result = compare_PHE_batch(data_list[0], data_list[1]);
+        return writeBoolsResult(resultFilePath, options, result);
     } else if (algoName == "equal") {
         vector<BIGNUM*> data_list = readBIGNUMsFromFile(fileString);
         bool result = equal_PHE(data_list[0], data_list[1]);
+        return writeBoolResult(resultFilePath, options, result);
+    } else if (algoName == "equal_many") {
+        // 第1行的第一个数为DO1的数据，第2行为DO2的候选数据
+        vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+        if (data_list.size() < 2 || data_list[0].empty()) {
+            cerr << "Unable to read a value and a line of candidates from " << fileString << endl;
+            return 0;
+        }
+        vector<bool> result = equal_PHE_many(data_list[0][0], data_list[1]);
+        return writeBoolsResult(resultFilePath, options, result);
+    } else if (algoName == "join") {
+        // 第1行为DO1的连接键，第2行为DO2的连接键，可选的第3行为DO1每行的附加值
+        vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+        if (data_list.size() < 2) {
+            cerr << "Unable to read two lines of keys from " << fileString << endl;
+            return 0;
+        }
+        // 双方约定一次性的哈希密钥
+        unsigned char key[32];
+        if (RAND_bytes(key, sizeof(key)) != 1) {
+            cerr << "Unable to generate hash key" << endl;
+            return 0;
+        }
+        vector<BIGNUM*> values = data_list.size() > 2 ? data_list[2] : vector<BIGNUM*>();
+        if (!values.empty() && values.size() != data_list[0].size()) {
+            cerr << "Unable to join " << data_list[0].size() << " keys with " << values.size() << " values" << endl;
+            return 0;
+        }
+        JoinResult result = join_PHE(data_list[0], data_list[1], values, string((char*) key, sizeof(key)));
 
-        ofstream outfile(resultFilePath);
-        if (outfile.is_open()) {
-            // 将result写入文件
-            outfile << result << endl;
-            outfile.close();
-        } else {
-            cerr << "Unable to open file " << resultFilePath << endl;
+        ResultWriter* writer = openResult(resultFilePath, options);
+        if (writer == NULL) {
             return 0;
         }
-        return 1;
+        if (writer->binary()) {
+            vector<int64_t> xIndex, yIndex;
+            for (size_t k = 0; k < result.pairs.size(); k++) {
+                xIndex.push_back(result.pairs[k].first);
+                yIndex.push_back(result.pairs[k].second);
+            }
+            writer->writeColumn("x_index", xIndex);
+            writer->writeColumn("y_index", yIndex);
+            if (!values.empty()) {
+                writer->writeColumn("sum", result.sums);
+            }
+        } else {
+            for (size_t k = 0; k < result.pairs.size(); k++) {
+                writer->writeText(to_string(result.pairs[k].first) + " " + to_string(result.pairs[k].second) + "\n");
+            }
+            if (!values.empty()) {
+                writer->writeText("sum =");
+                for (size_t j = 0; j < result.sums.size(); j++) {
+                    writer->writeText(" ");
+                    writer->writeBIGNUM(result.sums[j]);
+                }
+                writer->writeText("\n");
+            }
+        }
+        return closeResult(writer, resultFilePath);
     } else if (algoName == "min_max") {
         vector<BIGNUM*> data_list = readBIGNUMsFromFile(fileString);
-        BIGNUM* min = min_PHE(data_list, 0, data_list.size() - 1);
-        BIGNUM* max = max_PHE(data_list, 0, data_list.size() - 1);
-
-        ofstream outfile(resultFilePath);
-        if (outfile.is_open()) {
-            char* bn_str = BN_bn2dec(min);
-            outfile << "min = " << bn_str << endl;
-            bn_str = BN_bn2dec(max);
-            outfile << "max = " << bn_str << endl;
-            OPENSSL_free(bn_str);
-            outfile.close();
+        size_t min_index, max_index;
+        if (!minmax_PHE(data_list.data(), data_list.size(), &min_index, &max_index)) {
+            cerr << "Unable to find min and max of empty data" << endl;
+            return 0;
+        }
+        BIGNUM* min = data_list[min_index];
+        BIGNUM* max = data_list[max_index];
+
+        ResultWriter* writer = openResult(resultFilePath, options);
+        if (writer == NULL) {
+            return 0;
+        }
+        if (writer->binary()) {
+            writer->writeColumn("min", vector<BIGNUM*>(1, min));
+            writer->writeColumn("max", vector<BIGNUM*>(1, max));
         } else {
-            cerr << "Unable to open file " << resultFilePath << endl;
+            writer->writeText("min = ");
+            writer->writeBIGNUM(min);
+            writer->writeText("\nmax = ");
+            writer->writeBIGNUM(max);
+            writer->writeText("\n");
+        }
+        return closeResult(writer, resultFilePath);
+    } else if (algoName == "min_max_tournament") {
+        vector<BIGNUM*> data_list = readBIGNUMsFromFile(fileString);
+        BIGNUM* min = BN_new();
+        BIGNUM* max = BN_new();
+        if (minmax_tournament_PHE(data_list, min, max) < 0) {
+            return 0;
+        }
+
+        ResultWriter* writer = openResult(resultFilePath, options);
+        if (writer == NULL) {
             return 0;
         }
-        return 1;
+        if (writer->binary()) {
+            writer->writeColumn("min", vector<BIGNUM*>(1, min));
+            writer->writeColumn("max", vector<BIGNUM*>(1, max));
+        } else {
+            writer->writeText("min = ");
+            writer->writeBIGNUM(min);
+            writer->writeText("\nmax = ");
+            writer->writeBIGNUM(max);
+            writer->writeText("\n");
+        }
+        return closeResult(writer, resultFilePath);
     } else if (algoName == "include") {
         vector<BIGNUM*> data_list = readBIGNUMsFromFile(fileString);
         bool result = include_PHE(data_list[0], data_list[1], data_list[2]);
-
-        ofstream outfile(resultFilePath);
-        if (outfile.is_open()) {
-            // 将result写入文件
-            outfile << result << endl;
-            outfile.close();
-        } else {
-            cerr << "Unable to open file " << resultFilePath << endl;
+        return writeBoolResult(resultFilePath, options, result);
+    } else if (algoName == "include_batch") {
+        // 第1行为DO1的点，第2、3行为DO2各区间的下界和上界
+        vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+        if (data_list.size() < 3 || data_list[1].size() != data_list[2].size()) {
+            cerr << "Unable to read points and two lines of bounds from " << fileString << endl;
             return 0;
         }
-        return 1;
+        vector<vector<bool>> result = include_PHE_batch(data_list[0], data_list[1], data_list[2]);
+        return writeBoolMatrixResult(resultFilePath, options, result);
     } else if (algoName == "intersect") {
         vector<BIGNUM*> data_list = readBIGNUMsFromFile(fileString);
         bool result = intersect_PHE(data_list[0], data_list[1], data_list[2], data_list[3]);
+        return writeBoolResult(resultFilePath, options, result);
+    } else if (algoName == "intersect_batch" || algoName == "intersect_join") {
+        // 第1、2行为DO1各范围的下界和上界，第3、4行为DO2各范围的下界和上界
+        vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+        if (data_list.size() < 4 || data_list[0].size() != data_list[1].size()
+            || data_list[2].size() != data_list[3].size()) {
+            cerr << "Unable to read two pairs of bound lines from " << fileString << endl;
+            return 0;
+        }
+        vector<vector<bool>> result = intersect_PHE_batch(data_list[0], data_list[1], data_list[2], data_list[3]);
+        if (algoName == "intersect_batch") {
+            return writeBoolMatrixResult(resultFilePath, options, result);
+        }
 
-        ofstream outfile(resultFilePath);
-        if (outfile.is_open()) {
-            // 将result写入文件
-            outfile << result << endl;
-            outfile.close();
-        } else {
-            cerr << "Unable to open file " << resultFilePath << endl;
+        // intersect_join只输出相交的范围对
+        ResultWriter* writer = openResult(resultFilePath, options);
+        if (writer == NULL) {
             return 0;
         }
-        return 1;
+        vector<int64_t> xIndex, yIndex;
+        for (size_t i = 0; i < result.size(); i++) {
+            for (size_t j = 0; j < result[i].size(); j++) {
+                if (result[i][j]) {
+                    xIndex.push_back(i);
+                    yIndex.push_back(j);
+                }
+            }
+        }
+        if (writer->binary()) {
+            writer->writeColumn("x_index", xIndex);
+            writer->writeColumn("y_index", yIndex);
+        } else {
+            for (size_t k = 0; k < xIndex.size(); k++) {
+                writer->writeText(to_string(xIndex[k]) + " " + to_string(yIndex[k]) + "\n");
+            }
+        }
+        return closeResult(writer, resultFilePath);
     } else if (algoName == "inner_product") {
-        vector<vector<BIGNUM*>> data_list(2);
-        data_list[0] = readBIGNUMsFromFile(fileString, 1);
-        data_list[1] = readBIGNUMsFromFile(fileString, 2);
-        BIGNUM* result = inner_product_PHE(data_list[0], data_list[1]);
-
-        ofstream outfile(resultFilePath);
-        if (outfile.is_open()) {
-            char* bn_str = BN_bn2dec(result);
-            outfile << bn_str << endl;
-            OPENSSL_free(bn_str);
-            outfile.close();
+        BIGNUM* result;
+        if (options.memoryBudget > 0) {
+            result = inner_product_chunked_PHE(fileString, spillPath, options.memoryBudget, options.resume);
+            if (result == NULL) {
+                return 0;
+            }
+        } else if (options.stream) {
+            result = inner_product_stream_PHE(fileString);
+            if (result == NULL) {
+                return 0;
+            }
         } else {
-            cerr << "Unable to open file " << resultFilePath << endl;
-            return 0;
+            vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+            if (data_list.size() < 2) {
+                cerr << "Unable to read two lines from " << fileString << endl;
+                return 0;
+            }
+            result = inner_product_PHE(data_list[0], data_list[1]);
         }
-        return 1;
+        return writeBIGNUMResult(resultFilePath, options, "inner_product", result);
     } else if (algoName == "distance") {
-        vector<vector<BIGNUM*>> data_list(2);
-        data_list[0] = readBIGNUMsFromFile(fileString, 1);
-        data_list[1] = readBIGNUMsFromFile(fileString, 2);
+        vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+        if (data_list.size() < 2) {
+            cerr << "Unable to read two lines from " << fileString << endl;
+            return 0;
+        }
         BIGNUM* result = distance_PHE(data_list[0], data_list[1]);
+        return writeBIGNUMResult(resultFilePath, options, "distance", result);
+    } else if (algoName == "matvec") {
+        // 第1行为DO1的向量x，其余各行为DO2权重矩阵的行，文件末尾的换行产生的空行不计入矩阵
+        vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+        while (!data_list.empty() && data_list.back().empty()) {
+            data_list.pop_back();
+        }
+        if (data_list.size() < 2) {
+            cerr << "Unable to read a vector and a matrix from " << fileString << endl;
+            return 0;
+        }
+        // 用户1生成公私钥，只加密一次向量
+        InitKeys_PHE(20, 80, 80, 1024, 96448);
+        vector<BIGNUM*> E_x = encryptBatch_PHE(data_list[0], pk);
+        vector<vector<BIGNUM*>> W(data_list.begin() + 1, data_list.end());
+        vector<BIGNUM*> result = matvec_PHE(E_x, W, true);
+        for (size_t i = 0; i < E_x.size(); i++) {
+            BN_free(E_x[i]);
+        }
+        if (result.empty()) {
+            return 0;
+        }
+        return writeBIGNUMsResult(resultFilePath, options, "matvec", result);
+    } else if (algoName == "distance_scan") {
+        // 第1行为DO1的查询向量，其余各行为DO2的数据库，输出到每一行距离的平方，可直接用于排序
+        vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+        while (!data_list.empty() && data_list.back().empty()) {
+            data_list.pop_back();
+        }
+        if (data_list.size() < 2) {
+            cerr << "Unable to read a query and a database from " << fileString << endl;
+            return 0;
+        }
+        vector<vector<BIGNUM*>> ys(data_list.begin() + 1, data_list.end());
+        vector<BIGNUM*> result = distance_scan_PHE(data_list[0], ys, true);
+        if (result.empty()) {
+            return 0;
+        }
+        return writeBIGNUMsResult(resultFilePath, options, "distance", result);
+    } else if (algoName == "matmul") {
+        // DO1的矩阵X与DO2的矩阵Y之间用一个空行分隔
+        vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+        while (!data_list.empty() && data_list.back().empty()) {
+            data_list.pop_back();
+        }
+        size_t split = 0;
+        while (split < data_list.size() && !data_list[split].empty()) {
+            split++;
+        }
+        if (split == 0 || split + 1 >= data_list.size()) {
+            cerr << "Unable to read two matrices separated by an empty line from " << fileString << endl;
+            return 0;
+        }
+        vector<vector<BIGNUM*>> X(data_list.begin(), data_list.begin() + split);
+        vector<vector<BIGNUM*>> Y(data_list.begin() + split + 1, data_list.end());
+        vector<vector<BIGNUM*>> result = matmul_PHE(X, Y);
+        if (result.empty()) {
+            return 0;
+        }
 
-        ofstream outfile(resultFilePath);
-        if (outfile.is_open()) {
-            char* bn_str = BN_bn2dec(result);
-            outfile << bn_str << endl;
-            OPENSSL_free(bn_str);
-            outfile.close();
-        } else {
-            cerr << "Unable to open file " << resultFilePath << endl;
+        ResultWriter* writer = openResult(resultFilePath, options);
+        if (writer == NULL) {
             return 0;
         }
-        return 1;
+        if (writer->binary()) {
+            vector<BIGNUM*> flat;
+            for (size_t i = 0; i < result.size(); i++) {
+                flat.insert(flat.end(), result[i].begin(), result[i].end());
+            }
+            writer->writeColumn("matmul", flat);
+        } else {
+            for (size_t i = 0; i < result.size(); i++) {
+                for (size_t j = 0; j < result[i].size(); j++) {
+                    writer->writeBIGNUM(result[i][j]);
+                    writer->writeText(j + 1 < result[i].size() ? " " : "\n");
+                }
+            }
+        }
+        return closeResult(writer, resultFilePath);
     } else if (algoName == "split") {
-        vector<vector<BIGNUM*>> data_list(2);
-        data_list[0] = readBIGNUMsFromFile(fileString, 1);
-        data_list[1] = readBIGNUMsFromFile(fileString, 2);
+        if (options.memoryBudget > 0) {
+            ResultWriter* writer = openResult(resultFilePath, options);
+            if (writer == NULL) {
+                return 0;
+            }
+            if (!split_chunked_PHE(fileString, spillPath, options.memoryBudget, writer)) {
+                delete writer;
+                return 0;
+            }
+            return closeResult(writer, resultFilePath);
+        }
+        vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+        if (data_list.size() < 2) {
+            cerr << "Unable to read two lines from " << fileString << endl;
+            return 0;
+        }
         // 将data_list[0][0]转化为int类型
         int k = static_cast<int>(BN_get_word(data_list[0][0]));
         vector<Bin> box = split_PHE(data_list[1], k);
 
-        ofstream outfile(resultFilePath);
-        if (outfile.is_open()) {
-            char* bn_str;
-
+        ResultWriter* writer = openResult(resultFilePath, options);
+        if (writer == NULL) {
+            return 0;
+        }
+        if (writer->binary()) {
+            // 按列输出分箱范围，元素按分箱顺序拼接，offsets[i]为第i个分箱的第一个元素的下标
+            vector<BIGNUM*> lower(box.size());
+            vector<BIGNUM*> upper(box.size());
+            vector<int64_t> offsets(box.size() + 1, 0);
+            vector<BIGNUM*> elements;
             for (int i = 0; i < box.size(); i++) {
-                bn_str = BN_bn2dec(box[i].lower);
-                outfile << "lower: " << bn_str << endl;
-                bn_str = BN_bn2dec(box[i].upper);
-                outfile << "upper: " << bn_str << endl;
-
-                outfile << "box[" << i << "].elements: ";;
+                lower[i] = box[i].lower;
+                upper[i] = box[i].upper;
+                offsets[i + 1] = offsets[i] + box[i].elements.size();
+                elements.insert(elements.end(), box[i].elements.begin(), box[i].elements.end());
+            }
+            writer->writeColumn("lower", lower);
+            writer->writeColumn("upper", upper);
+            writer->writeColumn("offsets", offsets);
+            writer->writeColumn("elements", elements);
+        } else {
+            for (int i = 0; i < box.size(); i++) {
+                writer->writeText("lower: ");
+                writer->writeBIGNUM(box[i].lower);
+                writer->writeText("\nupper: ");
+                writer->writeBIGNUM(box[i].upper);
+                writer->writeText("\nbox[" + to_string(i) + "].elements: ");
                 for (int j = 0; j < box[i].elements.size(); j++) {
-                    bn_str = BN_bn2dec(box[i].elements[j]);
-                    outfile << bn_str << " ";
+                    writer->writeBIGNUM(box[i].elements[j]);
+                    writer->writeText(" ");
                 }
-                outfile << endl;
+                writer->writeText("\n");
             }
-            OPENSSL_free(bn_str);
-            outfile.close();
-        } else {
-            cerr << "Unable to open file " << resultFilePath << endl;
-            return 0;
         }
-        return 1;
+        return closeResult(writer, resultFilePath);
     } else if (algoName == "frequency") {
-        vector<vector<BIGNUM*>> data_list(2);
-        data_list[0] = readBIGNUMsFromFile(fileString, 1);
-        data_list[1] = readBIGNUMsFromFile(fileString, 2);
-        // 将data_list[0][0]转化为int类型
-        int k = static_cast<int>(BN_get_word(data_list[0][0]));
-        vector<BIGNUM*> result = frequency_PHE(data_list[1], k);
-
-        ofstream outfile(resultFilePath);
-        if (outfile.is_open()) {
-            char* bn_str;
-
-            for (int i = 0; i < result.size(); i++) {
-                bn_str = BN_bn2dec(result[i]);
-                outfile << bn_str << " ";
+        vector<BIGNUM*> result;
+        if (options.memoryBudget > 0) {
+            result = frequency_chunked_PHE(fileString, spillPath, options.memoryBudget, options.resume);
+            if (result.empty()) {
+                return 0;
+            }
+        } else if (options.stream) {
+            result = frequency_stream_PHE(fileString);
+            if (result.empty()) {
+                return 0;
             }
-            OPENSSL_free(bn_str);
-            outfile.close();
         } else {
-            cerr << "Unable to open file " << resultFilePath << endl;
+            vector<vector<BIGNUM*>> data_list = readBIGNUMRowsFromFile(fileString);
+            if (data_list.size() < 2) {
+                cerr << "Unable to read two lines from " << fileString << endl;
+                return 0;
+            }
+            // 将data_list[0][0]转化为int类型
+            int k = static_cast<int>(BN_get_word(data_list[0][0]));
+            result = frequency_PHE(data_list[1], k);
+        }
+
+        ResultWriter* writer = openResult(resultFilePath, options);
+        if (writer == NULL) {
             return 0;
         }
-        return 1;
+        if (writer->binary()) {
+            writer->writeColumn("frequency", result);
+        } else {
+            for (int i = 0; i < result.size(); i++) {
+                writer->writeBIGNUM(result[i]);
+                writer->writeText(" ");
+            }
+        }
+        return closeResult(writer, resultFilePath);
     }
 
     cerr << "Unable to find fileString " << resultFilePath << endl;
     return 0;
-}
\ No newline at end of file
+}
@@ -10,13 +10,16 @@
 
 #include <bits/stdc++.h>
 #include <openssl/bn.h>
+#include "IO.h"
 using namespace std;
 
 // 设计一个公钥类
 class PublicKey {
 public:
     // 构造函数
-    PublicKey(int k_M, int k_r, int k_L, int k_p, int k_q, BIGNUM* N, BIGNUM* zero1_prime, BIGNUM* zero2_prime) {
+    PublicKey(int k_M, int k_r, int k_L, int k_p, int k_q, const BIGNUM* N, const BIGNUM* zero1_prime,
+              const BIGNUM* zero2_prime) {
+        this->id = nextId();
         this->k_M = k_M;
         this->k_r = k_r;
         this->k_L = k_L;
@@ -59,6 +62,25 @@ public:
         return BN_dup(zero2_prime);
     }
 
+    // 每个构造出的公钥对象在进程内有唯一的编号，copyKeys_PHE和restoreKeys_PHE构造的公钥也得到新编号；
+    // NUMA节点上的公钥副本按其来源公钥的编号缓存
+    uint64_t get_id() const {
+        return id;
+    }
+
+    // 以下三个方法返回公钥内部的数，调用者不能修改或释放，多个线程可以同时读取
+    const BIGNUM* peek_N() const {
+        return N;
+    }
+
+    const BIGNUM* peek_zero1_prime() const {
+        return zero1_prime;
+    }
+
+    const BIGNUM* peek_zero2_prime() const {
+        return zero2_prime;
+    }
+
     ~PublicKey() {
         BN_free(N);
         BN_free(zero1_prime);
@@ -66,6 +88,7 @@ public:
     }
 
 private:
+    uint64_t id;
     int k_M;
     int k_r;
     int k_L;
@@ -74,6 +97,11 @@ private:
     BIGNUM* N;
     BIGNUM* zero1_prime;
     BIGNUM* zero2_prime;
+
+    static uint64_t nextId() {
+        static atomic<uint64_t> next(0);
+        return ++next;
+    }
 };
 
 // 定义数据拥有者
@@ -130,6 +158,16 @@ private:
 // 声明公钥指针
 extern PublicKey* pk;
 
+// 等值连接的结果
+struct JoinResult {
+    // 匹配的下标对，first为DO1连接键的下标，second为DO2连接键的下标
+    vector<pair<size_t, size_t> > pairs;
+    // DO2每个连接键匹配到的DO1附加值之和，没有附加值时为空
+    vector<BIGNUM*> sums;
+    // 进行的密文相等性测试次数
+    size_t comparisons;
+};
+
 // 定义分箱的结构体
 struct Bin {
     // 定义分箱范围
@@ -153,11 +191,50 @@ BIGNUM* BN_sqrt(const BIGNUM* n);
 void generatePublicKeys_PHE();
 
 /**
- * @Method 生成公钥和私钥
+ * @Method 生成公钥和私钥，开启密钥复用且已有参数相同的密钥时直接返回
  * @return void
  */
 void InitKeys_PHE(int a, int b, int c, int d, int e);
 
+/**
+ * @Method 设置是否复用已生成的密钥
+ * 开启后各协议不再每次重新生成密钥，常驻进程预先生成一次密钥后可以并发执行多个任务
+ * @param bool reuse 是否复用
+ * @return void
+ */
+void setKeyReuse_PHE(bool reuse);
+
+/**
+ * @Method 释放一个公钥在所有NUMA节点上的副本，须在公钥释放前、不再用它加密后调用
+ * 全局公钥不需要调用；复制或恢复出的公钥在释放前调用，否则副本一直保留
+ * @param uint64_t keyId 公钥的编号
+ * @return void
+ */
+void releaseKeyReplicas_PHE(uint64_t keyId);
+
+/**
+ * @Method 复制当前的全局公钥和私钥，之后其它任务重新生成密钥不影响复制出的密钥
+ * @param PublicKey** copiedPk 复制的公钥，由调用者释放
+ * @param PrivateKey** copiedSk 复制的私钥，由调用者释放
+ * @return void
+ */
+void copyKeys_PHE(PublicKey** copiedPk, PrivateKey** copiedSk);
+
+/**
+ * @Method 用保存的参数和密钥构造一对公私钥，用于从检查点恢复任务，不改变全局的公钥和私钥
+ * @param int params[5] k_M、k_r、k_L、k_p、k_q
+ * @param BIGNUM* p 私钥p
+ * @param BIGNUM* L 私钥L
+ * @param BIGNUM* N 公开的模数
+ * @param BIGNUM* zero1_prime 公钥中0的密文
+ * @param BIGNUM* zero2_prime 公钥中0的密文
+ * @param PublicKey** restoredPk 恢复的公钥，由调用者释放
+ * @param PrivateKey** restoredSk 恢复的私钥，由调用者释放
+ * @return void
+ */
+void restoreKeys_PHE(const int params[5], const BIGNUM* p, const BIGNUM* L, const BIGNUM* N, const BIGNUM* zero1_prime,
+                     const BIGNUM* zero2_prime, PublicKey** restoredPk, PrivateKey** restoredSk);
+
 /**
  * @Method 加密
  * @param BIGNUM*  m 消息
@@ -174,6 +251,22 @@ BIGNUM* encrypt_PHE(BIGNUM* m, PublicKey* pk);
  */
 BIGNUM* decrypt_PHE(BIGNUM* E_m, PrivateKey* sk);
 
+/**
+ *@Method 在线程池中并行加密一组明文
+ *@param vector<BIGNUM*> m 明文
+ *@param PublicKey* pk 公钥
+ *@return vector<BIGNUM*> 密文，与m按下标一一对应
+ */
+vector<BIGNUM*> encryptBatch_PHE(const vector<BIGNUM*> &m, PublicKey* pk);
+
+/**
+ *@Method 在线程池中并行解密一组密文
+ *@param vector<BIGNUM*> E_m 密文
+ *@param PrivateKey* sk 私钥
+ *@return vector<BIGNUM*> 明文，与E_m按下标一一对应
+ */
+vector<BIGNUM*> decryptBatch_PHE(const vector<BIGNUM*> &E_m, PrivateKey* sk);
+
 /**
  *@Method 均值计算
  *@param vector<BIGNUM*> data_list 数据集合
@@ -189,6 +282,14 @@ BIGNUM* avg_PHE(vector<BIGNUM*> data_list);
  */
 bool compare_PHE(BIGNUM* x1, BIGNUM* x2);
 
+/**
+ *@Method 批量数据比较，所有比较使用同一组密钥，只需一轮通信
+ *@param vector<BIGNUM*> xs 用户DO1持有的数据
+ *@param vector<BIGNUM*> ys 用户DO2持有的数据，与xs按下标一一对应
+ *@return vector<bool> 第i位为true时xs[i] > ys[i]，xs与ys长度不同时为空
+ */
+vector<bool> compare_PHE_batch(const vector<BIGNUM*> &xs, const vector<BIGNUM*> &ys);
+
 /**
  *@Method 相等性测试
  *@param BIGNUM* x1 第一个数据
@@ -197,23 +298,62 @@ bool compare_PHE(BIGNUM* x1, BIGNUM* x2);
  */
 bool equal_PHE(BIGNUM* x1, BIGNUM* x2);
 
+/**
+ *@Method 一个数据与多个候选数据的相等性测试，-x和x^2只加密一次，所有候选数据在一轮通信内完成
+ *@param BIGNUM* x 用户DO1持有的数据
+ *@param vector<BIGNUM*> ys 用户DO2持有的候选数据
+ *@return vector<bool> 第i位为true时x == ys[i]
+ */
+vector<bool> equal_PHE_many(BIGNUM* x, const vector<BIGNUM*> &ys);
+
+/**
+ *@Method 分桶的隐私等值连接，双方用约定的带密钥哈希分桶，只在同一桶内进行批量密文相等性测试
+ *@param vector<BIGNUM*> xs 用户DO1持有的连接键
+ *@param vector<BIGNUM*> ys 用户DO2持有的连接键
+ *@param vector<BIGNUM*> values 用户DO1每行的附加值，为空时不求和
+ *@param string hashKey 双方约定的哈希密钥
+ *@param size_t buckets 桶数，为0时取两方数据量的较大者
+ *@return JoinResult 匹配的下标对，以及DO2每个连接键匹配到的附加值之和
+ */
+JoinResult join_PHE(const vector<BIGNUM*> &xs, const vector<BIGNUM*> &ys, const vector<BIGNUM*> &values,
+                    const string &hashKey, size_t buckets = 0);
+
+/**
+ *@Method 一次遍历同时求最小值和最大值的下标，各块并行计算，不复制数据
+ *@param BIGNUM* const* datas 数据集的起始位置
+ *@param size_t n 数据个数
+ *@param size_t* min_index 最小值的下标，有多个时取第一个
+ *@param size_t* max_index 最大值的下标，有多个时取第一个
+ *@return bool 数据集为空时返回false
+ */
+bool minmax_PHE(BIGNUM* const* datas, size_t n, size_t* min_index, size_t* max_index);
+
 /**
  *@Method 求最小值
  *@param vector<BIGNUM*> datas N个数据拥有者持有的数据集
  *@param int left 数据集的左边界
  *@param int right 数据集的右边界
- *@return BIGNUM* min 最小值
+ *@return BIGNUM* min 最小值，由调用者释放
  */
-BIGNUM* min_PHE(vector<BIGNUM*> datas, int left, int right);
+BIGNUM* min_PHE(const vector<BIGNUM*> &datas, int left, int right);
 
 /**
  *@Method 求最大值
  *@param vector<BIGNUM*> datas N个数据拥有者持有的数据集
  *@param int left 数据集的左边界
  *@param int right 数据集的右边界
- *@return BIGNUM* max 最大值
+ *@return BIGNUM* max 最大值，由调用者释放
  */
-BIGNUM* max_PHE(vector<BIGNUM*> datas, int left, int right);
+BIGNUM* max_PHE(const vector<BIGNUM*> &datas, int left, int right);
+
+/**
+ *@Method 锦标赛方式的安全最小值与最大值，每一层的比较合并为一次批量比较，共ceil(log2 n)轮
+ *@param vector<BIGNUM*> datas 数据
+ *@param BIGNUM* min 最小值
+ *@param BIGNUM* max 最大值
+ *@return int 比较的轮数，datas为空时为-1
+ */
+int minmax_tournament_PHE(const vector<BIGNUM*> &datas, BIGNUM* min, BIGNUM* max);
 
 /*
  *@Method 包含关系测试
@@ -224,6 +364,15 @@ BIGNUM* max_PHE(vector<BIGNUM*> datas, int left, int right);
  */
 bool include_PHE(BIGNUM* x, BIGNUM* y1, BIGNUM* y2);
 
+/**
+ *@Method 批量包含关系测试，每个点的密文在所有区间间复用，所有(点, 区间)在一轮通信内完成
+ *@param vector<BIGNUM*> xs 用户DO1持有的点
+ *@param vector<BIGNUM*> y1s 用户DO2持有的区间下界
+ *@param vector<BIGNUM*> y2s 用户DO2持有的区间上界，与y1s按下标一一对应
+ *@return vector<vector<bool>> 第i行第j列与include_PHE(xs[i], y1s[j], y2s[j])相同，true:不在区间内;false:在区间内
+ */
+vector<vector<bool>> include_PHE_batch(const vector<BIGNUM*> &xs, const vector<BIGNUM*> &y1s, const vector<BIGNUM*> &y2s);
+
 /*
  *@Method 范围相交测试
  *@param BIGNUM* x1 用户DO1持有的数据
@@ -234,6 +383,17 @@ bool include_PHE(BIGNUM* x, BIGNUM* y1, BIGNUM* y2);
  */
 bool intersect_PHE(BIGNUM* x1, BIGNUM* x2, BIGNUM* y1, BIGNUM* y2);
 
+/**
+ *@Method 批量范围相交测试，用户1每个范围的密文在用户2的所有范围间复用，所有范围对在一轮通信内完成
+ *@param vector<BIGNUM*> x1s 用户DO1持有的范围下界
+ *@param vector<BIGNUM*> x2s 用户DO1持有的范围上界，与x1s按下标一一对应
+ *@param vector<BIGNUM*> y1s 用户DO2持有的范围下界
+ *@param vector<BIGNUM*> y2s 用户DO2持有的范围上界，与y1s按下标一一对应
+ *@return vector<vector<bool>> 第i行第j列为true时[x1s[i], x2s[i]]与[y1s[j], y2s[j]]相交，边界长度不匹配时为空
+ */
+vector<vector<bool>> intersect_PHE_batch(const vector<BIGNUM*> &x1s, const vector<BIGNUM*> &x2s,
+                                         const vector<BIGNUM*> &y1s, const vector<BIGNUM*> &y2s);
+
 /*
  *@Method 求内积
  *@param vector<BIGNUM*> x1 用户DO1持有的数据
@@ -242,6 +402,23 @@ bool intersect_PHE(BIGNUM* x1, BIGNUM* x2, BIGNUM* y1, BIGNUM* y2);
  */
 BIGNUM* inner_product_PHE(vector<BIGNUM*> x1, vector<BIGNUM*> y1);
 
+/*
+ *@Method 密文向量与明文矩阵的乘法，[x]只加密一次，各行的内积按行分块并行计算
+ *@param vector<BIGNUM*> E_x 用户DO1用encryptBatch_PHE加密后的向量[x]
+ *@param vector<vector<BIGNUM*>> W 用户DO2持有的权重矩阵，每行长度与E_x相同
+ *@param bool decrypt 为true时由用户1批量解密，返回明文
+ *@return vector<BIGNUM*> 第r个元素为W[r]与x的内积（decrypt为false时为其密文），W的行长度不匹配时为空
+ */
+vector<BIGNUM*> matvec_PHE(const vector<BIGNUM*> &E_x, const vector<vector<BIGNUM*>> &W, bool decrypt = true);
+
+/*
+ *@Method 双方的矩阵乘法X * Y，X按行分块加密一次，各块的内积并行计算后批量解密，同时只保留一块密文
+ *@param vector<vector<BIGNUM*>> X 用户DO1持有的r * k矩阵
+ *@param vector<vector<BIGNUM*>> Y 用户DO2持有的k * c矩阵
+ *@return vector<vector<BIGNUM*>> r * c的乘积，矩阵形状不匹配时为空
+ */
+vector<vector<BIGNUM*>> matmul_PHE(const vector<vector<BIGNUM*>> &X, const vector<vector<BIGNUM*>> &Y);
+
 /*
  *@Method 求欧氏距离
  *@param vector<BIGNUM*> x1 用户DO1持有的数据
@@ -250,13 +427,41 @@ BIGNUM* inner_product_PHE(vector<BIGNUM*> x1, vector<BIGNUM*> y1);
  */
 BIGNUM* distance_PHE(vector<BIGNUM*> x1, vector<BIGNUM*> y1);
 
+/*
+ *@Method 一个查询向量与数据库中每一行的欧氏距离，查询的增广向量只加密一次，各行并行计算后批量解密
+ *@param vector<BIGNUM*> x 用户DO1持有的查询向量
+ *@param vector<vector<BIGNUM*>> ys 用户DO2持有的数据库，每行长度与x相同
+ *@param bool squared 为true时返回距离的平方（只需要排序时省去开方），否则返回向上取整的距离
+ *@return vector<BIGNUM*> 第j个元素为x与ys[j]的距离，行长度不匹配时为空
+ */
+vector<BIGNUM*> distance_scan_PHE(const vector<BIGNUM*> &x, const vector<vector<BIGNUM*>> &ys, bool squared = true);
+
+/*
+ *@Method 确定分箱范围
+ *@param BIGNUM* min 数据的最小值
+ *@param BIGNUM* max 数据的最大值
+ *@param int k 分箱个数
+ *@return vector<Bin> 只设置了范围的k个分箱
+ */
+vector<Bin> makeBins_PHE(BIGNUM* min, BIGNUM* max, int k);
+
+/*
+ *@Method 计算每个数据所属的分箱
+ *除最后一个箱体是左闭右闭区间外，其余均是左闭右开区间
+ *@param vector<BIGNUM*> x 待分箱的数据
+ *@param vector<Bin> box 已确定范围的分箱
+ *@param vector<int> bins 每个数据所属的分箱下标
+ *@return void
+ */
+void binIndex_PHE(const vector<BIGNUM*> &x, const vector<Bin> &box, vector<int> &bins);
+
 /*
  *@Method 将数据分箱
  *@param vector<BIGNUM*> x 待分箱的数据
  *@param int k 分箱个数
  *@return Bin 分箱结果
  */
-vector<Bin> split_PHE(vector<BIGNUM*> x, int k);
+vector<Bin> split_PHE(const vector<BIGNUM*> &x, int k);
 
 /*
  *@Method 计算每个分箱数据出现的频率
@@ -266,13 +471,35 @@ vector<Bin> split_PHE(vector<BIGNUM*> x, int k);
  */
 vector<BIGNUM*> frequency_PHE(vector<BIGNUM*> x, int k);
 
+// 总控处理程序的选项
+struct DealOptions {
+    // 结果文件的输出格式
+    OutputFormat format;
+    // avg、inner_product和frequency是否以流水线方式执行
+    bool stream;
+    // 分块执行的内存预算，单位为字节，为0时不分块；avg、inner_product、split和frequency支持分块执行
+    size_t memoryBudget;
+    // 分块执行时溢写文件的前缀，为空时使用resultFilePath + ".spill"
+    string spillPath;
+    // 分块执行的avg、inner_product和frequency是否从上次中断时的检查点继续
+    bool resume;
+
+    DealOptions() {
+        this->format = OUTPUT_TEXT;
+        this->stream = false;
+        this->memoryBudget = 0;
+        this->resume = false;
+    }
+};
+
 /**
  * @Method: 总控处理程序
  * @param algoName 调用的算法名称
  * @param fileString 读取数据的地址
  * @param resultFilePath 输出数据的地址
+ * @param options 输出选项
  * @return 状态码，1：成功；0：失败
  */
-int deal(string algoName,string fileString,string resultFilePath);
+int deal(string algoName, string fileString, string resultFilePath, const DealOptions &options = DealOptions());
 
 #endif //PHE_H
\ No newline at end of file
@@ -0,0 +1,560 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Running one role of a two-party protocol as a separate process
+*/
+
+#include "SHE.h"
+#include "PHE.h"
+#include "IO.h"
+#include "Native.h"
+#include "Executor.h"
+#include "Transport.h"
+#include "Party.h"
+#include <openssl/bn.h>
+using namespace std;
+
+// inner_product、distance和avg每帧发送的密文个数，DO2处理当前帧时DO1加密下一帧
+static const size_t CIPHER_BATCH = 256;
+
+/**
+ * @Method: 编码FRAME_PUBLIC_KEY的内容
+ * @return string 全局参数和公钥
+ */
+string encodePublicKey() {
+    uint32_t params[5] = {(uint32_t) k_M, (uint32_t) k_r, (uint32_t) k_L, (uint32_t) k_p, (uint32_t) k_q};
+    string payload((const char*) params, sizeof(params));
+    vector<BIGNUM*> values;
+    values.push_back(pk->get_N());
+    values.push_back(pk->get_zero1_prime());
+    values.push_back(pk->get_zero2_prime());
+    payload += encodeBIGNUMs(values);
+    for (size_t i = 0; i < values.size(); i++) {
+        BN_free(values[i]);
+    }
+    return payload;
+}
+
+/**
+ * @Method: 解码FRAME_PUBLIC_KEY的内容，设置全局的参数、N和pk
+ * @param string payload 帧内容
+ * @return bool true:成功; false:格式错误
+ */
+bool decodePublicKey(const string &payload) {
+    uint32_t params[5];
+    if (payload.size() < sizeof(params)) {
+        return false;
+    }
+    memcpy(params, payload.data(), sizeof(params));
+    vector<BIGNUM*> values;
+    if (!decodeBIGNUMs(payload.substr(sizeof(params)), values) || values.size() != 3) {
+        return false;
+    }
+    k_M = params[0];
+    k_r = params[1];
+    k_L = params[2];
+    k_p = params[3];
+    k_q = params[4];
+    N = values[0];
+    pk = new PublicKey(k_M, k_r, k_L, k_p, k_q, values[0], values[1], values[2]);
+    BN_free(values[1]);
+    BN_free(values[2]);
+    return true;
+}
+
+/**
+ * @Method: 接收公钥
+ * @param Channel* channel 信道
+ * @return bool true:成功; false:连接已断开或格式错误
+ */
+static bool recvPublicKey(Channel* channel) {
+    uint8_t type;
+    string payload;
+    return channel->recvFrame(&type, payload) && type == FRAME_PUBLIC_KEY && decodePublicKey(payload);
+}
+
+/**
+ * @Method: DO2生成两个k_M比特的随机数r1 > r2 > 0，计算t = r1 * t - r2
+ * @param BIGNUM* t 待混淆的密文
+ * @return void
+ */
+static void blind(BIGNUM* t) {
+    BIGNUM* r1 = generateRandom(k_M);
+    BIGNUM* r2 = generateRandom(k_M);
+    while (BN_cmp(r1, r2) != 1) {
+        BN_free(r1);
+        BN_free(r2);
+        r1 = generateRandom(k_M);
+        r2 = generateRandom(k_M);
+    }
+    BN_mul(t, t, r1, localCTX());
+    BN_sub(t, t, r2);
+    BN_free(r1);
+    BN_free(r2);
+}
+
+/**
+ * @Method: 释放一组BIGNUM
+ * @param vector<BIGNUM*> values 待释放的数
+ * @return void
+ */
+static void freeAll(vector<BIGNUM*> &values) {
+    for (size_t i = 0; i < values.size(); i++) {
+        BN_free(values[i]);
+    }
+    values.clear();
+}
+
+/**
+ * @Method: DO1加密并发送一组数，接收DO2混淆后的结果并解密
+ * @param Channel* channel 信道
+ * @param vector<BIGNUM*> plains 待加密的数
+ * @return BIGNUM* 解密结果，失败时为NULL
+ */
+static BIGNUM* maskedRound_DO1(Channel* channel, const vector<BIGNUM*> &plains) {
+    vector<BIGNUM*> ciphers(plains.size());
+    for (size_t i = 0; i < plains.size(); i++) {
+        ciphers[i] = encrypt_PHE(plains[i], pk);
+    }
+    bool ok = channel->sendBIGNUMs(ciphers);
+    freeAll(ciphers);
+    vector<BIGNUM*> reply;
+    if (!ok || !channel->recvBIGNUMs(reply) || reply.size() != 1) {
+        freeAll(reply);
+        return NULL;
+    }
+    BIGNUM* result = decrypt_PHE(reply[0], sk);
+    freeAll(reply);
+    return result;
+}
+
+/**
+ * @Method: 判断算法是否为单轮的混淆比较协议
+ * @param string algoName 算法名称
+ * @return bool true:compare、equal、include或intersect
+ */
+bool isMaskedAlgo(const string &algoName) {
+    return algoName == "compare" || algoName == "equal" || algoName == "include" || algoName == "intersect";
+}
+
+/**
+ * @Method: 单轮协议中DO1需要持有的数据个数
+ * @param string algoName 算法名称
+ * @return size_t 数据个数
+ */
+static size_t maskedInputs_DO1(const string &algoName) {
+    return algoName == "intersect" ? 2 : 1;
+}
+
+/**
+ * @Method: 单轮协议中DO2需要持有的数据个数
+ * @param string algoName 算法名称
+ * @return size_t 数据个数
+ */
+static size_t maskedInputs_DO2(const string &algoName) {
+    return algoName == "include" || algoName == "intersect" ? 2 : 1;
+}
+
+/**
+ * @Method: 单轮协议中DO1待加密的数
+ * compare: x1；equal、include: -x、x^2；intersect: x1 * x2、-x1、-x2
+ * @param string algoName 算法名称
+ * @param vector<BIGNUM*> x DO1持有的数据
+ * @param vector<BIGNUM*>& plains 待加密的数
+ * @return bool true:成功; false:数据个数不足
+ */
+bool maskedPlains_DO1(const string &algoName, const vector<BIGNUM*> &x, vector<BIGNUM*> &plains) {
+    if (x.size() < maskedInputs_DO1(algoName)) {
+        return false;
+    }
+    if (algoName == "compare") {
+        plains.push_back(BN_dup(x[0]));
+    } else if (algoName == "equal" || algoName == "include") {
+        plains.push_back(BN_dup(x[0]));
+        BN_set_negative(plains[0], !BN_is_negative(x[0]));
+        plains.push_back(square_native(x[0]));
+    } else {
+        plains.push_back(BN_new());
+        BN_mul(plains[0], x[0], x[1], localCTX());
+        plains.push_back(BN_dup(x[0]));
+        BN_set_negative(plains[1], !BN_is_negative(x[0]));
+        plains.push_back(BN_dup(x[1]));
+        BN_set_negative(plains[2], !BN_is_negative(x[1]));
+    }
+    return true;
+}
+
+/**
+ * @Method: 单轮协议中DO2用DO1的密文和自己的数据计算并混淆
+ * compare: E_x1 - x2；equal: E_x1_square + 2 * x2 * E_x1_neg + x2^2；
+ * include: E_x_square + E_x_neg * (y1 + y2) + y1 * y2；
+ * intersect: E_x1_mul_x2 + E_x2_neg * y2 + E_x1_neg * y1 + y1 * y2；结果为r1 * t - r2
+ * @param string algoName 算法名称
+ * @param vector<BIGNUM*> y DO2持有的数据
+ * @param vector<BIGNUM*> E DO1发来的密文
+ * @return BIGNUM* 混淆后的密文，数据或密文个数不对时为NULL
+ */
+BIGNUM* maskedCombine_DO2(const string &algoName, const vector<BIGNUM*> &y, const vector<BIGNUM*> &E) {
+    if (y.size() < maskedInputs_DO2(algoName) || E.size() != (algoName == "compare" ? 1 : algoName == "intersect" ? 3 : 2)) {
+        return NULL;
+    }
+    BN_CTX* ctx = localCTX();
+    BIGNUM* t = BN_new();
+    BIGNUM* t2 = BN_new();
+    if (algoName == "compare") {
+        BN_sub(t, E[0], y[0]);
+    } else if (algoName == "equal") {
+        BN_lshift1(t, y[0]);
+        BN_mul(t, t, E[0], ctx);
+        BN_add(t, t, E[1]);
+        BN_sqr(t2, y[0], ctx);
+        BN_add(t, t, t2);
+    } else if (algoName == "include") {
+        BN_add(t, y[0], y[1]);
+        BN_mul(t, E[0], t, ctx);
+        BN_add(t, E[1], t);
+        BN_mul(t2, y[0], y[1], ctx);
+        BN_add(t, t, t2);
+    } else {
+        BN_mul(t, E[2], y[1], ctx);
+        BN_add(t, E[0], t);
+        BN_mul(t2, E[1], y[0], ctx);
+        BN_add(t, t, t2);
+        BN_mul(t2, y[0], y[1], ctx);
+        BN_add(t, t, t2);
+    }
+    BN_free(t2);
+    blind(t);
+    return t;
+}
+
+/**
+ * @Method: 单轮协议中DO1由解密结果得到协议的结果
+ * @param string algoName 算法名称
+ * @param BIGNUM* res 解密结果
+ * @return bool 与compare_PHE、equal_PHE、include_PHE和intersect_PHE的返回值相同
+ */
+bool maskedOutcome_DO1(const string &algoName, const BIGNUM* res) {
+    if (algoName == "compare") {
+        return !BN_is_negative(res);
+    } else if (algoName == "equal") {
+        return BN_is_negative(res);
+    } else if (algoName == "include") {
+        return !BN_is_negative(res) && !BN_is_zero(res);
+    }
+    return BN_is_negative(res) || BN_is_zero(res);
+}
+
+/**
+ * @Method: DO1分批加密并发送向量，接收DO2的聚合结果并解密
+ * @param Channel* channel 信道
+ * @param vector<BIGNUM*> x 待加密的向量
+ * @return BIGNUM* 解密结果，失败时为NULL
+ */
+static BIGNUM* streamRound_DO1(Channel* channel, const vector<BIGNUM*> &x) {
+    for (size_t b0 = 0; b0 < x.size(); b0 += CIPHER_BATCH) {
+        size_t b1 = min(x.size(), b0 + CIPHER_BATCH);
+        vector<BIGNUM*> ciphers(b1 - b0);
+        executor().parallel_for(b0, b1, 0, [&](size_t i0, size_t i1) {
+            for (size_t i = i0; i < i1; i++) {
+                ciphers[i - b0] = encrypt_PHE(x[i], pk);
+            }
+        });
+        bool ok = channel->sendBIGNUMs(ciphers);
+        freeAll(ciphers);
+        if (!ok) {
+            return NULL;
+        }
+    }
+    vector<BIGNUM*> reply;
+    if (!channel->sendFrame(FRAME_END, "") || !channel->recvBIGNUMs(reply) || reply.size() != 1) {
+        freeAll(reply);
+        return NULL;
+    }
+    BIGNUM* result = decrypt_PHE(reply[0], sk);
+    freeAll(reply);
+    return result;
+}
+
+/**
+ * @Method: DO2接收DO1分批发送的密文并聚合，y为NULL时求和并对N取模，否则求与y的内积
+ * @param Channel* channel 信道
+ * @param vector<BIGNUM*>* y DO2持有的向量
+ * @return bool true:成功; false:连接已断开、格式错误或向量长度不一致
+ */
+static bool streamRound_DO2(Channel* channel, const vector<BIGNUM*>* y) {
+    BIGNUM* sum = BN_new();
+    BIGNUM* t = BN_new();
+    BN_zero(sum);
+    size_t offset = 0;
+    bool ok = false;
+    while (true) {
+        uint8_t type;
+        string payload;
+        vector<BIGNUM*> ciphers;
+        if (!channel->recvFrame(&type, payload)) {
+            break;
+        }
+        if (type == FRAME_END) {
+            ok = y == NULL || offset == y->size();
+            break;
+        }
+        if (type != FRAME_BIGNUMS || !decodeBIGNUMs(payload, ciphers)
+            || (y != NULL && offset + ciphers.size() > y->size())) {
+            freeAll(ciphers);
+            break;
+        }
+        for (size_t i = 0; i < ciphers.size(); i++) {
+            if (y == NULL) {
+                BN_add(sum, sum, ciphers[i]);
+                BN_mod(sum, sum, N, localCTX());
+            } else {
+                BN_mul(t, ciphers[i], (*y)[offset + i], localCTX());
+                BN_add(sum, sum, t);
+            }
+        }
+        offset += ciphers.size();
+        freeAll(ciphers);
+    }
+    if (ok) {
+        ok = channel->sendBIGNUMs(vector<BIGNUM*>(1, sum));
+    } else {
+        cerr << "Unable to aggregate " << offset << " ciphertexts" << endl;
+    }
+    BN_free(t);
+    BN_free(sum);
+    return ok;
+}
+
+/**
+ * @Method: 检查输入个数
+ * @param vector<BIGNUM*> x 输入数据
+ * @param size_t count 应有的个数
+ * @param string inputFile 输入文件
+ * @return bool true:个数正确; false:个数不足
+ */
+static bool expectInputs(const vector<BIGNUM*> &x, size_t count, const string &inputFile) {
+    if (x.size() < count) {
+        cerr << "Unable to read " << count << " values from " << inputFile << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @Method: 构造计算欧氏距离的内积向量，见distance_PHE
+ * DO1为(1, -2 * x[0], ..., -2 * x[n - 1], x[0]^2 + ... + x[n - 1]^2)，
+ * DO2为(y[0]^2 + ... + y[n - 1]^2, y[0], ..., y[n - 1], 1)
+ * @param vector<BIGNUM*> x 本方持有的向量
+ * @param PartyRole role 角色
+ * @return vector<BIGNUM*> 内积向量
+ */
+static vector<BIGNUM*> distanceVector(const vector<BIGNUM*> &x, PartyRole role) {
+    vector<BIGNUM*> v(x.size() + 2);
+    BIGNUM* squares = BN_new();
+    BIGNUM* t = BN_new();
+    BN_zero(squares);
+    for (size_t i = 0; i < x.size(); i++) {
+        BN_sqr(t, x[i], localCTX());
+        BN_add(squares, squares, t);
+        v[i + 1] = BN_dup(x[i]);
+        if (role == PARTY_DO1) {
+            BN_lshift1(v[i + 1], v[i + 1]);
+            BN_set_negative(v[i + 1], !BN_is_negative(x[i]));
+        }
+    }
+    BN_free(t);
+    BIGNUM* one = BN_new();
+    BN_one(one);
+    v[0] = role == PARTY_DO1 ? one : squares;
+    v[x.size() + 1] = role == PARTY_DO1 ? squares : one;
+    return v;
+}
+
+/**
+ * @Method: 运行DO1一方的协议
+ * @param Channel* channel 信道
+ * @param string algoName 调用的算法名称
+ * @param vector<BIGNUM*> x DO1持有的数据
+ * @param string inputFile 输入文件
+ * @return BIGNUM* 结果，布尔值为1或0，失败时为NULL
+ */
+static BIGNUM* run_DO1(Channel* channel, const string &algoName, vector<BIGNUM*> &x, const string &inputFile) {
+    BIGNUM* result = NULL;
+    if (isMaskedAlgo(algoName)) {
+        vector<BIGNUM*> plains;
+        if (!maskedPlains_DO1(algoName, x, plains)) {
+            expectInputs(x, maskedInputs_DO1(algoName), inputFile);
+            return NULL;
+        }
+        BIGNUM* res = maskedRound_DO1(channel, plains);
+        freeAll(plains);
+        if (res != NULL) {
+            result = BN_new();
+            BN_set_word(result, maskedOutcome_DO1(algoName, res));
+            BN_free(res);
+        }
+    } else if (algoName == "inner_product") {
+        result = streamRound_DO1(channel, x);
+    } else if (algoName == "distance") {
+        vector<BIGNUM*> v = distanceVector(x, PARTY_DO1);
+        BIGNUM* square = streamRound_DO1(channel, v);
+        freeAll(v);
+        if (square != NULL) {
+            result = BN_sqrt(square);
+            BN_free(square);
+        }
+    } else if (algoName == "avg") {
+        if (!expectInputs(x, 1, inputFile)) {
+            return NULL;
+        }
+        BIGNUM* sum = streamRound_DO1(channel, x);
+        if (sum != NULL) {
+            BIGNUM* count = BN_new();
+            BN_set_word(count, x.size());
+            result = BN_new();
+            BN_div(result, NULL, sum, count, localCTX());
+            BN_free(count);
+            BN_free(sum);
+        }
+    } else {
+        cerr << "Unable to run " << algoName << " as two parties" << endl;
+    }
+    return result;
+}
+
+/**
+ * @Method: 运行DO2一方的协议
+ * @param Channel* channel 信道
+ * @param string algoName 调用的算法名称
+ * @param vector<BIGNUM*> y DO2持有的数据
+ * @param string inputFile 输入文件
+ * @return bool true:成功; false:失败
+ */
+static bool run_DO2(Channel* channel, const string &algoName, vector<BIGNUM*> &y, const string &inputFile) {
+    if (isMaskedAlgo(algoName)) {
+        if (!expectInputs(y, maskedInputs_DO2(algoName), inputFile)) {
+            return false;
+        }
+        vector<BIGNUM*> ciphers;
+        if (!channel->recvBIGNUMs(ciphers)) {
+            freeAll(ciphers);
+            return false;
+        }
+        BIGNUM* t = maskedCombine_DO2(algoName, y, ciphers);
+        freeAll(ciphers);
+        if (t == NULL) {
+            return false;
+        }
+        bool ok = channel->sendBIGNUMs(vector<BIGNUM*>(1, t));
+        BN_free(t);
+        return ok;
+    } else if (algoName == "inner_product") {
+        return streamRound_DO2(channel, &y);
+    } else if (algoName == "distance") {
+        vector<BIGNUM*> v = distanceVector(y, PARTY_DO2);
+        bool ok = streamRound_DO2(channel, &v);
+        freeAll(v);
+        return ok;
+    } else if (algoName == "avg") {
+        return streamRound_DO2(channel, NULL);
+    }
+    cerr << "Unable to run " << algoName << " as two parties" << endl;
+    return false;
+}
+
+/**
+ * @Method: 以文本格式输出结果
+ * @param string resultFilePath 输出数据的地址
+ * @param BIGNUM* result 结果
+ * @return 状态码，1：成功；0：失败
+ */
+static int writePartyResult(const string &resultFilePath, BIGNUM* result) {
+    ResultWriter writer(resultFilePath, OUTPUT_TEXT);
+    if (!writer.is_open()) {
+        cerr << "Unable to open file " << resultFilePath << endl;
+        return 0;
+    }
+    writer.writeBIGNUM(result);
+    writer.writeText("\n");
+    if (!writer.close()) {
+        cerr << "Unable to write file " << resultFilePath << endl;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @Method: 以独立进程运行协议的一方，双方通过信道交换二进制帧
+ * @param PartyRole role 角色
+ * @param string algoName 调用的算法名称
+ * @param string uri 信道地址，见openChannel；DO1等待连接，DO2主动连接
+ * @param string inputFile 本方持有的数据，为"-"时没有输入
+ * @param string resultFilePath 输出数据的地址，为空时不输出
+ * @return 状态码，1：成功；0：失败
+ */
+int runParty(PartyRole role, const string &algoName, const string &uri, const string &inputFile, const string &resultFilePath) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<BIGNUM*> data;
+    if (inputFile != "-") {
+        data = readBIGNUMsFromFile(inputFile);
+    }
+
+    // DO1生成密钥的同时DO2等待连接
+    if (role == PARTY_DO1) {
+        InitKeys_PHE(20, 80, 80, 1024, 96448);
+    }
+    Channel* channel = openChannel(uri, role == PARTY_DO1);
+    if (channel == NULL) {
+        freeAll(data);
+        return 0;
+    }
+
+    // 双方交换算法名称，DO1发送公钥
+    uint8_t type;
+    string peerAlgo;
+    bool ok = channel->sendFrame(FRAME_HELLO, algoName)
+              && channel->recvFrame(&type, peerAlgo) && type == FRAME_HELLO;
+    if (ok && peerAlgo != algoName) {
+        cerr << "Peer runs " << peerAlgo << " instead of " << algoName << endl;
+        ok = false;
+    }
+    if (ok) {
+        ok = role == PARTY_DO1 ? channel->sendFrame(FRAME_PUBLIC_KEY, encodePublicKey()) : recvPublicKey(channel);
+    }
+
+    // 协议结束后DO1将结果发给DO2
+    BIGNUM* result = NULL;
+    if (ok && role == PARTY_DO1) {
+        result = run_DO1(channel, algoName, data, inputFile);
+        if (result != NULL) {
+            ok = channel->sendBIGNUMs(vector<BIGNUM*>(1, result));
+        }
+    } else if (ok) {
+        vector<BIGNUM*> message;
+        if (run_DO2(channel, algoName, data, inputFile) && channel->recvBIGNUMs(message) && message.size() == 1) {
+            result = message[0];
+        } else {
+            freeAll(message);
+        }
+    }
+    if (result == NULL) {
+        ok = false;
+        cerr << "Two-party " << algoName << " failed" << endl;
+    }
+
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    printf("%s %s: sent %llu bytes, received %llu bytes, %f ms\n", role == PARTY_DO1 ? "DO1" : "DO2",
+           algoName.c_str(), (unsigned long long) channel->bytesSent(),
+           (unsigned long long) channel->bytesReceived(), elapsed);
+    fflush(stdout);
+    delete channel;
+    freeAll(data);
+
+    int status = ok ? 1 : 0;
+    if (ok && !resultFilePath.empty()) {
+        status = writePartyResult(resultFilePath, result);
+    }
+    BN_free(result);
+    return status;
+}
@@ -0,0 +1,88 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Running one role of a two-party protocol as a separate process
+*/
+
+#ifndef PARTY_H
+#define PARTY_H
+
+#include <bits/stdc++.h>
+#include <openssl/bn.h>
+using namespace std;
+
+// 协议中的角色，DO1持有私钥，DO2只持有公钥
+enum PartyRole {
+    PARTY_DO1,
+    PARTY_DO2
+};
+
+/**
+ * @Method: 编码FRAME_PUBLIC_KEY的内容
+ * @return string 全局参数和公钥
+ */
+string encodePublicKey();
+
+/**
+ * @Method: 解码FRAME_PUBLIC_KEY的内容，设置全局的参数、N和pk
+ * @param string payload 帧内容
+ * @return bool true:成功; false:格式错误
+ */
+bool decodePublicKey(const string &payload);
+
+/**
+ * @Method: 判断算法是否为单轮的混淆比较协议
+ * @param string algoName 算法名称
+ * @return bool true:compare、equal、include或intersect
+ */
+bool isMaskedAlgo(const string &algoName);
+
+/*
+ * 单轮协议分为三步：DO1加密maskedPlains_DO1的结果发给DO2；DO2用maskedCombine_DO2计算并混淆后发回；
+ * DO1解密后用maskedOutcome_DO1得到结果。三步都不涉及通信，可以在任意信道或事件循环中使用
+ */
+
+/**
+ * @Method: 单轮协议中DO1待加密的数
+ * compare: x1；equal、include: -x、x^2；intersect: x1 * x2、-x1、-x2
+ * @param string algoName 算法名称
+ * @param vector<BIGNUM*> x DO1持有的数据
+ * @param vector<BIGNUM*>& plains 待加密的数
+ * @return bool true:成功; false:数据个数不足
+ */
+bool maskedPlains_DO1(const string &algoName, const vector<BIGNUM*> &x, vector<BIGNUM*> &plains);
+
+/**
+ * @Method: 单轮协议中DO2用DO1的密文和自己的数据计算并混淆
+ * @param string algoName 算法名称
+ * @param vector<BIGNUM*> y DO2持有的数据
+ * @param vector<BIGNUM*> E DO1发来的密文
+ * @return BIGNUM* 混淆后的密文，数据或密文个数不对时为NULL
+ */
+BIGNUM* maskedCombine_DO2(const string &algoName, const vector<BIGNUM*> &y, const vector<BIGNUM*> &E);
+
+/**
+ * @Method: 单轮协议中DO1由解密结果得到协议的结果
+ * @param string algoName 算法名称
+ * @param BIGNUM* res 解密结果
+ * @return bool 与compare_PHE、equal_PHE、include_PHE和intersect_PHE的返回值相同
+ */
+bool maskedOutcome_DO1(const string &algoName, const BIGNUM* res);
+
+/**
+ * @Method: 以独立进程运行协议的一方，双方通过信道交换二进制帧
+ * 支持compare、equal、include、intersect、inner_product、distance和avg；
+ * DO1生成密钥并把公钥发给DO2，协议结束后DO1把结果发给DO2，双方各自输出结果。
+ * 各方的输入文件只包含自己持有的数据：
+ * compare、equal为x1 / x2；include为x / y1 y2；intersect为x1 x2 / y1 y2；
+ * inner_product、distance为各自的向量；avg只有DO1有输入，DO2负责求和，输入文件为"-"
+ * @param PartyRole role 角色
+ * @param string algoName 调用的算法名称
+ * @param string uri 信道地址，见openChannel；DO1等待连接，DO2主动连接
+ * @param string inputFile 本方持有的数据，为"-"时没有输入
+ * @param string resultFilePath 输出数据的地址，为空时不输出
+ * @return 状态码，1：成功；0：失败
+ */
+int runParty(PartyRole role, const string &algoName, const string &uri, const string &inputFile, const string &resultFilePath);
+
+#endif //PARTY_H
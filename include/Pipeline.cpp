@@ -0,0 +1,333 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Streaming ingest -> encrypt -> aggregate pipeline
+*/
+
+#include "SHE.h"
+#include "PHE.h"
+#include "Native.h"
+#include "Pipeline.h"
+#include "Executor.h"
+#include <openssl/bn.h>
+using namespace std;
+
+// 每批数据包含的密文个数
+static const size_t BATCH_SIZE = 256;
+
+// 每个加密线程在队列中最多积压的批数
+static const size_t QUEUE_DEPTH = 2;
+
+/**
+ * @Method: 释放一批数据
+ * @param Batch* b 待释放的数据
+ * @return void
+ */
+static void freeBatch(Batch* b) {
+    for (size_t i = 0; i < b->x.size(); i++) {
+        BN_free(b->x[i]);
+    }
+    for (size_t i = 0; i < b->y.size(); i++) {
+        BN_free(b->y[i]);
+    }
+    for (size_t i = 0; i < b->c.size(); i++) {
+        BN_free(b->c[i]);
+    }
+    delete b;
+}
+
+/**
+ * @Method: 运行读取 -> 加密 -> 聚合流水线，各阶段之间通过有界队列连接
+ * @param BIGNUMStream* xs DO1的数据流
+ * @param BIGNUMStream* ys DO2的数据流，不需要时为NULL
+ * @param size_t batchSize 每批读取的数据个数
+ * @param function<void(Batch*)> encrypt 加密阶段，在多个线程中并发执行
+ * @param function<void(Batch*)> aggregate 聚合阶段，在调用线程中按到达顺序执行
+ * @return void
+ */
+static void runPipeline(BIGNUMStream* xs, BIGNUMStream* ys, size_t batchSize,
+                        const function<void(Batch*)> &encrypt, const function<void(Batch*)> &aggregate) {
+    // 读取和聚合各占一个线程，其余线程负责加密
+    int workers = max(1, executor().size() - 2);
+    BoundedQueue<Batch*> plain(QUEUE_DEPTH * workers);
+    BoundedQueue<Batch*> cipher(QUEUE_DEPTH * workers);
+
+    // 读取阶段
+    thread reader([&]() {
+        size_t index = 0;
+        while (true) {
+            Batch* b = new Batch();
+            b->index = index;
+            xs->next(b->x, batchSize);
+            if (ys != NULL) {
+                ys->next(b->y, b->x.size());
+            }
+            if (b->x.empty()) {
+                delete b;
+                break;
+            }
+            index += b->x.size();
+            plain.push(b);
+        }
+        plain.close();
+    });
+
+    // 加密阶段，最后一个退出的线程关闭密文队列
+    atomic<int> running(workers);
+    vector<thread> encryptors;
+    for (int i = 0; i < workers; i++) {
+        encryptors.push_back(thread([&]() {
+            Batch* b;
+            while (plain.pop(b)) {
+                encrypt(b);
+                cipher.push(b);
+            }
+            if (--running == 0) {
+                cipher.close();
+            }
+        }));
+    }
+
+    // 聚合阶段
+    Batch* b;
+    while (cipher.pop(b)) {
+        aggregate(b);
+        freeBatch(b);
+    }
+
+    reader.join();
+    for (size_t i = 0; i < encryptors.size(); i++) {
+        encryptors[i].join();
+    }
+}
+
+/**
+ * @Method: 流水线方式计算均值，读取、加密和求和并发执行，内存占用与数据量无关
+ * @param string fileString 读取数据的地址，所有行的数据都参与计算
+ * @return BIGNUM* avg 均值，读取失败时为NULL
+ */
+BIGNUM* avg_stream_PHE(const string &fileString) {
+    BIGNUMStream xs(fileString, 0);
+    if (!xs.is_open()) {
+        cerr << "Unable to open file " << fileString << endl;
+        return NULL;
+    }
+
+    // 用户1生成公私钥，并将公钥发送给用户2
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+
+    BN_CTX* ctx = localCTX();
+    BIGNUM* sum = BN_new();
+    BN_zero(sum);
+    size_t count = 0;
+
+    runPipeline(&xs, NULL, BATCH_SIZE, [](Batch* b) {
+        // 用户将数据加密并发送给用户2
+        for (size_t i = 0; i < b->x.size(); i++) {
+            b->c.push_back(encrypt_PHE(b->x[i], pk));
+        }
+    }, [&](Batch* b) {
+        // 由用户2来计算所有数据的总和
+        for (size_t i = 0; i < b->c.size(); i++) {
+            BN_add(sum, sum, b->c[i]);
+            BN_mod(sum, sum, N, ctx);
+        }
+        count += b->c.size();
+    });
+
+    // 由用户1利用私钥恢复出sum，然后再计算均值
+    BIGNUM* plain = decrypt_PHE(sum, sk);
+    BIGNUM* avg = BN_new();
+    BIGNUM* temp = BN_new();
+    BN_set_word(temp, count);
+    BN_div(avg, NULL, plain, temp, ctx);
+
+    // 释放临时变量
+    BN_free(sum);
+    BN_free(plain);
+    BN_free(temp);
+    return avg;
+}
+
+/**
+ * @Method: 流水线方式计算内积
+ * @param string fileString 读取数据的地址，第1行为DO1的数据，第2行为DO2的数据
+ * @return BIGNUM* inner_product 内积，读取失败时为NULL
+ */
+BIGNUM* inner_product_stream_PHE(const string &fileString) {
+    BIGNUMStream xs(fileString, 1);
+    BIGNUMStream ys(fileString, 2);
+    if (!xs.is_open() || !ys.is_open()) {
+        cerr << "Unable to open file " << fileString << endl;
+        return NULL;
+    }
+
+    // 用户1生成公私钥，并将公钥发送给用户2
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+
+    BN_CTX* ctx = localCTX();
+    BIGNUM* inner_product = BN_new();
+    BN_zero(inner_product);
+    BIGNUM* t = BN_new();
+
+    runPipeline(&xs, &ys, BATCH_SIZE, [](Batch* b) {
+        // 用户1将持有的数据加密发送给用户2
+        for (size_t i = 0; i < b->x.size(); i++) {
+            b->c.push_back(encrypt_PHE(b->x[i], pk));
+        }
+    }, [&](Batch* b) {
+        // 用户2将收到的密文与自己对应下标的数据相乘并累加
+        size_t n = min(b->c.size(), b->y.size());
+        for (size_t i = 0; i < n; i++) {
+            BN_mul(t, b->c[i], b->y[i], ctx);
+            BN_add(inner_product, inner_product, t);
+        }
+    });
+
+    // 用户1接收 inner_product并解密
+    BIGNUM* result = decrypt_PHE(inner_product, sk);
+
+    // 释放临时变量
+    BN_free(inner_product);
+    BN_free(t);
+    return result;
+}
+
+/**
+ * @Method: 用一批数据更新最小值和最大值
+ * @param vector<BIGNUM*> batch 一批数据
+ * @param BIGNUM** min 当前最小值，尚无数据时为NULL
+ * @param BIGNUM** max 当前最大值，尚无数据时为NULL
+ * @return void
+ */
+static void updateMinMax(const vector<BIGNUM*> &batch, BIGNUM** min, BIGNUM** max) {
+    size_t min_index = 0;
+    size_t max_index = 0;
+    vector<int64_t> native;
+    if (toNative(batch, native)) {
+        minmax_native(native.data(), native.size(), &min_index, &max_index);
+    } else {
+        for (size_t i = 1; i < batch.size(); i++) {
+            if (BN_cmp(batch[i], batch[min_index]) < 0) {
+                min_index = i;
+            }
+            if (BN_cmp(batch[i], batch[max_index]) > 0) {
+                max_index = i;
+            }
+        }
+    }
+
+    if (*min == NULL || BN_cmp(batch[min_index], *min) < 0) {
+        BN_free(*min);
+        *min = BN_dup(batch[min_index]);
+    }
+    if (*max == NULL || BN_cmp(batch[max_index], *max) > 0) {
+        BN_free(*max);
+        *max = BN_dup(batch[max_index]);
+    }
+}
+
+/**
+ * @Method: 逐批扫描文件的某一行，求最小值和最大值
+ * @param string fileString 读取数据的地址
+ * @param int line 扫描的行号
+ * @param BIGNUM** min 最小值
+ * @param BIGNUM** max 最大值
+ * @return bool true:成功; false:该行没有数据
+ */
+bool minmax_stream(const string &fileString, int line, BIGNUM** min, BIGNUM** max) {
+    *min = NULL;
+    *max = NULL;
+    BIGNUMStream scan(fileString, line);
+    vector<BIGNUM*> batch;
+    while (scan.next(batch, BATCH_SIZE) > 0) {
+        updateMinMax(batch, min, max);
+        for (size_t i = 0; i < batch.size(); i++) {
+            BN_free(batch[i]);
+        }
+        batch.clear();
+    }
+    return *min != NULL;
+}
+
+/**
+ * @Method: 流水线方式计算每个分箱数据出现的频率
+ * @param string fileString 读取数据的地址，第1行为分箱个数k，第2行为待分箱的数据
+ * @return vector<BIGNUM*> 分箱频率，读取失败时为空
+ */
+vector<BIGNUM*> frequency_stream_PHE(const string &fileString) {
+    vector<BIGNUM*> frequency;
+
+    // 第1行为分箱个数k
+    vector<BIGNUM*> first;
+    BIGNUMStream ks(fileString, 1);
+    ks.next(first, 1);
+    if (first.empty()) {
+        cerr << "Unable to read k from " << fileString << endl;
+        return frequency;
+    }
+    int k = static_cast<int>(BN_get_word(first[0]));
+    BN_free(first[0]);
+
+    // 第一遍扫描求最小值和最大值，确定分箱范围
+    BIGNUM* min;
+    BIGNUM* max;
+    if (!minmax_stream(fileString, 2, &min, &max)) {
+        cerr << "Unable to read data from " << fileString << endl;
+        return frequency;
+    }
+    vector<Bin> box = makeBins_PHE(min, max, k);
+
+    // 用户1生成公私钥，并将公钥公开
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+
+    BIGNUM* zero = BN_new();
+    BIGNUM* one = BN_new();
+    BN_zero(zero);
+    BN_one(one);
+    vector<BIGNUM*> sums(k);
+    for (int j = 0; j < k; j++) {
+        sums[j] = BN_new();
+        BN_zero(sums[j]);
+    }
+
+    // 第二遍扫描，每批的密文个数与BATCH_SIZE相当
+    size_t batchSize = BATCH_SIZE / k > 0 ? BATCH_SIZE / k : 1;
+    BIGNUMStream xs(fileString, 2);
+    runPipeline(&xs, NULL, batchSize, [&](Batch* b) {
+        // 每个用户构造一个k维的向量，该用户持有数据的对应分箱位标记为1，其余为0，并将向量加密
+        vector<int> bins;
+        binIndex_PHE(b->x, box, bins);
+        for (size_t i = 0; i < b->x.size(); i++) {
+            for (int j = 0; j < k; j++) {
+                BIGNUM* flag = j == bins[i] ? one : zero;
+                // 第2个用户除外
+                b->c.push_back(b->index + i != 1 ? encrypt_PHE(flag, pk) : BN_dup(flag));
+            }
+        }
+    }, [&](Batch* b) {
+        // 用户2接收每个用户发来的k维向量，并累加每个分箱的频率
+        for (size_t i = 0; i < b->x.size(); i++) {
+            for (int j = 0; j < k; j++) {
+                BN_add(sums[j], sums[j], b->c[i * k + j]);
+            }
+        }
+    });
+
+    // 用户1接收分箱频率并解密
+    for (int j = 0; j < k; j++) {
+        frequency.push_back(decrypt_PHE(sums[j], sk));
+        BN_free(sums[j]);
+    }
+
+    // 释放临时变量
+    for (int j = 0; j < k; j++) {
+        BN_free(box[j].lower);
+        BN_free(box[j].upper);
+    }
+    BN_free(min);
+    BN_free(max);
+    BN_free(zero);
+    BN_free(one);
+    return frequency;
+}
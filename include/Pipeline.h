@@ -0,0 +1,119 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Streaming ingest -> encrypt -> aggregate pipeline
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <bits/stdc++.h>
+#include <openssl/bn.h>
+using namespace std;
+
+// 有界阻塞队列，队列满时生产者等待，队列空时消费者等待
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) {
+        this->capacity = capacity;
+        this->closed = false;
+    }
+
+    /**
+     * @Method: 放入一个元素，队列满时等待
+     * @param T item 元素
+     * @return bool true:成功; false:队列已关闭
+     */
+    bool push(T item) {
+        unique_lock<mutex> lock(m);
+        notFull.wait(lock, [this] { return items.size() < capacity || closed; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(item);
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @Method: 取出一个元素，队列空时等待
+     * @param T& item 取出的元素
+     * @return bool true:成功; false:队列已关闭且为空
+     */
+    bool pop(T &item) {
+        unique_lock<mutex> lock(m);
+        notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @Method: 关闭队列，已放入的元素仍可取出
+     * @return void
+     */
+    void close() {
+        lock_guard<mutex> lock(m);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    mutex m;
+    condition_variable notFull;
+    condition_variable notEmpty;
+    deque<T> items;
+    size_t capacity;
+    bool closed;
+};
+
+// 流水线中传递的一批数据
+struct Batch {
+    // 第一个数据在输入中的下标
+    size_t index;
+    // DO1的明文数据
+    vector<BIGNUM*> x;
+    // DO2的明文数据，与x按下标一一对应
+    vector<BIGNUM*> y;
+    // 加密阶段产生的密文
+    vector<BIGNUM*> c;
+};
+
+/**
+ * @Method: 逐批扫描文件的某一行，求最小值和最大值
+ * @param string fileString 读取数据的地址
+ * @param int line 扫描的行号
+ * @param BIGNUM** min 最小值
+ * @param BIGNUM** max 最大值
+ * @return bool true:成功; false:该行没有数据
+ */
+bool minmax_stream(const string &fileString, int line, BIGNUM** min, BIGNUM** max);
+
+/**
+ * @Method: 流水线方式计算均值，读取、加密和求和并发执行，内存占用与数据量无关
+ * @param string fileString 读取数据的地址，所有行的数据都参与计算
+ * @return BIGNUM* avg 均值，读取失败时为NULL
+ */
+BIGNUM* avg_stream_PHE(const string &fileString);
+
+/**
+ * @Method: 流水线方式计算内积
+ * @param string fileString 读取数据的地址，第1行为DO1的数据，第2行为DO2的数据
+ * @return BIGNUM* inner_product 内积，读取失败时为NULL
+ */
+BIGNUM* inner_product_stream_PHE(const string &fileString);
+
+/**
+ * @Method: 流水线方式计算每个分箱数据出现的频率
+ * @param string fileString 读取数据的地址，第1行为分箱个数k，第2行为待分箱的数据
+ * @return vector<BIGNUM*> 分箱频率，读取失败时为空
+ */
+vector<BIGNUM*> frequency_stream_PHE(const string &fileString);
+
+#endif //PIPELINE_H
@@ -14,9 +14,12 @@ using namespace std;
 // 设计一个私钥类
 class PrivateKey {
     public:
-        PrivateKey(BIGNUM* p, BIGNUM* L) {
+        PrivateKey(const BIGNUM* p, const BIGNUM* L) {
             this->p = BN_dup(p);
             this->L = BN_dup(L);
+            // 预先计算解密时使用的L / 2
+            this->half_L = BN_new();
+            BN_rshift1(this->half_L, L);
         }
         BIGNUM* getP() {
             return BN_dup(p);
@@ -24,14 +27,26 @@ class PrivateKey {
         BIGNUM* getL() {
             return BN_dup(L);
         }
+        // 以下三个方法返回私钥内部的数，调用者不能修改或释放，多个线程可以同时读取
+        const BIGNUM* peekP() const {
+            return p;
+        }
+        const BIGNUM* peekL() const {
+            return L;
+        }
+        const BIGNUM* peekHalfL() const {
+            return half_L;
+        }
         ~PrivateKey() {
             BN_free(p);
             BN_free(L);
+            BN_free(half_L);
         }
 
     private:
         BIGNUM* p;
         BIGNUM* L;
+        BIGNUM* half_L;
 };
 
 // 定义安全参数：k_M、k_r、k_L、k_p、k_q
@@ -0,0 +1,940 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Event loop driving many concurrent two-party protocol sessions
+*/
+
+#include "SHE.h"
+#include "PHE.h"
+#include "IO.h"
+#include "Executor.h"
+#include "Transport.h"
+#include "Party.h"
+#include "Session.h"
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using namespace std;
+
+// 单次epoll_wait处理的最大事件数
+static const int MAX_EVENTS = 64;
+
+// 单次从套接字读取的字节数
+static const size_t READ_SIZE = 1 << 16;
+
+// 多路复用连接的发送缓存超过该值时暂停发起新会话
+static const size_t MUX_HIGH_WATERMARK = 4 << 20;
+
+EventLoop::EventLoop() {
+    this->epfd = epoll_create1(EPOLL_CLOEXEC);
+    this->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    this->busy = 0;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFd, &ev);
+}
+
+EventLoop::~EventLoop() {
+    close(wakeFd);
+    close(epfd);
+}
+
+void EventLoop::watch(int fd, uint32_t events, const function<void(uint32_t)> &handler) {
+    handlers[fd] = handler;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void EventLoop::modify(int fd, uint32_t events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void EventLoop::unwatch(int fd) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    handlers.erase(fd);
+}
+
+/**
+ * @Method: 在全局线程池上执行work，完成后在事件循环线程上执行done
+ * @param function<void()> work 计算任务，不能访问只属于事件循环线程的状态
+ * @param function<void()> done 后续处理
+ * @return void
+ */
+void EventLoop::offload(const function<void()> &work, const function<void()> &done) {
+    busy++;
+    executor().post([this, work, done] {
+        work();
+        {
+            lock_guard<mutex> lock(m);
+            completions.push_back(done);
+        }
+        uint64_t one = 1;
+        ssize_t n = write(wakeFd, &one, sizeof(one));
+        (void) n;
+    });
+}
+
+/**
+ * @Method: 执行已完成的offload任务的后续处理
+ * @return void
+ */
+void EventLoop::runCompletions() {
+    uint64_t count;
+    ssize_t n = read(wakeFd, &count, sizeof(count));
+    (void) n;
+    vector<function<void()> > ready;
+    {
+        lock_guard<mutex> lock(m);
+        ready.swap(completions);
+    }
+    for (size_t i = 0; i < ready.size(); i++) {
+        busy--;
+        ready[i]();
+    }
+}
+
+/**
+ * @Method: 当前这批事件处理完、且没有未完成的offload任务时执行fn
+ * @param function<void()> fn 待执行的任务
+ * @return void
+ */
+void EventLoop::whenIdle(const function<void()> &fn) {
+    idle.push_back(fn);
+}
+
+/**
+ * @Method: 没有未完成的offload任务时执行whenIdle安排的任务
+ * @return void
+ */
+void EventLoop::runIdle() {
+    while (busy == 0 && !idle.empty()) {
+        vector<function<void()> > ready;
+        ready.swap(idle);
+        for (size_t i = 0; i < ready.size(); i++) {
+            ready[i]();
+        }
+    }
+}
+
+/**
+ * @Method: 处理事件直到finished()成立
+ * @param function<bool()> finished 结束条件，每处理一批事件后检查
+ * @return void
+ */
+void EventLoop::run(const function<bool()> &finished) {
+    struct epoll_event events[MAX_EVENTS];
+    while (!finished()) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                runCompletions();
+                continue;
+            }
+            // 回调可能取消监视自己，先复制一份
+            map<int, function<void(uint32_t)> >::iterator it = handlers.find(fd);
+            if (it != handlers.end()) {
+                function<void(uint32_t)> handler = it->second;
+                handler(events[i].events);
+            }
+        }
+        runIdle();
+    }
+}
+
+FrameConnection::FrameConnection(EventLoop &loop, int fd) : loop(loop) {
+    this->fd = fd;
+    this->outPos = 0;
+    this->closing = false;
+    this->sent = 0;
+    this->received = 0;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    loop.watch(fd, EPOLLIN, [this](uint32_t events) {
+        onEvents(events);
+    });
+}
+
+FrameConnection::~FrameConnection() {
+    if (fd >= 0) {
+        loop.unwatch(fd);
+        close(fd);
+    }
+}
+
+/**
+ * @Method: 发送一帧，不阻塞
+ * @param uint8_t type 帧类型
+ * @param string payload 帧内容
+ * @return void
+ */
+void FrameConnection::send(uint8_t type, const string &payload) {
+    if (fd < 0) {
+        return;
+    }
+    bool idle = pendingBytes() == 0;
+    out += encodeFrame(type, payload);
+    // 之前没有积压时直接尝试写出，写不完再关注可写事件
+    if (idle && flush() && pendingBytes() > 0) {
+        loop.modify(fd, EPOLLIN | EPOLLOUT);
+    }
+}
+
+/**
+ * @Method: 缓存的数据全部发送后关闭连接
+ * @return void
+ */
+void FrameConnection::closeWhenFlushed() {
+    closing = true;
+    if (fd >= 0 && pendingBytes() == 0) {
+        shutdown();
+    }
+}
+
+void FrameConnection::onEvents(uint32_t events) {
+    if ((events & EPOLLOUT) && flush() && pendingBytes() == 0 && fd >= 0) {
+        if (closing) {
+            shutdown();
+            return;
+        }
+        loop.modify(fd, EPOLLIN);
+        if (onDrained) {
+            onDrained();
+        }
+    }
+    if (fd >= 0 && (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !readFrames()) {
+        shutdown();
+        if (onClose) {
+            onClose();
+        }
+    }
+}
+
+/**
+ * @Method: 读取所有可读的数据并依次处理完整的帧
+ * @return bool true:连接正常; false:对方已关闭或出错
+ */
+bool FrameConnection::readFrames() {
+    char buffer[READ_SIZE];
+    // 对方关闭连接前发出的帧仍然要处理
+    bool eof = false;
+    while (true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            in.append(buffer, n);
+            received += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        eof = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+        break;
+    }
+
+    size_t pos = 0;
+    while (in.size() - pos >= FRAME_HEADER_SIZE) {
+        uint32_t len;
+        memcpy(&len, in.data() + pos, sizeof(len));
+        if (len > MAX_FRAME_SIZE) {
+            return false;
+        }
+        if (in.size() - pos < FRAME_HEADER_SIZE + len) {
+            break;
+        }
+        uint8_t type = in[pos + 4];
+        string payload = in.substr(pos + FRAME_HEADER_SIZE, len);
+        pos += FRAME_HEADER_SIZE + len;
+        if (onFrame) {
+            onFrame(type, payload);
+        }
+        // 处理帧时连接可能已被关闭
+        if (fd < 0) {
+            return true;
+        }
+    }
+    in.erase(0, pos);
+    return !eof;
+}
+
+/**
+ * @Method: 尽量写出缓存的数据
+ * @return bool true:连接正常; false:出错，连接已关闭
+ */
+bool FrameConnection::flush() {
+    while (outPos < out.size()) {
+        ssize_t n = ::send(fd, out.data() + outPos, out.size() - outPos, MSG_NOSIGNAL);
+        if (n > 0) {
+            outPos += n;
+            sent += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        shutdown();
+        if (onClose) {
+            onClose();
+        }
+        return false;
+    }
+    if (outPos == out.size()) {
+        out.clear();
+        outPos = 0;
+    }
+    return true;
+}
+
+/**
+ * @Method: 取消监视并关闭套接字
+ * @return void
+ */
+void FrameConnection::shutdown() {
+    loop.unwatch(fd);
+    close(fd);
+    fd = -1;
+    string().swap(in);
+    string().swap(out);
+    outPos = 0;
+}
+
+RoundBatcher::RoundBatcher(EventLoop &loop, FrameConnection &connection, size_t maxBytes)
+        : loop(loop), connection(connection) {
+    this->maxBytes = maxBytes;
+    this->scheduled = false;
+    this->batchCount = 0;
+    this->messageCount = 0;
+}
+
+/**
+ * @Method: 缓存一个会话的一条消息
+ * @param uint32_t id 会话编号
+ * @param uint8_t type 内层帧类型
+ * @param string payload 内层帧内容
+ * @return void
+ */
+void RoundBatcher::send(uint32_t id, uint8_t type, const string &payload) {
+    appendBatchEntry(batch, id, type, payload);
+    messageCount++;
+    if (batch.size() >= maxBytes) {
+        flush();
+        return;
+    }
+    if (!scheduled) {
+        scheduled = true;
+        loop.whenIdle([this] {
+            scheduled = false;
+            flush();
+        });
+    }
+}
+
+/**
+ * @Method: 立即发出缓存的消息
+ * @return void
+ */
+void RoundBatcher::flush() {
+    if (batch.empty()) {
+        return;
+    }
+    string payload;
+    payload.swap(batch);
+    batchCount++;
+    connection.send(FRAME_BATCH, payload);
+}
+
+MaskedSession::MaskedSession(EventLoop &loop, PartyRole role, const string &algoName, const vector<BIGNUM*> &inputs,
+                             const function<void(uint8_t, const string &)> &send)
+        : loop(loop), inputs(inputs) {
+    this->role = role;
+    this->algoName = algoName;
+    this->send = send;
+    this->state = role == PARTY_DO1 ? BUSY : WAIT_CIPHERS;
+    this->outcome = false;
+    this->aborted = false;
+}
+
+/**
+ * @Method: 开始会话，DO1加密并发送数据，DO2等待密文
+ * @return void
+ */
+void MaskedSession::start() {
+    if (role != PARTY_DO1) {
+        return;
+    }
+    shared_ptr<string> payload = make_shared<string>();
+    loop.offload([this, payload] {
+        vector<BIGNUM*> plains;
+        if (!maskedPlains_DO1(algoName, inputs, plains)) {
+            return;
+        }
+        vector<BIGNUM*> ciphers(plains.size());
+        for (size_t i = 0; i < plains.size(); i++) {
+            ciphers[i] = encrypt_PHE(plains[i], pk);
+            BN_free(plains[i]);
+        }
+        *payload = encodeBIGNUMs(ciphers);
+        for (size_t i = 0; i < ciphers.size(); i++) {
+            BN_free(ciphers[i]);
+        }
+    }, [this, payload] {
+        if (aborted || payload->empty()) {
+            finish(FAILED);
+            return;
+        }
+        state = WAIT_REPLY;
+        send(FRAME_BIGNUMS, *payload);
+    });
+}
+
+/**
+ * @Method: 处理对方发来的一帧
+ * @param uint8_t type 帧类型
+ * @param string payload 帧内容
+ * @return void
+ */
+void MaskedSession::onFrame(uint8_t type, const string &payload) {
+    if (type != FRAME_BIGNUMS || (state != WAIT_REPLY && state != WAIT_CIPHERS && state != WAIT_RESULT)) {
+        finish(FAILED);
+        return;
+    }
+    if (state == WAIT_RESULT) {
+        // DO2收到DO1发来的结果
+        vector<BIGNUM*> values;
+        bool ok = decodeBIGNUMs(payload, values) && values.size() == 1;
+        outcome = ok && BN_is_one(values[0]);
+        for (size_t i = 0; i < values.size(); i++) {
+            BN_free(values[i]);
+        }
+        finish(ok ? DONE : FAILED);
+        return;
+    }
+
+    State received = state;
+    state = BUSY;
+    shared_ptr<string> reply = make_shared<string>();
+    shared_ptr<bool> value = make_shared<bool>(false);
+    loop.offload([this, received, payload, reply, value] {
+        vector<BIGNUM*> values;
+        if (!decodeBIGNUMs(payload, values)) {
+            return;
+        }
+        if (received == WAIT_CIPHERS) {
+            // DO2组合并混淆
+            BIGNUM* t = maskedCombine_DO2(algoName, inputs, values);
+            if (t != NULL) {
+                *reply = encodeBIGNUMs(vector<BIGNUM*>(1, t));
+                BN_free(t);
+            }
+        } else if (values.size() == 1) {
+            // DO1解密
+            BIGNUM* res = decrypt_PHE(values[0], sk);
+            *value = maskedOutcome_DO1(algoName, res);
+            BIGNUM* bit = BN_new();
+            BN_set_word(bit, *value);
+            *reply = encodeBIGNUMs(vector<BIGNUM*>(1, bit));
+            BN_free(bit);
+            BN_free(res);
+        }
+        for (size_t i = 0; i < values.size(); i++) {
+            BN_free(values[i]);
+        }
+    }, [this, received, reply, value] {
+        if (aborted || reply->empty()) {
+            finish(FAILED);
+            return;
+        }
+        // 发送失败时连接中断会中止会话，因此先切换状态再发送
+        if (received == WAIT_CIPHERS) {
+            state = WAIT_RESULT;
+            send(FRAME_BIGNUMS, *reply);
+        } else {
+            outcome = *value;
+            send(FRAME_BIGNUMS, *reply);
+            finish(DONE);
+        }
+    });
+}
+
+/**
+ * @Method: 连接中断时结束会话
+ * @return void
+ */
+void MaskedSession::abort() {
+    if (finished()) {
+        return;
+    }
+    // 正在计算时由offload的后续处理结束会话
+    if (state == BUSY) {
+        aborted = true;
+        return;
+    }
+    finish(FAILED);
+}
+
+void MaskedSession::finish(State end) {
+    if (finished()) {
+        return;
+    }
+    state = end;
+    if (onFinish) {
+        onFinish();
+    }
+}
+
+/**
+ * @Method: 读取每个会话的输入，末尾的空行被忽略
+ * @param string inputFile 输入文件
+ * @return vector<vector<BIGNUM*> > 每个会话的输入
+ */
+static vector<vector<BIGNUM*> > readSessionInputs(const string &inputFile) {
+    vector<vector<BIGNUM*> > rows = readBIGNUMRowsFromFile(inputFile);
+    while (!rows.empty() && rows.back().empty()) {
+        rows.pop_back();
+    }
+    return rows;
+}
+
+/**
+ * @Method: 输出统计信息，所有会话成功时输出结果
+ * @param PartyRole role 角色
+ * @param string algoName 算法名称
+ * @param vector<int> results 每个会话的结果
+ * @param size_t failures 失败的会话数
+ * @param uint64_t sent 发送的字节数
+ * @param uint64_t received 接收的字节数
+ * @param chrono::steady_clock::time_point start 开始时间
+ * @param string resultFilePath 输出数据的地址，为空时不输出
+ * @return 状态码，1：所有会话成功；0：失败
+ */
+static int reportSessions(PartyRole role, const string &algoName, const vector<int> &results, size_t failures,
+                          uint64_t sent, uint64_t received, chrono::steady_clock::time_point start,
+                          const string &resultFilePath) {
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    printf("%s %s: %zu sessions, %zu failed, sent %llu bytes, received %llu bytes, %f ms\n",
+           role == PARTY_DO1 ? "DO1" : "DO2", algoName.c_str(), results.size(), failures,
+           (unsigned long long) sent, (unsigned long long) received, elapsed);
+    fflush(stdout);
+    if (failures > 0) {
+        return 0;
+    }
+    if (!resultFilePath.empty()) {
+        ResultWriter writer(resultFilePath, OUTPUT_TEXT);
+        if (!writer.is_open()) {
+            cerr << "Unable to open file " << resultFilePath << endl;
+            return 0;
+        }
+        for (size_t i = 0; i < results.size(); i++) {
+            writer.writeText(results[i] ? "1\n" : "0\n");
+        }
+        if (!writer.close()) {
+            cerr << "Unable to write file " << resultFilePath << endl;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 一个连接及其上的会话
+struct SessionLink {
+    FrameConnection* connection;
+    MaskedSession* session;
+    // 会话对应的输入行号
+    size_t index;
+    // 会话开始前连接已中断或被拒绝，已计为一个失败的会话
+    bool rejected;
+};
+
+/**
+ * @Method: 在一个事件循环线程上运行大量单轮协议会话，每个会话一个连接
+ * @param PartyRole role 角色
+ * @param string algoName compare、equal、include或intersect
+ * @param string uri unix:/path或tcp:host:port
+ * @param string inputFile 本方持有的数据
+ * @param string resultFilePath 输出数据的地址，为空时不输出
+ * @param int concurrency DO2同时进行的会话数上限
+ * @return 状态码，1：所有会话成功；0：失败
+ */
+int runSessions(PartyRole role, const string &algoName, const string &uri, const string &inputFile,
+                const string &resultFilePath, int concurrency) {
+    if (!isMaskedAlgo(algoName)) {
+        cerr << "Unable to run " << algoName << " as sessions" << endl;
+        return 0;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<vector<BIGNUM*> > rows = readSessionInputs(inputFile);
+    size_t total = rows.size();
+    vector<int> results(total, -1);
+    size_t completed = 0;
+    size_t failures = 0;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    vector<SessionLink*> links;
+    EventLoop loop;
+    size_t open = 0;
+    function<void()> openMore;
+
+    // 会话结束后记录结果，连接在缓存的数据发出后关闭
+    function<void(SessionLink*)> onFinish = [&](SessionLink* link) {
+        completed++;
+        if (link->session->failed()) {
+            failures++;
+        } else {
+            results[link->index] = link->session->result();
+        }
+        link->connection->closeWhenFlushed();
+    };
+    // 会话开始前失败的连接也计为一个失败的会话，否则等待所有会话结束的一方永远等不到
+    function<void(SessionLink*)> rejectLink = [&](SessionLink* link) {
+        if (link->rejected) {
+            return;
+        }
+        link->rejected = true;
+        completed++;
+        failures++;
+        if (role == PARTY_DO2) {
+            open--;
+            openMore();
+        }
+    };
+    function<SessionLink*(int)> addLink = [&](int fd) {
+        SessionLink* link = new SessionLink();
+        link->connection = new FrameConnection(loop, fd);
+        link->session = NULL;
+        link->index = 0;
+        link->rejected = false;
+        links.push_back(link);
+        link->connection->onClose = [&, link] {
+            if (link->session == NULL) {
+                rejectLink(link);
+            } else {
+                link->session->abort();
+            }
+        };
+        return link;
+    };
+    function<void(SessionLink*, size_t)> startSession = [&](SessionLink* link, size_t index) {
+        FrameConnection* connection = link->connection;
+        link->index = index;
+        link->session = new MaskedSession(loop, role, algoName, rows[index], [connection](uint8_t type, const string &payload) {
+            connection->send(type, payload);
+        });
+        link->session->onFinish = [&, link] {
+            onFinish(link);
+        };
+        link->session->start();
+    };
+
+    int server = -1;
+    size_t nextIndex = 0;
+    string keyPayload;
+    vector<bool> started(total, false);
+    if (role == PARTY_DO1) {
+        // DO1生成密钥，对每个连接回复同一个公钥
+        setKeyReuse_PHE(true);
+        InitKeys_PHE(20, 80, 80, 1024, 96448);
+        keyPayload = encodePublicKey();
+        server = listenSocket(uri, SOMAXCONN);
+        if (server < 0) {
+            cerr << "Unable to listen on " << uri << endl;
+            return 0;
+        }
+        fcntl(server, F_SETFL, fcntl(server, F_GETFL) | O_NONBLOCK);
+        loop.watch(server, EPOLLIN, [&](uint32_t) {
+            int fd;
+            while ((fd = acceptSocket(server)) >= 0) {
+                SessionLink* link = addLink(fd);
+                link->connection->onFrame = [&, link](uint8_t type, const string &payload) {
+                    if (link->session != NULL) {
+                        link->session->onFrame(type, payload);
+                        return;
+                    }
+                    // 第一帧为FRAME_HELLO，内容为算法名称和行号
+                    size_t newline = payload.find('\n');
+                    size_t index = newline == string::npos ? total : strtoul(payload.c_str() + newline + 1, NULL, 10);
+                    if (type != FRAME_HELLO || payload.substr(0, newline) != algoName || index >= total || started[index]) {
+                        cerr << "Unexpected session request" << endl;
+                        link->connection->closeWhenFlushed();
+                        rejectLink(link);
+                        return;
+                    }
+                    started[index] = true;
+                    link->connection->send(FRAME_PUBLIC_KEY, keyPayload);
+                    startSession(link, index);
+                };
+            }
+        });
+    } else {
+        // DO2保持最多concurrency个会话同时进行，一个结束后再建立下一个连接
+        openMore = [&] {
+            while (open < (size_t) max(1, concurrency) && nextIndex < total) {
+                size_t index = nextIndex++;
+                int fd = connectSocket(uri);
+                if (fd < 0) {
+                    cerr << "Unable to connect " << uri << endl;
+                    completed++;
+                    failures++;
+                    continue;
+                }
+                open++;
+                SessionLink* link = addLink(fd);
+                link->connection->onFrame = [&, link, index](uint8_t type, const string &payload) {
+                    if (link->session != NULL) {
+                        link->session->onFrame(type, payload);
+                        return;
+                    }
+                    // 所有连接收到的公钥相同，只在第一次设置
+                    if (type != FRAME_PUBLIC_KEY || (keyPayload.empty() && !decodePublicKey(payload))
+                        || (!keyPayload.empty() && payload != keyPayload)) {
+                        cerr << "Unexpected public key" << endl;
+                        link->connection->closeWhenFlushed();
+                        rejectLink(link);
+                        return;
+                    }
+                    keyPayload = payload;
+                    startSession(link, index);
+                };
+                link->connection->send(FRAME_HELLO, algoName + "\n" + to_string(index));
+            }
+        };
+        function<void(SessionLink*)> finishLink = onFinish;
+        onFinish = [&, finishLink](SessionLink* link) {
+            finishLink(link);
+            open--;
+            openMore();
+        };
+        openMore();
+    }
+
+    loop.run([&] {
+        return completed >= total;
+    });
+
+    // 等待最后的结果帧发出
+    loop.run([&] {
+        for (size_t i = 0; i < links.size(); i++) {
+            if (!links[i]->connection->closed() && links[i]->connection->pendingBytes() > 0) {
+                return false;
+            }
+        }
+        return true;
+    });
+    for (size_t i = 0; i < links.size(); i++) {
+        sent += links[i]->connection->bytesSent();
+        received += links[i]->connection->bytesReceived();
+        delete links[i]->connection;
+        delete links[i]->session;
+        delete links[i];
+    }
+    if (server >= 0) {
+        loop.unwatch(server);
+        close(server);
+        if (uri.compare(0, 5, "unix:") == 0) {
+            unlink(uri.substr(5).c_str());
+        }
+    }
+
+    return reportSessions(role, algoName, results, failures, sent, received, start, resultFilePath);
+}
+
+/**
+ * @Method: 在一个多路复用的连接上运行大量单轮协议会话
+ * @param PartyRole role 角色
+ * @param string algoName compare、equal、include或intersect
+ * @param string uri unix:/path或tcp:host:port
+ * @param string inputFile 本方持有的数据
+ * @param string resultFilePath 输出数据的地址，为空时不输出
+ * @param int window DO1同时进行的会话数上限
+ * @param size_t batchBytes 合并帧的最大长度，为0时每条消息单独发送
+ * @return 状态码，1：所有会话成功；0：失败
+ */
+int runMultiplexed(PartyRole role, const string &algoName, const string &uri, const string &inputFile,
+                   const string &resultFilePath, int window, size_t batchBytes) {
+    if (!isMaskedAlgo(algoName)) {
+        cerr << "Unable to run " << algoName << " as sessions" << endl;
+        return 0;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<vector<BIGNUM*> > rows = readSessionInputs(inputFile);
+    size_t total = rows.size();
+    vector<int> results(total, -1);
+
+    string keyPayload;
+    int fd;
+    if (role == PARTY_DO1) {
+        InitKeys_PHE(20, 80, 80, 1024, 96448);
+        keyPayload = encodePublicKey();
+        int server = listenSocket(uri, 1);
+        if (server < 0) {
+            cerr << "Unable to listen on " << uri << endl;
+            return 0;
+        }
+        fd = acceptSocket(server);
+        close(server);
+        if (uri.compare(0, 5, "unix:") == 0) {
+            unlink(uri.substr(5).c_str());
+        }
+    } else {
+        fd = connectSocket(uri);
+    }
+    if (fd < 0) {
+        cerr << "Unable to connect " << uri << endl;
+        return 0;
+    }
+
+    EventLoop loop;
+    FrameConnection connection(loop, fd);
+    RoundBatcher batcher(loop, connection, batchBytes);
+    vector<MaskedSession*> sessions(total, NULL);
+    size_t completed = 0;
+    size_t failures = 0;
+    size_t nextIndex = 0;
+    size_t inFlight = 0;
+    size_t limit = max(1, window);
+    // 公钥协商完成
+    bool ready = false;
+    // 连接已中断或出现协议错误
+    bool lost = false;
+
+    function<void()> startMore;
+    function<MaskedSession*(size_t)> addSession = [&](size_t index) {
+        uint32_t id = index;
+        MaskedSession* session = new MaskedSession(loop, role, algoName, rows[index], [&, id](uint8_t type, const string &payload) {
+            if (batchBytes > 0) {
+                batcher.send(id, type, payload);
+            } else {
+                connection.send(FRAME_SESSION, encodeSessionFrame(id, type, payload));
+            }
+        });
+        session->onFinish = [&, index] {
+            completed++;
+            inFlight--;
+            if (sessions[index]->failed()) {
+                failures++;
+            } else {
+                results[index] = sessions[index]->result();
+            }
+            startMore();
+        };
+        sessions[index] = session;
+        inFlight++;
+        return session;
+    };
+    // DO1发起新会话，受在途会话数和发送缓存的高水位限制
+    startMore = [&] {
+        if (role != PARTY_DO1 || !ready || lost) {
+            return;
+        }
+        while (inFlight < limit && nextIndex < total && connection.pendingBytes() < MUX_HIGH_WATERMARK) {
+            addSession(nextIndex++)->start();
+        }
+    };
+    // 连接不能继续使用时，未开始的会话记为失败，进行中的会话中止
+    function<void()> abandon = [&] {
+        if (lost) {
+            return;
+        }
+        lost = true;
+        connection.closeWhenFlushed();
+        for (size_t i = 0; i < total; i++) {
+            if (sessions[i] == NULL) {
+                completed++;
+                failures++;
+            } else {
+                sessions[i]->abort();
+            }
+        }
+    };
+
+    // 把一条消息交给对应的会话，DO2在收到会话的第一条消息时创建会话
+    function<bool(const BatchEntry &)> deliver = [&](const BatchEntry &entry) {
+        if (entry.id >= total || (sessions[entry.id] == NULL && role == PARTY_DO1)) {
+            return false;
+        }
+        if (sessions[entry.id] == NULL) {
+            addSession(entry.id)->start();
+        }
+        sessions[entry.id]->onFrame(entry.type, entry.payload);
+        return true;
+    };
+
+    connection.onDrained = startMore;
+    connection.onClose = abandon;
+    connection.onFrame = [&](uint8_t type, const string &payload) {
+        if (lost) {
+            return;
+        }
+        if (!ready) {
+            // DO1收到FRAME_HELLO（算法名称和会话数），DO2收到FRAME_PUBLIC_KEY
+            if (role == PARTY_DO1) {
+                size_t newline = payload.find('\n');
+                if (type != FRAME_HELLO || newline == string::npos || payload.substr(0, newline) != algoName
+                    || strtoul(payload.c_str() + newline + 1, NULL, 10) != total) {
+                    cerr << "Unexpected session request" << endl;
+                    abandon();
+                    return;
+                }
+                connection.send(FRAME_PUBLIC_KEY, keyPayload);
+            } else if (type != FRAME_PUBLIC_KEY || !decodePublicKey(payload)) {
+                cerr << "Unexpected public key" << endl;
+                abandon();
+                return;
+            }
+            ready = true;
+            startMore();
+            return;
+        }
+        vector<BatchEntry> entries;
+        bool ok = false;
+        if (type == FRAME_SESSION) {
+            entries.resize(1);
+            ok = decodeSessionFrame(payload, &entries[0].id, &entries[0].type, entries[0].payload);
+        } else if (type == FRAME_BATCH) {
+            ok = decodeBatch(payload, entries);
+        }
+        // 交给会话时连接可能中断
+        for (size_t i = 0; ok && !lost && i < entries.size(); i++) {
+            ok = deliver(entries[i]);
+        }
+        if (!ok) {
+            cerr << "Unexpected session frame" << endl;
+            abandon();
+        }
+    };
+    if (role == PARTY_DO2) {
+        connection.send(FRAME_HELLO, algoName + "\n" + to_string(total));
+    }
+
+    loop.run([&] {
+        return completed >= total;
+    });
+    // 等待最后的结果帧发出
+    batcher.flush();
+    connection.closeWhenFlushed();
+    loop.run([&] {
+        return connection.closed();
+    });
+    if (batchBytes > 0) {
+        printf("%llu messages in %llu batches\n", (unsigned long long) batcher.messages(),
+               (unsigned long long) batcher.batches());
+    }
+    uint64_t sent = connection.bytesSent();
+    uint64_t received = connection.bytesReceived();
+    for (size_t i = 0; i < total; i++) {
+        delete sessions[i];
+    }
+    return reportSessions(role, algoName, results, failures, sent, received, start, resultFilePath);
+}
@@ -0,0 +1,314 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Event loop driving many concurrent two-party protocol sessions
+*/
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <bits/stdc++.h>
+#include <openssl/bn.h>
+#include "Party.h"
+using namespace std;
+
+/*
+ * 单线程的epoll事件循环。会话在等待对方的消息时不占用线程，
+ * 加密、组合和解密等计算通过offload()交给全局线程池，完成后回到事件循环线程继续，
+ * 因此一个事件循环线程可以同时推进大量会话。除offload()的work外，所有回调都在事件循环线程上执行
+ */
+class EventLoop {
+public:
+    EventLoop();
+
+    ~EventLoop();
+
+    /**
+     * @Method: 监视文件描述符
+     * @param int fd 文件描述符
+     * @param uint32_t events 关注的epoll事件
+     * @param function<void(uint32_t)> handler 事件发生时调用，参数为发生的事件
+     * @return void
+     */
+    void watch(int fd, uint32_t events, const function<void(uint32_t)> &handler);
+
+    /**
+     * @Method: 修改关注的事件
+     * @param int fd 文件描述符
+     * @param uint32_t events 关注的epoll事件
+     * @return void
+     */
+    void modify(int fd, uint32_t events);
+
+    /**
+     * @Method: 取消监视
+     * @param int fd 文件描述符
+     * @return void
+     */
+    void unwatch(int fd);
+
+    /**
+     * @Method: 在全局线程池上执行work，完成后在事件循环线程上执行done
+     * @param function<void()> work 计算任务，不能访问只属于事件循环线程的状态
+     * @param function<void()> done 后续处理
+     * @return void
+     */
+    void offload(const function<void()> &work, const function<void()> &done);
+
+    /**
+     * @Method: 当前这批事件处理完、且没有未完成的offload任务时执行fn
+     * @param function<void()> fn 待执行的任务
+     * @return void
+     */
+    void whenIdle(const function<void()> &fn);
+
+    /**
+     * @Method: 处理事件直到finished()成立
+     * @param function<bool()> finished 结束条件，每处理一批事件后检查
+     * @return void
+     */
+    void run(const function<bool()> &finished);
+
+private:
+    int epfd;
+    // offload的任务完成后写入wakeFd唤醒事件循环
+    int wakeFd;
+    mutex m;
+    vector<function<void()> > completions;
+    map<int, function<void(uint32_t)> > handlers;
+    // 已提交但后续处理尚未执行的offload任务数，只在事件循环线程上访问
+    size_t busy;
+    vector<function<void()> > idle;
+
+    void runCompletions();
+    void runIdle();
+};
+
+// 非阻塞套接字上的帧读写，帧格式与Channel相同；写不完的数据缓存起来，可写时继续发送
+class FrameConnection {
+public:
+    /**
+     * @param EventLoop& loop 事件循环
+     * @param int fd 已连接的套接字，由FrameConnection负责关闭
+     */
+    FrameConnection(EventLoop &loop, int fd);
+
+    ~FrameConnection();
+
+    // 收到一帧时调用
+    function<void(uint8_t, const string &)> onFrame;
+
+    // 对方关闭连接或出错时调用，之后连接已关闭
+    function<void()> onClose;
+
+    // 积压的数据全部写入套接字后调用，用于发送方的流量控制
+    function<void()> onDrained;
+
+    /**
+     * @Method: 发送一帧，不阻塞
+     * @param uint8_t type 帧类型
+     * @param string payload 帧内容
+     * @return void
+     */
+    void send(uint8_t type, const string &payload);
+
+    /**
+     * @Method: 缓存的数据全部发送后关闭连接
+     * @return void
+     */
+    void closeWhenFlushed();
+
+    bool closed() {
+        return fd < 0;
+    }
+
+    // 尚未写入套接字的字节数
+    size_t pendingBytes() {
+        return out.size() - outPos;
+    }
+
+    uint64_t bytesSent() {
+        return sent;
+    }
+
+    uint64_t bytesReceived() {
+        return received;
+    }
+
+private:
+    EventLoop &loop;
+    int fd;
+    string in;
+    string out;
+    size_t outPos;
+    bool closing;
+    uint64_t sent;
+    uint64_t received;
+
+    void onEvents(uint32_t events);
+    bool readFrames();
+    bool flush();
+    void shutdown();
+};
+
+/*
+ * 把同一方向上各会话的消息合并为FRAME_BATCH发送。消息先缓存起来，等事件循环上没有未完成的计算，
+ * 即这一轮能产生的消息都已产生时一次发出，往返次数因此只与协议的轮数有关；缓存超过maxBytes时提前发出
+ */
+class RoundBatcher {
+public:
+    /**
+     * @param EventLoop& loop 事件循环
+     * @param FrameConnection& connection 连接
+     * @param size_t maxBytes 一帧的最大长度
+     */
+    RoundBatcher(EventLoop &loop, FrameConnection &connection, size_t maxBytes);
+
+    /**
+     * @Method: 缓存一个会话的一条消息
+     * @param uint32_t id 会话编号
+     * @param uint8_t type 内层帧类型
+     * @param string payload 内层帧内容
+     * @return void
+     */
+    void send(uint32_t id, uint8_t type, const string &payload);
+
+    /**
+     * @Method: 立即发出缓存的消息
+     * @return void
+     */
+    void flush();
+
+    uint64_t batches() {
+        return batchCount;
+    }
+
+    uint64_t messages() {
+        return messageCount;
+    }
+
+private:
+    EventLoop &loop;
+    FrameConnection &connection;
+    size_t maxBytes;
+    string batch;
+    // 已通过whenIdle安排发送
+    bool scheduled;
+    uint64_t batchCount;
+    uint64_t messageCount;
+};
+
+/*
+ * 一个单轮协议（compare、equal、include、intersect）的会话，与具体的连接无关。
+ * DO1：加密并发送 -> 等待DO2的结果 -> 解密并把结果发给DO2；DO2：等待密文 -> 组合、混淆并发回 -> 等待结果
+ */
+class MaskedSession {
+public:
+    /**
+     * @param EventLoop& loop 事件循环
+     * @param PartyRole role 角色
+     * @param string algoName 算法名称
+     * @param vector<BIGNUM*> inputs 本方持有的数据，会话结束前不能释放
+     * @param function<void(uint8_t, const string&)> send 发送一帧
+     */
+    MaskedSession(EventLoop &loop, PartyRole role, const string &algoName, const vector<BIGNUM*> &inputs,
+                  const function<void(uint8_t, const string &)> &send);
+
+    // 会话结束时调用
+    function<void()> onFinish;
+
+    /**
+     * @Method: 开始会话，DO1加密并发送数据，DO2等待密文
+     * @return void
+     */
+    void start();
+
+    /**
+     * @Method: 处理对方发来的一帧
+     * @param uint8_t type 帧类型
+     * @param string payload 帧内容
+     * @return void
+     */
+    void onFrame(uint8_t type, const string &payload);
+
+    /**
+     * @Method: 连接中断时结束会话
+     * @return void
+     */
+    void abort();
+
+    bool finished() {
+        return state == DONE || state == FAILED;
+    }
+
+    bool failed() {
+        return state == FAILED;
+    }
+
+    bool result() {
+        return outcome;
+    }
+
+private:
+    enum State {
+        // 正在计算，等待offload完成
+        BUSY,
+        // DO1等待DO2的混淆结果
+        WAIT_REPLY,
+        // DO2等待DO1的密文
+        WAIT_CIPHERS,
+        // DO2等待DO1发来的结果
+        WAIT_RESULT,
+        DONE,
+        FAILED
+    };
+
+    EventLoop &loop;
+    PartyRole role;
+    string algoName;
+    const vector<BIGNUM*> &inputs;
+    function<void(uint8_t, const string &)> send;
+    State state;
+    bool outcome;
+    // 计算期间连接中断，计算完成后以失败结束
+    bool aborted;
+
+    void finish(State end);
+};
+
+/**
+ * @Method: 在一个事件循环线程上运行大量单轮协议会话，每个会话一个连接
+ * 输入文件的每一行是一个会话中本方持有的数据。DO1监听uri，DO2最多同时建立concurrency个连接；
+ * 每个连接先由DO2发送FRAME_HELLO（算法名称和行号），DO1回复FRAME_PUBLIC_KEY后开始会话。
+ * 双方输出每个会话的结果，每行一个，1为true，0为false
+ * @param PartyRole role 角色
+ * @param string algoName compare、equal、include或intersect
+ * @param string uri unix:/path或tcp:host:port
+ * @param string inputFile 本方持有的数据
+ * @param string resultFilePath 输出数据的地址，为空时不输出
+ * @param int concurrency DO2同时进行的会话数上限
+ * @return 状态码，1：所有会话成功；0：失败
+ */
+int runSessions(PartyRole role, const string &algoName, const string &uri, const string &inputFile,
+                const string &resultFilePath, int concurrency = 256);
+
+/**
+ * @Method: 在一个多路复用的连接上运行大量单轮协议会话
+ * 输入文件的每一行是一个会话中本方持有的数据，会话编号为行号。DO1监听uri，DO2建立一个连接，
+ * 先由DO2发送FRAME_HELLO（算法名称和会话数），DO1回复FRAME_PUBLIC_KEY，整个连接只协商一次公钥；
+ * 之后各会话的帧都封装为FRAME_SESSION交错发送。DO1发起会话，在途会话数不超过window，
+ * 发送缓存超过高水位时暂停发起新会话，直到积压的数据写出。batchBytes大于0时各会话同一轮的消息
+ * 由RoundBatcher合并为FRAME_BATCH发送。双方输出每个会话的结果，每行一个
+ * @param PartyRole role 角色
+ * @param string algoName compare、equal、include或intersect
+ * @param string uri unix:/path或tcp:host:port
+ * @param string inputFile 本方持有的数据
+ * @param string resultFilePath 输出数据的地址，为空时不输出
+ * @param int window DO1同时进行的会话数上限
+ * @param size_t batchBytes 合并帧的最大长度，为0时每条消息单独发送
+ * @return 状态码，1：所有会话成功；0：失败
+ */
+int runMultiplexed(PartyRole role, const string &algoName, const string &uri, const string &inputFile,
+                   const string &resultFilePath, int window = 1024, size_t batchBytes = 1 << 24);
+
+#endif //SESSION_H
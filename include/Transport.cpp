@@ -0,0 +1,642 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Transports and binary framing between two parties
+*/
+
+#include "Transport.h"
+#include <openssl/bn.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+// 连接对方时的最长等待时间，对方可能正在生成密钥
+static const int CONNECT_TIMEOUT_MS = 60000;
+
+// 连接失败后重试的间隔
+static const int RETRY_INTERVAL_MS = 50;
+
+// 共享内存中每个方向的环形缓冲区大小
+static const size_t SHM_RING_SIZE = 1 << 22;
+
+// 共享内存的魔数，创建者初始化完成后写入
+static const uint32_t SHM_MAGIC = 0x44445348;
+
+Channel::Channel() {
+    this->sent = 0;
+    this->received = 0;
+}
+
+/**
+ * @Method: 发送一帧
+ * @param uint8_t type 帧类型
+ * @param string payload 帧内容
+ * @return bool true:成功; false:连接已断开
+ */
+bool Channel::sendFrame(uint8_t type, const string &payload) {
+    // 帧头和内容一起写出，避免小包
+    string frame = encodeFrame(type, payload);
+    if (!writeAll(frame.data(), frame.size())) {
+        return false;
+    }
+    sent += frame.size();
+    return true;
+}
+
+/**
+ * @Method: 接收一帧
+ * @param uint8_t* type 帧类型
+ * @param string& payload 帧内容
+ * @return bool true:成功; false:连接已断开或帧过长
+ */
+bool Channel::recvFrame(uint8_t* type, string &payload) {
+    unsigned char header[FRAME_HEADER_SIZE];
+    if (!readAll(header, sizeof(header))) {
+        return false;
+    }
+    uint32_t len;
+    memcpy(&len, header, sizeof(len));
+    if (len > MAX_FRAME_SIZE) {
+        return false;
+    }
+    *type = header[4];
+    payload.resize(len);
+    if (len > 0 && !readAll(&payload[0], len)) {
+        return false;
+    }
+    received += sizeof(header) + len;
+    return true;
+}
+
+/**
+ * @Method: 发送一组BIGNUM
+ * @param vector<BIGNUM*> values 待发送的数
+ * @return bool true:成功; false:连接已断开
+ */
+bool Channel::sendBIGNUMs(const vector<BIGNUM*> &values) {
+    return sendFrame(FRAME_BIGNUMS, encodeBIGNUMs(values));
+}
+
+/**
+ * @Method: 接收一组BIGNUM
+ * @param vector<BIGNUM*>& values 接收的数追加到values末尾
+ * @return bool true:成功; false:连接已断开或收到的不是FRAME_BIGNUMS
+ */
+bool Channel::recvBIGNUMs(vector<BIGNUM*> &values) {
+    uint8_t type;
+    string payload;
+    if (!recvFrame(&type, payload) || type != FRAME_BIGNUMS) {
+        return false;
+    }
+    return decodeBIGNUMs(payload, values);
+}
+
+/**
+ * @Method: 编码一帧，见文件开头的帧格式
+ * @param uint8_t type 帧类型
+ * @param string payload 帧内容
+ * @return string 帧头和帧内容
+ */
+string encodeFrame(uint8_t type, const string &payload) {
+    string frame(FRAME_HEADER_SIZE, '\0');
+    uint32_t len = payload.size();
+    memcpy(&frame[0], &len, sizeof(len));
+    frame[4] = (char) type;
+    frame += payload;
+    return frame;
+}
+
+/**
+ * @Method: 将一组BIGNUM编码为FRAME_BIGNUMS的内容
+ * @param vector<BIGNUM*> values 待编码的数
+ * @return string 编码结果
+ */
+string encodeBIGNUMs(const vector<BIGNUM*> &values) {
+    size_t size = sizeof(uint32_t);
+    for (size_t i = 0; i < values.size(); i++) {
+        size += 1 + sizeof(uint32_t) + BN_num_bytes(values[i]);
+    }
+    string payload(size, '\0');
+    char* p = &payload[0];
+    uint32_t count = values.size();
+    memcpy(p, &count, sizeof(count));
+    p += sizeof(count);
+    for (size_t i = 0; i < values.size(); i++) {
+        uint32_t bytes = BN_num_bytes(values[i]);
+        *p++ = BN_is_negative(values[i]) ? 1 : 0;
+        memcpy(p, &bytes, sizeof(bytes));
+        p += sizeof(bytes);
+        BN_bn2bin(values[i], (unsigned char*) p);
+        p += bytes;
+    }
+    return payload;
+}
+
+/**
+ * @Method: 解码FRAME_BIGNUMS的内容
+ * @param string payload 帧内容
+ * @param vector<BIGNUM*>& values 解码的数追加到values末尾
+ * @return bool true:成功; false:格式错误
+ */
+bool decodeBIGNUMs(const string &payload, vector<BIGNUM*> &values) {
+    const char* p = payload.data();
+    const char* end = p + payload.size();
+    uint32_t count;
+    if (end - p < (ptrdiff_t) sizeof(count)) {
+        return false;
+    }
+    memcpy(&count, p, sizeof(count));
+    p += sizeof(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t bytes;
+        if (end - p < (ptrdiff_t) (1 + sizeof(bytes))) {
+            return false;
+        }
+        bool negative = *p++ == 1;
+        memcpy(&bytes, p, sizeof(bytes));
+        p += sizeof(bytes);
+        if ((size_t) (end - p) < bytes) {
+            return false;
+        }
+        BIGNUM* bn = BN_bin2bn((const unsigned char*) p, bytes, NULL);
+        BN_set_negative(bn, negative);
+        values.push_back(bn);
+        p += bytes;
+    }
+    return true;
+}
+
+/**
+ * @Method: 编码FRAME_SESSION的内容
+ * @param uint32_t id 会话编号
+ * @param uint8_t type 内层帧类型
+ * @param string payload 内层帧内容
+ * @return string 编码结果
+ */
+string encodeSessionFrame(uint32_t id, uint8_t type, const string &payload) {
+    string frame(sizeof(id) + 1, '\0');
+    memcpy(&frame[0], &id, sizeof(id));
+    frame[sizeof(id)] = (char) type;
+    frame += payload;
+    return frame;
+}
+
+/**
+ * @Method: 解码FRAME_SESSION的内容
+ * @param string payload 帧内容
+ * @param uint32_t* id 会话编号
+ * @param uint8_t* type 内层帧类型
+ * @param string& inner 内层帧内容
+ * @return bool true:成功; false:格式错误
+ */
+bool decodeSessionFrame(const string &payload, uint32_t* id, uint8_t* type, string &inner) {
+    if (payload.size() < sizeof(*id) + 1) {
+        return false;
+    }
+    memcpy(id, payload.data(), sizeof(*id));
+    *type = payload[sizeof(*id)];
+    inner = payload.substr(sizeof(*id) + 1);
+    return true;
+}
+
+/**
+ * @Method: 在FRAME_BATCH的内容末尾追加一条消息
+ * @param string& batch 帧内容
+ * @param uint32_t id 会话编号
+ * @param uint8_t type 内层帧类型
+ * @param string payload 内层帧内容
+ * @return void
+ */
+void appendBatchEntry(string &batch, uint32_t id, uint8_t type, const string &payload) {
+    char header[sizeof(uint32_t) * 2 + 1];
+    uint32_t len = payload.size();
+    memcpy(header, &id, sizeof(id));
+    header[sizeof(id)] = (char) type;
+    memcpy(header + sizeof(id) + 1, &len, sizeof(len));
+    batch.append(header, sizeof(header));
+    batch += payload;
+}
+
+/**
+ * @Method: 解码FRAME_BATCH的内容
+ * @param string payload 帧内容
+ * @param vector<BatchEntry>& entries 解码的消息追加到entries末尾
+ * @return bool true:成功; false:格式错误
+ */
+bool decodeBatch(const string &payload, vector<BatchEntry> &entries) {
+    const size_t headerSize = sizeof(uint32_t) * 2 + 1;
+    size_t pos = 0;
+    while (pos < payload.size()) {
+        if (payload.size() - pos < headerSize) {
+            return false;
+        }
+        BatchEntry entry;
+        uint32_t len;
+        memcpy(&entry.id, payload.data() + pos, sizeof(entry.id));
+        entry.type = payload[pos + sizeof(entry.id)];
+        memcpy(&len, payload.data() + pos + sizeof(entry.id) + 1, sizeof(len));
+        pos += headerSize;
+        if (payload.size() - pos < len) {
+            return false;
+        }
+        entry.payload = payload.substr(pos, len);
+        pos += len;
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+SocketChannel::SocketChannel(int fd) {
+    this->fd = fd;
+}
+
+SocketChannel::~SocketChannel() {
+    close(fd);
+}
+
+bool SocketChannel::writeAll(const void* data, size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool SocketChannel::readAll(void* data, size_t len) {
+    char* p = static_cast<char*>(data);
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 单方向的环形缓冲区，head只由写入方修改，tail只由读取方修改
+struct ShmRing {
+    uint64_t head;
+    uint64_t tail;
+    char data[SHM_RING_SIZE];
+};
+
+struct ShmSegment {
+    uint32_t magic;
+    // 连接者打开共享内存后置1
+    uint32_t connected;
+    // 第i方关闭信道后置1
+    uint32_t closed[2];
+    ShmRing rings[2];
+};
+
+/**
+ * @Method: 等待对方读写，先让出CPU，多次仍未就绪时短暂休眠
+ * @param int* spins 已等待的次数
+ * @return void
+ */
+static void backoff(int* spins) {
+    if (++(*spins) < 1000) {
+        sched_yield();
+    } else {
+        usleep(50);
+    }
+}
+
+ShmChannel::ShmChannel(ShmSegment* segment, int side) {
+    this->segment = segment;
+    this->side = side;
+}
+
+ShmChannel::~ShmChannel() {
+    __atomic_store_n(&segment->closed[side], 1, __ATOMIC_RELEASE);
+    munmap(segment, sizeof(ShmSegment));
+}
+
+bool ShmChannel::writeAll(const void* data, size_t len) {
+    ShmRing &ring = segment->rings[side];
+    const char* p = static_cast<const char*>(data);
+    int spins = 0;
+    while (len > 0) {
+        uint64_t head = ring.head;
+        uint64_t tail = __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE);
+        size_t space = SHM_RING_SIZE - (head - tail);
+        if (space == 0) {
+            // 对方可能在读走数据后才关闭，看到关闭标志后重新读取tail，仍没有空间时才失败
+            if (__atomic_load_n(&segment->closed[1 - side], __ATOMIC_ACQUIRE)
+                && __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) == tail) {
+                return false;
+            }
+            backoff(&spins);
+            continue;
+        }
+        size_t offset = head % SHM_RING_SIZE;
+        size_t n = min(len, min(space, SHM_RING_SIZE - offset));
+        memcpy(ring.data + offset, p, n);
+        __atomic_store_n(&ring.head, head + n, __ATOMIC_RELEASE);
+        p += n;
+        len -= n;
+        spins = 0;
+    }
+    return true;
+}
+
+bool ShmChannel::readAll(void* data, size_t len) {
+    ShmRing &ring = segment->rings[1 - side];
+    char* p = static_cast<char*>(data);
+    int spins = 0;
+    while (len > 0) {
+        uint64_t tail = ring.tail;
+        uint64_t head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+        size_t avail = head - tail;
+        if (avail == 0) {
+            // 对方可能在两次读取之间写入最后一帧并关闭，看到关闭标志后重新读取head，仍没有数据时才失败
+            if (__atomic_load_n(&segment->closed[1 - side], __ATOMIC_ACQUIRE)
+                && __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE) == head) {
+                return false;
+            }
+            backoff(&spins);
+            continue;
+        }
+        size_t offset = tail % SHM_RING_SIZE;
+        size_t n = min(len, min(avail, SHM_RING_SIZE - offset));
+        memcpy(p, ring.data + offset, n);
+        __atomic_store_n(&ring.tail, tail + n, __ATOMIC_RELEASE);
+        p += n;
+        len -= n;
+        spins = 0;
+    }
+    return true;
+}
+
+/**
+ * @Method: 在超时前反复尝试，每次失败后等待RETRY_INTERVAL_MS
+ * @param function<bool()> attempt 单次尝试
+ * @return bool true:某次尝试成功; false:超时
+ */
+static bool retry(const function<bool()> &attempt) {
+    for (int waited = 0; waited < CONNECT_TIMEOUT_MS; waited += RETRY_INTERVAL_MS) {
+        if (attempt()) {
+            return true;
+        }
+        usleep(RETRY_INTERVAL_MS * 1000);
+    }
+    return false;
+}
+
+/**
+ * @Method: 解析unix:/path或tcp:host:port形式的地址
+ * @param string uri 地址
+ * @param bool passive 是否用于监听
+ * @param sockaddr_storage* addr 解析得到的地址
+ * @param socklen_t* len 地址长度
+ * @return bool true:成功; false:格式错误或无法解析
+ */
+static bool resolve(const string &uri, bool passive, struct sockaddr_storage* addr, socklen_t* len) {
+    memset(addr, 0, sizeof(*addr));
+    if (uri.compare(0, 5, "unix:") == 0) {
+        string path = uri.substr(5);
+        struct sockaddr_un* un = (struct sockaddr_un*) addr;
+        if (path.size() >= sizeof(un->sun_path)) {
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, path.c_str());
+        *len = sizeof(struct sockaddr_un);
+        return true;
+    }
+    if (uri.compare(0, 4, "tcp:") != 0) {
+        return false;
+    }
+    string address = uri.substr(4);
+    size_t colon = address.rfind(':');
+    if (colon == string::npos) {
+        return false;
+    }
+    string host = address.substr(0, colon);
+    string port = address.substr(colon + 1);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    struct addrinfo* info = NULL;
+    if (getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &info) != 0) {
+        return false;
+    }
+    memcpy(addr, info->ai_addr, info->ai_addrlen);
+    *len = info->ai_addrlen;
+    freeaddrinfo(info);
+    return true;
+}
+
+/**
+ * @Method: 设置新连接的选项
+ * @param int fd 套接字
+ * @return void
+ */
+static void tuneSocket(int fd) {
+    // 帧已整块写出，关闭Nagle算法以降低往返延迟；Unix域套接字上该选项无效，忽略返回值
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+/**
+ * @Method: 在unix:/path或tcp:host:port上监听，已存在的套接字文件会被删除
+ * @param string uri 地址
+ * @param int backlog 等待接受的连接数上限
+ * @return int 监听的套接字，失败时为-1
+ */
+int listenSocket(const string &uri, int backlog) {
+    struct sockaddr_storage addr;
+    socklen_t len;
+    if (!resolve(uri, true, &addr, &len)) {
+        return -1;
+    }
+    int server = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (addr.ss_family == AF_UNIX) {
+        unlink(((struct sockaddr_un*) &addr)->sun_path);
+    } else {
+        int one = 1;
+        setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (bind(server, (struct sockaddr*) &addr, len) != 0 || listen(server, backlog) != 0) {
+        close(server);
+        return -1;
+    }
+    return server;
+}
+
+/**
+ * @Method: 接受一个连接
+ * @param int server 监听的套接字
+ * @return int 连接的套接字，失败时为-1
+ */
+int acceptSocket(int server) {
+    int fd;
+    do {
+        fd = accept(server, NULL, NULL);
+    } while (fd < 0 && errno == EINTR);
+    if (fd >= 0) {
+        tuneSocket(fd);
+    }
+    return fd;
+}
+
+/**
+ * @Method: 连接unix:/path或tcp:host:port，对方尚未监听时重试
+ * @param string uri 地址
+ * @return int 连接的套接字，失败时为-1
+ */
+int connectSocket(const string &uri) {
+    struct sockaddr_storage addr;
+    socklen_t len;
+    if (!resolve(uri, false, &addr, &len)) {
+        return -1;
+    }
+    int fd = -1;
+    bool ok = retry([&] {
+        fd = socket(addr.ss_family, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr*) &addr, len) == 0) {
+            return true;
+        }
+        close(fd);
+        return false;
+    });
+    if (!ok) {
+        return -1;
+    }
+    tuneSocket(fd);
+    return fd;
+}
+
+/**
+ * @Method: 建立Unix域套接字或TCP信道
+ * @param string uri 地址
+ * @param bool listen 是否为等待连接的一方
+ * @return Channel* 信道，失败时为NULL
+ */
+static Channel* openSocket(const string &uri, bool listen) {
+    int fd;
+    if (listen) {
+        int server = listenSocket(uri, 1);
+        if (server < 0) {
+            return NULL;
+        }
+        fd = acceptSocket(server);
+        close(server);
+        // 连接建立后不再需要套接字文件
+        if (uri.compare(0, 5, "unix:") == 0) {
+            unlink(uri.substr(5).c_str());
+        }
+    } else {
+        fd = connectSocket(uri);
+    }
+    return fd < 0 ? NULL : new SocketChannel(fd);
+}
+
+/**
+ * @Method: 建立共享内存信道
+ * @param string name 共享内存名称
+ * @param bool listen 是否为创建共享内存的一方
+ * @return Channel* 信道，失败时为NULL
+ */
+static Channel* openShm(const string &name, bool listen) {
+    size_t size = sizeof(ShmSegment);
+    if (listen) {
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0 || ftruncate(fd, size) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            return NULL;
+        }
+        void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) {
+            return NULL;
+        }
+        // ftruncate得到的内存已全部为0，写入魔数后对方才能连接
+        ShmSegment* segment = static_cast<ShmSegment*>(addr);
+        __atomic_store_n(&segment->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+        int spins = 0;
+        while (!__atomic_load_n(&segment->connected, __ATOMIC_ACQUIRE)) {
+            backoff(&spins);
+        }
+        shm_unlink(name.c_str());
+        return new ShmChannel(segment, 0);
+    }
+
+    ShmSegment* segment = NULL;
+    bool ok = retry([&] {
+        int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        void* addr = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (size_t) st.st_size >= size) {
+            addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        segment = static_cast<ShmSegment*>(addr);
+        if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC) {
+            munmap(addr, size);
+            return false;
+        }
+        return true;
+    });
+    if (!ok) {
+        return NULL;
+    }
+    __atomic_store_n(&segment->connected, 1, __ATOMIC_RELEASE);
+    return new ShmChannel(segment, 1);
+}
+
+/**
+ * @Method: 按URI建立信道
+ * 支持unix:/path、tcp:host:port和shm:/name三种URI；
+ * listen为true时创建并等待对方连接，否则连接到对方，对方尚未就绪时重试
+ * @param string uri 地址
+ * @param bool listen 是否为等待连接的一方
+ * @return Channel* 信道，失败时为NULL
+ */
+Channel* openChannel(const string &uri, bool listen) {
+    Channel* channel = NULL;
+    if (uri.compare(0, 5, "unix:") == 0 || uri.compare(0, 4, "tcp:") == 0) {
+        channel = openSocket(uri, listen);
+    } else if (uri.compare(0, 4, "shm:") == 0) {
+        channel = openShm(uri.substr(4), listen);
+    } else {
+        cerr << "Unknown transport " << uri << endl;
+        return NULL;
+    }
+    if (channel == NULL) {
+        cerr << "Unable to connect " << uri << endl;
+    }
+    return channel;
+}
@@ -0,0 +1,233 @@
+/**
+* @author: WTY
+* @date: 2026/10/19
+* @description: Transports and binary framing between two parties
+*/
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <bits/stdc++.h>
+#include <openssl/bn.h>
+using namespace std;
+
+/*
+ * 帧格式（小端序）：uint32 长度; uint8 类型; 长度个字节的内容
+ * FRAME_BIGNUMS的内容：uint32 个数; 每个数为uint8 符号（1为负）、uint32 字节数和大端序的绝对值
+ */
+// 握手，内容为算法名称
+static const uint8_t FRAME_HELLO = 1;
+// 公钥，内容为k_M、k_r、k_L、k_p、k_q五个uint32和N、zero1_prime、zero2_prime三个BIGNUM
+static const uint8_t FRAME_PUBLIC_KEY = 2;
+// 一组BIGNUM，通常是密文
+static const uint8_t FRAME_BIGNUMS = 3;
+// 数据流结束，内容为空
+static const uint8_t FRAME_END = 4;
+
+// 常驻进程的任务请求，内容为以换行分隔的算法名称、输入文件、输出文件和输出格式
+static const uint8_t FRAME_JOB = 5;
+// 任务结果，内容为uint8 状态码和结果；请求的输出文件为空时结果为结果文件的内容
+static const uint8_t FRAME_RESULT = 6;
+
+// 多路复用信道上某个会话的一帧，内容为uint32 会话编号、uint8 内层帧类型和内层帧内容
+static const uint8_t FRAME_SESSION = 7;
+// 多个会话同一轮的消息合并成的一帧，内容为若干条消息，每条为uint32 会话编号、uint8 内层帧类型、uint32 长度和内层帧内容
+static const uint8_t FRAME_BATCH = 8;
+
+// 帧头的长度
+static const size_t FRAME_HEADER_SIZE = 5;
+
+// 单个帧的最大长度
+static const uint32_t MAX_FRAME_SIZE = 1u << 30;
+
+// FRAME_BATCH中的一条消息
+struct BatchEntry {
+    uint32_t id;
+    uint8_t type;
+    string payload;
+};
+
+// 两方之间的双向信道，统计收发的字节数
+class Channel {
+public:
+    Channel();
+
+    virtual ~Channel() {
+    }
+
+    /**
+     * @Method: 发送一帧
+     * @param uint8_t type 帧类型
+     * @param string payload 帧内容
+     * @return bool true:成功; false:连接已断开
+     */
+    bool sendFrame(uint8_t type, const string &payload);
+
+    /**
+     * @Method: 接收一帧
+     * @param uint8_t* type 帧类型
+     * @param string& payload 帧内容
+     * @return bool true:成功; false:连接已断开或帧过长
+     */
+    bool recvFrame(uint8_t* type, string &payload);
+
+    /**
+     * @Method: 发送一组BIGNUM
+     * @param vector<BIGNUM*> values 待发送的数
+     * @return bool true:成功; false:连接已断开
+     */
+    bool sendBIGNUMs(const vector<BIGNUM*> &values);
+
+    /**
+     * @Method: 接收一组BIGNUM
+     * @param vector<BIGNUM*>& values 接收的数追加到values末尾
+     * @return bool true:成功; false:连接已断开或收到的不是FRAME_BIGNUMS
+     */
+    bool recvBIGNUMs(vector<BIGNUM*> &values);
+
+    uint64_t bytesSent() {
+        return sent;
+    }
+
+    uint64_t bytesReceived() {
+        return received;
+    }
+
+protected:
+    uint64_t sent;
+    uint64_t received;
+
+    virtual bool writeAll(const void* data, size_t len) = 0;
+    virtual bool readAll(void* data, size_t len) = 0;
+};
+
+// Unix域套接字或TCP连接
+class SocketChannel : public Channel {
+public:
+    explicit SocketChannel(int fd);
+
+    ~SocketChannel();
+
+protected:
+    bool writeAll(const void* data, size_t len);
+    bool readAll(void* data, size_t len);
+
+private:
+    int fd;
+};
+
+// 共享内存中的一对单生产者单消费者环形缓冲区，每个方向一个
+struct ShmSegment;
+
+class ShmChannel : public Channel {
+public:
+    /**
+     * @param ShmSegment* segment 映射的共享内存
+     * @param int side 0为创建者，写入第0个环、读取第1个环；1为连接者，方向相反
+     */
+    ShmChannel(ShmSegment* segment, int side);
+
+    ~ShmChannel();
+
+protected:
+    bool writeAll(const void* data, size_t len);
+    bool readAll(void* data, size_t len);
+
+private:
+    ShmSegment* segment;
+    int side;
+};
+
+/**
+ * @Method: 按URI建立信道
+ * 支持unix:/path、tcp:host:port和shm:/name三种URI；
+ * listen为true时创建并等待对方连接，否则连接到对方，对方尚未就绪时重试
+ * @param string uri 地址
+ * @param bool listen 是否为等待连接的一方
+ * @return Channel* 信道，失败时为NULL
+ */
+Channel* openChannel(const string &uri, bool listen);
+
+/**
+ * @Method: 在unix:/path或tcp:host:port上监听，已存在的套接字文件会被删除
+ * @param string uri 地址
+ * @param int backlog 等待接受的连接数上限
+ * @return int 监听的套接字，失败时为-1
+ */
+int listenSocket(const string &uri, int backlog);
+
+/**
+ * @Method: 接受一个连接
+ * @param int server 监听的套接字
+ * @return int 连接的套接字，失败时为-1
+ */
+int acceptSocket(int server);
+
+/**
+ * @Method: 连接unix:/path或tcp:host:port，对方尚未监听时重试
+ * @param string uri 地址
+ * @return int 连接的套接字，失败时为-1
+ */
+int connectSocket(const string &uri);
+
+/**
+ * @Method: 编码一帧，见文件开头的帧格式
+ * @param uint8_t type 帧类型
+ * @param string payload 帧内容
+ * @return string 帧头和帧内容
+ */
+string encodeFrame(uint8_t type, const string &payload);
+
+/**
+ * @Method: 将一组BIGNUM编码为FRAME_BIGNUMS的内容
+ * @param vector<BIGNUM*> values 待编码的数
+ * @return string 编码结果
+ */
+string encodeBIGNUMs(const vector<BIGNUM*> &values);
+
+/**
+ * @Method: 解码FRAME_BIGNUMS的内容
+ * @param string payload 帧内容
+ * @param vector<BIGNUM*>& values 解码的数追加到values末尾
+ * @return bool true:成功; false:格式错误
+ */
+bool decodeBIGNUMs(const string &payload, vector<BIGNUM*> &values);
+
+/**
+ * @Method: 编码FRAME_SESSION的内容
+ * @param uint32_t id 会话编号
+ * @param uint8_t type 内层帧类型
+ * @param string payload 内层帧内容
+ * @return string 编码结果
+ */
+string encodeSessionFrame(uint32_t id, uint8_t type, const string &payload);
+
+/**
+ * @Method: 解码FRAME_SESSION的内容
+ * @param string payload 帧内容
+ * @param uint32_t* id 会话编号
+ * @param uint8_t* type 内层帧类型
+ * @param string& inner 内层帧内容
+ * @return bool true:成功; false:格式错误
+ */
+bool decodeSessionFrame(const string &payload, uint32_t* id, uint8_t* type, string &inner);
+
+/**
+ * @Method: 在FRAME_BATCH的内容末尾追加一条消息
+ * @param string& batch 帧内容
+ * @param uint32_t id 会话编号
+ * @param uint8_t type 内层帧类型
+ * @param string payload 内层帧内容
+ * @return void
+ */
+void appendBatchEntry(string &batch, uint32_t id, uint8_t type, const string &payload);
+
+/**
+ * @Method: 解码FRAME_BATCH的内容
+ * @param string payload 帧内容
+ * @param vector<BatchEntry>& entries 解码的消息追加到entries末尾
+ * @return bool true:成功; false:格式错误
+ */
+bool decodeBatch(const string &payload, vector<BatchEntry> &entries);
+
+#endif //TRANSPORT_H
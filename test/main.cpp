@@ -1,6 +1,11 @@
 #include <iostream>
 #include <SHE.h>
 #include <PHE.h>
+#include <Executor.h>
+#include <Party.h>
+#include <Daemon.h>
+#include <Manifest.h>
+#include <Session.h>
 #include <openssl/bn.h>
 using namespace std;
 
@@ -170,6 +175,30 @@ void test_compare_PHE() {
     printTime(start,"计算数据比较");
 }
 
+// 测试批量数据比较
+void test_compare_PHE_batch() {
+    vector<BIGNUM*> xs;
+    vector<BIGNUM*> ys;
+    for (int i = 0; i < 100000; i++) {
+        BIGNUM* x = BN_new();
+        BIGNUM* y = BN_new();
+        BN_set_word(x, (i * 7919) % 100003);
+        BN_set_word(y, (i * 104729) % 100003);
+        xs.push_back(x);
+        ys.push_back(y);
+    }
+
+    clock_t start = clock();
+    vector<bool> result = compare_PHE_batch(xs, ys);
+    printTime(start,"批量数据比较");
+
+    int errors = 0;
+    for (size_t i = 0; i < result.size(); i++) {
+        errors += result[i] != (BN_cmp(xs[i], ys[i]) > 0);
+    }
+    cout << "compare_PHE_batch: " << result.size() << " comparisons, " << errors << " errors" << endl;
+}
+
 // 相等性测试
 void test_equal_PHE() {
     BIGNUM* x1 = BN_new();
@@ -183,6 +212,74 @@ void test_equal_PHE() {
     printTime(start,"判断数据相等性");
 }
 
+// 一个数据与多个候选数据的相等性测试
+void test_equal_PHE_many() {
+    BIGNUM* x = BN_new();
+    BN_set_word(x, 4242);
+
+    vector<BIGNUM*> ys;
+    for (int i = 0; i < 100000; i++) {
+        BIGNUM* y = BN_new();
+        BN_set_word(y, (i * 7919) % 100003);
+        ys.push_back(y);
+    }
+
+    clock_t start = clock();
+    vector<bool> result = equal_PHE_many(x, ys);
+    printTime(start,"一个数据与100000个候选数据的相等性测试");
+
+    int errors = 0, matches = 0;
+    for (size_t i = 0; i < result.size(); i++) {
+        errors += result[i] != (BN_cmp(x, ys[i]) == 0);
+        matches += result[i];
+    }
+    cout << "equal_PHE_many: " << matches << " matches, " << errors << " errors" << endl;
+}
+
+// 测试分桶的隐私等值连接
+void test_join_PHE() {
+    vector<BIGNUM*> xs, ys, values;
+    for (int i = 0; i < 10000; i++) {
+        BIGNUM* x = BN_new();
+        BN_set_word(x, (i * 7919) % 30011);
+        xs.push_back(x);
+        BIGNUM* v = BN_new();
+        BN_set_word(v, i % 100);
+        values.push_back(v);
+    }
+    for (int j = 0; j < 10000; j++) {
+        BIGNUM* y = BN_new();
+        BN_set_word(y, (j * 104729) % 30011);
+        ys.push_back(y);
+    }
+
+    clock_t start = clock();
+    JoinResult result = join_PHE(xs, ys, values, "join-key");
+    printTime(start,"10000行与10000行的等值连接");
+
+    // 与明文连接的结果比较，检查多出的、遗漏的数据对以及每个连接键的附加值之和
+    map<unsigned long, vector<size_t>> plain;
+    for (size_t i = 0; i < xs.size(); i++) {
+        plain[BN_get_word(xs[i])].push_back(i);
+    }
+    set<pair<size_t, size_t>> found(result.pairs.begin(), result.pairs.end());
+    int errors = 0, missing = 0, sumErrors = 0;
+    for (size_t k = 0; k < result.pairs.size(); k++) {
+        errors += BN_cmp(xs[result.pairs[k].first], ys[result.pairs[k].second]) != 0;
+    }
+    for (size_t j = 0; j < ys.size(); j++) {
+        const vector<size_t> &matches = plain[BN_get_word(ys[j])];
+        unsigned long sum = 0;
+        for (size_t k = 0; k < matches.size(); k++) {
+            missing += found.count(make_pair(matches[k], j)) == 0;
+            sum += BN_get_word(values[matches[k]]);
+        }
+        sumErrors += j >= result.sums.size() || BN_get_word(result.sums[j]) != sum;
+    }
+    cout << "join_PHE: " << result.pairs.size() << " pairs, " << result.comparisons << " comparisons, "
+         << errors << " errors, " << missing << " missing, " << sumErrors << " wrong sums" << endl;
+}
+
 // 测试求最小值
 void test_min_PHE() {
     vector<BIGNUM*> datas;
@@ -203,10 +300,29 @@ void test_min_PHE() {
     BIGNUM* min = min_PHE(datas, 0, datas.size() - 1);
 
     cout << "min: " << BN_bn2dec(min) << endl;
+    BN_free(min);
 
     printTime(start,"计算100000个数据最小值");
 }
 
+// 测试锦标赛方式的安全最小值与最大值
+void test_minmax_tournament_PHE() {
+    vector<BIGNUM*> datas;
+    for (int i = 0; i < 1000; i++) {
+        BIGNUM* x = BN_new();
+        BN_set_word(x, (i * 7919) % 100003 + 1);
+        datas.push_back(x);
+    }
+
+    BIGNUM* min = BN_new();
+    BIGNUM* max = BN_new();
+    clock_t start = clock();
+    int rounds = minmax_tournament_PHE(datas, min, max);
+    printTime(start,"锦标赛方式计算1000个数据最小值与最大值");
+
+    cout << "min: " << BN_bn2dec(min) << ", max: " << BN_bn2dec(max) << ", rounds: " << rounds << endl;
+}
+
 // 测试求最大值
 void test_max_PHE() {
     vector<BIGNUM*> datas;
@@ -227,6 +343,7 @@ void test_max_PHE() {
     BIGNUM* max = max_PHE(datas, 0, datas.size() - 1);
 
     cout << "max: " << BN_bn2dec(max) << endl;
+    BN_free(max);
     printTime(start,"计算100000个数据最大值");
 }
 
@@ -248,6 +365,37 @@ void test_include_PHE() {
 
 }
 
+// 测试批量包含关系
+void test_include_PHE_batch() {
+    vector<BIGNUM*> xs, y1s, y2s;
+    for (int i = 0; i < 1000; i++) {
+        BIGNUM* x = BN_new();
+        BN_set_word(x, (i * 7919) % 10007);
+        xs.push_back(x);
+    }
+    for (int j = 0; j < 100; j++) {
+        BIGNUM* y1 = BN_new();
+        BIGNUM* y2 = BN_new();
+        BN_set_word(y1, j * 100);
+        BN_set_word(y2, j * 100 + 50);
+        y1s.push_back(y1);
+        y2s.push_back(y2);
+    }
+
+    clock_t start = clock();
+    vector<vector<bool>> result = include_PHE_batch(xs, y1s, y2s);
+    printTime(start,"1000个点与100个区间的包含关系测试");
+
+    int errors = 0;
+    for (size_t i = 0; i < result.size(); i++) {
+        for (size_t j = 0; j < result[i].size(); j++) {
+            bool outside = BN_cmp(xs[i], y1s[j]) < 0 || BN_cmp(xs[i], y2s[j]) > 0;
+            errors += result[i][j] != outside;
+        }
+    }
+    cout << "include_PHE_batch: " << errors << " errors" << endl;
+}
+
 // 测试范围相交
 void test_intersect_PHE() {
     BIGNUM* x1 = BN_new();
@@ -265,6 +413,41 @@ void test_intersect_PHE() {
     printTime(start,"测试范围相交");
 }
 
+// 测试批量范围相交
+void test_intersect_PHE_batch() {
+    vector<BIGNUM*> x1s, x2s, y1s, y2s;
+    for (int i = 0; i < 500; i++) {
+        BIGNUM* x1 = BN_new();
+        BIGNUM* x2 = BN_new();
+        BN_set_word(x1, (i * 7919) % 10007);
+        BN_set_word(x2, (i * 7919) % 10007 + 30);
+        x1s.push_back(x1);
+        x2s.push_back(x2);
+    }
+    for (int j = 0; j < 200; j++) {
+        BIGNUM* y1 = BN_new();
+        BIGNUM* y2 = BN_new();
+        BN_set_word(y1, j * 50);
+        BN_set_word(y2, j * 50 + 20);
+        y1s.push_back(y1);
+        y2s.push_back(y2);
+    }
+
+    clock_t start = clock();
+    vector<vector<bool>> result = intersect_PHE_batch(x1s, x2s, y1s, y2s);
+    printTime(start,"500个范围与200个范围的相交测试");
+
+    int errors = 0, overlaps = 0;
+    for (size_t i = 0; i < result.size(); i++) {
+        for (size_t j = 0; j < result[i].size(); j++) {
+            bool overlap = BN_cmp(x1s[i], y2s[j]) <= 0 && BN_cmp(y1s[j], x2s[i]) <= 0;
+            errors += result[i][j] != overlap;
+            overlaps += result[i][j];
+        }
+    }
+    cout << "intersect_PHE_batch: " << overlaps << " overlaps, " << errors << " errors" << endl;
+}
+
 // 测试内积
 void test_inner_product_PHE() {
     vector<BIGNUM*> x1;
@@ -292,6 +475,73 @@ void test_inner_product_PHE() {
     printTime(start,"测试内积");
 }
 
+// 测试密文向量与明文矩阵的乘法
+void test_matvec_PHE() {
+    vector<BIGNUM*> x;
+    for (int i = 0; i < 1000; i++) {
+        BIGNUM* t = BN_new();
+        BN_set_word(t, i % 97);
+        x.push_back(t);
+    }
+    vector<vector<BIGNUM*>> W(500);
+    for (int r = 0; r < 500; r++) {
+        for (int c = 0; c < 1000; c++) {
+            BIGNUM* t = BN_new();
+            BN_set_word(t, (r * 31 + c * 17) % 1009);
+            W[r].push_back(t);
+        }
+    }
+
+    clock_t start = clock();
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+    vector<BIGNUM*> E_x = encryptBatch_PHE(x, pk);
+    vector<BIGNUM*> result = matvec_PHE(E_x, W);
+    printTime(start,"1000维向量与500行矩阵的乘法");
+
+    int errors = 0;
+    for (int r = 0; r < 500; r++) {
+        long long expected = 0;
+        for (int c = 0; c < 1000; c++) {
+            expected += (long long) (c % 97) * ((r * 31 + c * 17) % 1009);
+        }
+        errors += BN_get_word(result[r]) != (BN_ULONG) expected;
+    }
+    cout << "matvec_PHE: " << result.size() << " rows, " << errors << " errors" << endl;
+}
+
+// 测试双方的矩阵乘法
+void test_matmul_PHE() {
+    vector<vector<BIGNUM*>> X(200, vector<BIGNUM*>(100)), Y(100, vector<BIGNUM*>(50));
+    for (int i = 0; i < 200; i++) {
+        for (int t = 0; t < 100; t++) {
+            X[i][t] = BN_new();
+            BN_set_word(X[i][t], (i * 13 + t * 7) % 101);
+        }
+    }
+    for (int t = 0; t < 100; t++) {
+        for (int j = 0; j < 50; j++) {
+            Y[t][j] = BN_new();
+            BN_set_word(Y[t][j], (t * 11 + j * 5) % 103);
+        }
+    }
+
+    clock_t start = clock();
+    vector<vector<BIGNUM*>> result = matmul_PHE(X, Y);
+    printTime(start,"200 * 100与100 * 50矩阵的乘法");
+
+    int errors = 0;
+    for (int i = 0; i < 200; i++) {
+        for (int j = 0; j < 50; j++) {
+            long long expected = 0;
+            for (int t = 0; t < 100; t++) {
+                expected += (long long) ((i * 13 + t * 7) % 101) * ((t * 11 + j * 5) % 103);
+            }
+            errors += BN_get_word(result[i][j]) != (BN_ULONG) expected;
+        }
+    }
+    cout << "matmul_PHE: " << errors << " errors" << endl;
+}
+
 // 测试欧氏距离
 void test_distance_PHE() {
     vector<BIGNUM*> x1;
@@ -319,6 +569,46 @@ void test_distance_PHE() {
     printTime(start,"欧氏距离");
 }
 
+// 测试一个查询向量与数据库中每一行的欧氏距离
+void test_distance_scan_PHE() {
+    vector<BIGNUM*> x;
+    for (int i = 0; i < 64; i++) {
+        BIGNUM* t = BN_new();
+        BN_set_word(t, (i * 37) % 1000);
+        x.push_back(t);
+    }
+    vector<vector<BIGNUM*>> ys(5000);
+    for (int j = 0; j < 5000; j++) {
+        for (int i = 0; i < 64; i++) {
+            BIGNUM* t = BN_new();
+            BN_set_word(t, (i * 53 + j * 29) % 1000);
+            ys[j].push_back(t);
+        }
+    }
+
+    clock_t start = clock();
+    vector<BIGNUM*> result = distance_scan_PHE(x, ys, false);
+    printTime(start,"64维查询与5000行数据库的距离");
+
+    int errors = 0;
+    for (int j = 0; j < 5000; j++) {
+        long long square = 0;
+        for (int i = 0; i < 64; i++) {
+            long long d = (i * 37) % 1000 - (i * 53 + j * 29) % 1000;
+            square += d * d;
+        }
+        long long root = (long long) sqrtl((long double) square);
+        while (root * root < square) {
+            root++;
+        }
+        while (root > 0 && (root - 1) * (root - 1) >= square) {
+            root--;
+        }
+        errors += BN_get_word(result[j]) != (BN_ULONG) root;
+    }
+    cout << "distance_scan_PHE: " << result.size() << " rows, " << errors << " errors" << endl;
+}
+
 // 测试数据分箱
 void test_bin_PHE() {
     vector<BIGNUM*> x;
@@ -375,6 +665,62 @@ void test_frequency_PHE() {
     printTime(start,"计算频率");
 }
 
+// 测试线程池的扩展性，线程数从1增加到64
+void test_executor_scaling() {
+    const int n = 20000;
+    vector<BIGNUM*> data_list;
+    for (int i = 0; i < n; i++) {
+        BIGNUM* t = BN_new();
+        BN_set_word(t, i);
+        data_list.push_back(t);
+    }
+    InitKeys_PHE(20, 80, 80, 1024, 96448);
+
+    double base = 0;
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        setExecutorThreads(threads);
+        vector<BIGNUM*> cipher(n);
+        // 墙上时间，clock()统计的是所有线程的CPU时间
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        executor().parallel_for(0, n, 0, [&](size_t b0, size_t b1) {
+            for (size_t i = b0; i < b1; i++) {
+                cipher[i] = encrypt_PHE(data_list[i], pk);
+            }
+        });
+        BIGNUM* zero = BN_new();
+        BN_zero(zero);
+        BIGNUM* sum = executor().parallel_reduce((size_t) 0, cipher.size(), 0, zero, [&](size_t b0, size_t b1) {
+            BIGNUM* part = BN_new();
+            BN_zero(part);
+            for (size_t i = b0; i < b1; i++) {
+                BN_add(part, part, cipher[i]);
+                BN_mod(part, part, N, localCTX());
+            }
+            return part;
+        }, [](BIGNUM* a, BIGNUM* b) {
+            BN_add(a, a, b);
+            BN_mod(a, a, N, localCTX());
+            BN_free(b);
+            return a;
+        });
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (threads == 1) {
+            base = ms;
+        }
+
+        BIGNUM* plain = decrypt_PHE(sum, sk);
+        printf("threads = %2d, time = %10.3f 毫秒, speedup = %5.2f, sum = %s\n", threads, ms, base / ms, BN_bn2dec(plain));
+        fflush(stdout);
+
+        BN_free(plain);
+        BN_free(sum);
+        for (int i = 0; i < n; i++) {
+            BN_free(cipher[i]);
+        }
+    }
+    setExecutorThreads(0);
+}
+
 void test_deal() {
     string algoName = "frequency";
     string fileString = "/root/wty/data.txt";
@@ -383,20 +729,67 @@ void test_deal() {
     deal(algoName, fileString, resultFilePath);
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // 两方分别以独立进程运行：curr party do1|do2 <algo> <uri> <input> [output]
+    if (argc >= 6 && string(argv[1]) == "party") {
+        PartyRole role = string(argv[2]) == "do1" ? PARTY_DO1 : PARTY_DO2;
+        return runParty(role, argv[3], argv[4], argv[5], argc > 6 ? argv[6] : "") ? 0 : 1;
+    }
+
+    // 单个事件循环线程上的大量并发会话：curr sessions do1|do2 <algo> <uri> <input> [output] [并发数]
+    if (argc >= 6 && string(argv[1]) == "sessions") {
+        PartyRole role = string(argv[2]) == "do1" ? PARTY_DO1 : PARTY_DO2;
+        int concurrency = argc > 7 ? atoi(argv[7]) : 256;
+        return runSessions(role, argv[3], argv[4], argv[5], argc > 6 ? argv[6] : "", concurrency) ? 0 : 1;
+    }
+
+    // 在一个多路复用的连接上运行大量会话：curr mux do1|do2 <algo> <uri> <input> [output] [窗口大小] [合并帧字节数]
+    if (argc >= 6 && string(argv[1]) == "mux") {
+        PartyRole role = string(argv[2]) == "do1" ? PARTY_DO1 : PARTY_DO2;
+        int window = argc > 7 ? atoi(argv[7]) : 1024;
+        size_t batchBytes = argc > 8 ? strtoull(argv[8], NULL, 10) : 1 << 24;
+        return runMultiplexed(role, argv[3], argv[4], argv[5], argc > 6 ? argv[6] : "", window, batchBytes) ? 0 : 1;
+    }
+
+    // 常驻进程：curr daemon <socket>；提交任务：curr submit <socket> <algo> <input> [output]
+    if (argc >= 3 && string(argv[1]) == "daemon") {
+        return runDaemon(argv[2]) ? 0 : 1;
+    }
+    if (argc >= 5 && string(argv[1]) == "submit") {
+        string result;
+        int status = submitJob(argv[2], argv[3], argv[4], argc > 5 ? argv[5] : "", result);
+        cout << result;
+        return status ? 0 : 1;
+    }
+
+    // 批量执行任务清单：curr manifest <file> [并发任务数]
+    if (argc >= 3 && string(argv[1]) == "manifest") {
+        return runManifest(argv[2], argc > 3 ? atoi(argv[3]) : 0) ? 0 : 1;
+    }
+
     // test_SHE();
     // test_PHE();
     // test_avg_PHE();
     // test_compare_PHE();
+    // test_compare_PHE_batch();
     // test_equal_PHE();
+    // test_equal_PHE_many();
+    // test_join_PHE();
     // test_min_PHE();
     // test_max_PHE();
+    // test_minmax_tournament_PHE();
     // test_include_PHE();
+    // test_include_PHE_batch();
     // test_intersect_PHE();
+    // test_intersect_PHE_batch();
     // test_inner_product_PHE();
+    // test_matvec_PHE();
+    // test_matmul_PHE();
     // test_distance_PHE();
+    // test_distance_scan_PHE();
     // test_bin_PHE();
     // test_frequency_PHE();
+    // test_executor_scaling();
     test_deal();
 
     return 0;